@@ -1,19 +1,54 @@
 /* cplayground.c
    Single-file C platform (signup/login with SHA-256 hashes, games, tutorials,
    calculator, profile, persistent users in data/users.db).
-   Compile: gcc -std=c11 -O2 -Wall -lm -o cplayground.exe cplayground.c
+   Compile: gcc -std=c11 -O2 -Wall -pthread -o cplayground.exe cplayground.c -lm
 */
 
+#ifndef _WIN32
+#define _POSIX_C_SOURCE 200809L
+#define _XOPEN_SOURCE 700
+#endif
+
 #include <stdio.h>
+#include <stdarg.h>
+#include <pthread.h>
 #include <stdlib.h>
 #include <string.h>
 #include <time.h>
 #include <stdint.h>
 #include <sys/stat.h>
 #include <math.h>
+#include <float.h>
+#include <signal.h>
+#include <errno.h>
+#include <stdatomic.h>
+
+/* x86 SIMD paths are compiled with per-function target attributes and
+   selected at runtime, so the default build still runs on any x86 CPU. */
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#define CPG_X86 1
+#include <immintrin.h>
+#include <cpuid.h>
+#endif
+
+#ifndef _WIN32
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/resource.h>
+#include <sys/time.h>
+#include <sys/wait.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#endif
+#ifdef __linux__
+#include <sys/epoll.h>
+#endif
 
 #ifdef _WIN32
 #include <direct.h>
+#include <io.h>
+#include <malloc.h>
 #define MKDIR(p) _mkdir(p)
 #else
 #define MKDIR(p) mkdir(p, 0755)
@@ -23,8 +58,33 @@
 #define USERS_DB DATA_DIR "/users.db"
 #define MAX_USER 64
 #define HASH_HEX 65
+#define HASH_FIELD 128    /* stored password hash: legacy hex or pbkdf2$... */
+
+/* Path of the user database; the index and the stats journal shards live
+   next to it as <path>.idx and <path>.journal.<k>. */
+char users_db_path[256] = USERS_DB;
+
+/* Bytes written to users.db and its sidecar files. */
+atomic_llong db_bytes_written = 0;
 
 /* ---------- Utilities ---------- */
+volatile sig_atomic_t interrupted = 0;
+
+void on_sigint(int sig){ (void)sig; interrupted = 1; }
+
+/* SIGINT only sets a flag; read_line() then reports end of input, so the
+   menus unwind and the session is written back outside signal context. */
+void install_signal_handlers(void){
+#ifdef _WIN32
+    signal(SIGINT, on_sigint);
+#else
+    struct sigaction sa;
+    memset(&sa, 0, sizeof sa);
+    sa.sa_handler = on_sigint;   /* no SA_RESTART: a blocked fgets returns */
+    sigaction(SIGINT, &sa, NULL);
+#endif
+}
+
 void ensure_data_dir(void){
     struct stat st;
     if (stat(DATA_DIR, &st) != 0) {
@@ -32,20 +92,687 @@ void ensure_data_dir(void){
     }
 }
 
-void read_line(const char *prompt, char *buf, size_t n){
-    if(prompt) printf("%s", prompt);
-    if(!fgets(buf, (int)n, stdin)){ buf[0]='\0'; return; }
+/* Cache-line aligned blocks (MinGW has no aligned_alloc); release with
+   aligned_free(). */
+void *aligned_malloc(size_t align, size_t bytes){
+    if(bytes == 0) bytes = align;
+#ifdef _WIN32
+    return _aligned_malloc(bytes, align);
+#else
+    void *p = NULL;
+    return posix_memalign(&p, align, bytes) == 0 ? p : NULL;
+#endif
+}
+
+void aligned_free(void *p){
+#ifdef _WIN32
+    _aligned_free(p);
+#else
+    free(p);
+#endif
+}
+
+/* Per-thread session I/O. Interactive mode uses stdin/stdout; server
+   workers point these at their connection. Once input ends (EOF, a closed
+   connection or Ctrl-C) io_closed stays set and read_line() returns 0, so
+   every menu and flow returns through its normal cleanup. */
+_Thread_local FILE *io_in, *io_out;
+_Thread_local int io_closed;
+FILE *record_out;   /* --record: interactive input is copied here */
+#define RECORD_MASK "********"  /* recorded in place of passwords */
+#ifdef CPG_PROF
+uint64_t prof_now_ns(void);
+_Thread_local uint64_t prof_wait_ns;    /* time blocked in read_line(), left out of PROF sections */
+#endif
+
+FILE *in_stream(void){ return io_in ? io_in : stdin; }
+FILE *out_stream(void){ return io_out ? io_out : stdout; }
+
+#ifdef __GNUC__
+__attribute__((format(printf, 1, 2)))
+#endif
+void uprintf(const char *fmt, ...){
+    va_list ap;
+    va_start(ap, fmt);
+    vfprintf(out_stream(), fmt, ap);
+    va_end(ap);
+}
+
+/* Returns 0, with buf empty, once input has ended. A secret line is
+   recorded as RECORD_MASK. */
+int read_input(const char *prompt, char *buf, size_t n, int secret){
+    if(prompt) uprintf("%s", prompt);
+    fflush(out_stream());
+#ifdef CPG_PROF
+    uint64_t w0 = prof_now_ns();
+#endif
+    int got = !io_closed && !interrupted && fgets(buf, (int)n, in_stream());
+#ifdef CPG_PROF
+    prof_wait_ns += prof_now_ns() - w0;
+#endif
+    if(!got){
+        buf[0]='\0';
+        io_closed = 1;
+        return 0;
+    }
     size_t L = strlen(buf);
     if(L>0 && buf[L-1]=='\n') buf[L-1]='\0';
+    if(record_out && !io_in){ fprintf(record_out, "%s\n", secret ? RECORD_MASK : buf); fflush(record_out); }
+    return 1;
+}
+
+int read_line(const char *prompt, char *buf, size_t n){ return read_input(prompt, buf, n, 0); }
+int read_password(const char *prompt, char *buf, size_t n){ return read_input(prompt, buf, n, 1); }
+
+/* Read-only stream over a memory buffer. */
+FILE *mem_stream(const char *data, size_t len){
+#ifdef _WIN32
+    FILE *f = tmpfile();
+    if(f){ fwrite(data, 1, len, f); rewind(f); }
+    return f;
+#else
+    return fmemopen((void*)data, len, "r");
+#endif
+}
+
+struct tm *local_time(time_t t, struct tm *buf){
+#ifdef _WIN32
+    return localtime_s(buf, &t) == 0 ? buf : NULL;
+#else
+    return localtime_r(&t, buf);
+#endif
 }
 
 void now_iso(char *out, size_t n){
-    time_t t = time(NULL);
-    struct tm *tm = localtime(&t);
-    strftime(out, n, "%Y-%m-%dT%H:%M:%S", tm);
+    struct tm tm;
+    strftime(out, n, "%Y-%m-%dT%H:%M:%S", local_time(time(NULL), &tm));
+}
+
+double now_sec(void){
+    struct timespec ts;
+#ifdef _WIN32
+    timespec_get(&ts, TIME_UTC);
+#else
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+#endif
+    return ts.tv_sec + ts.tv_nsec*1e-9;
+}
+
+int cmp_double(const void *a, const void *b){
+    double x = *(const double*)a, y = *(const double*)b;
+    return (x > y) - (x < y);
+}
+
+/* Seeded 64-bit generator for benchmarks and Zobrist keys. */
+uint64_t splitmix64(uint64_t *s){
+    uint64_t z = (*s += 0x9E3779B97F4A7C15ull);
+    z = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9ull;
+    z = (z ^ (z >> 27)) * 0x94D049BB133111EBull;
+    return z ^ (z >> 31);
+}
+
+/* Worker threads for parallel code: CPLAYGROUND_THREADS, else online CPUs. */
+int cpu_count(void){
+    const char *e = getenv("CPLAYGROUND_THREADS");
+    if(e && atoi(e) > 0) return atoi(e);
+#ifdef _WIN32
+    e = getenv("NUMBER_OF_PROCESSORS");
+    return e && atoi(e) > 0 ? atoi(e) : 1;
+#else
+    long n = sysconf(_SC_NPROCESSORS_ONLN);
+    return n > 0 ? (int)n : 1;
+#endif
+}
+
+/* p-th percentile (0..100) of an ascending array. */
+double percentile(const double *sorted, int n, double p){
+    if(n <= 0) return 0;
+    int i = (int)(p/100.0 * (n-1) + 0.5);
+    return sorted[i < n ? i : n-1];
+}
+
+/* strtod with a fast path for plain decimals: up to 15 significant digits
+   and a power of ten up to 22 convert exactly with one multiply or divide
+   (Clinger), so the result is the same correctly rounded double. Anything
+   else goes to strtod. */
+double parse_double(const char *s, char **end){
+    static const double p10[23] = { 1e0,1e1,1e2,1e3,1e4,1e5,1e6,1e7,1e8,1e9,1e10,1e11,1e12,1e13,1e14,1e15,
+                                    1e16,1e17,1e18,1e19,1e20,1e21,1e22 };
+    const char *p = s;
+    while(*p==' ' || *p=='\t') p++;
+    int neg = *p == '-';
+    if(*p == '-' || *p == '+') p++;
+    uint64_t m = 0;
+    int nd = 0, exp10 = 0, any = 0;
+    while(*p >= '0' && *p <= '9'){ if(m || *p != '0'){ m = m*10 + (*p - '0'); nd++; } any = 1; p++; if(nd > 15) return strtod(s, end); }
+    if(*p == '.'){
+        p++;
+        while(*p >= '0' && *p <= '9'){ if(m || *p != '0'){ m = m*10 + (*p - '0'); nd++; } exp10--; any = 1; p++; if(nd > 15) return strtod(s, end); }
+    }
+    if(!any || *p == 'x' || *p == 'X') return strtod(s, end);
+    if(*p == 'e' || *p == 'E'){
+        const char *q = p + 1;
+        int eneg = *q == '-', ev = 0;
+        if(*q == '-' || *q == '+') q++;
+        if(*q >= '0' && *q <= '9'){
+            while(*q >= '0' && *q <= '9'){ if(ev < 10000) ev = ev*10 + (*q - '0'); q++; }
+            exp10 += eneg ? -ev : ev;
+            p = q;
+        }
+    }
+    if(exp10 < -22 || exp10 > 22) return strtod(s, end);
+    double v = exp10 < 0 ? (double)m / p10[-exp10] : (double)m * p10[exp10];
+    if(end) *end = (char *)p;
+    return neg ? -v : v;
+}
+
+/* printf("%.15g") without printf's cost. x is scaled by an exact power of
+   ten in long double (64-bit mantissa on x86), leaving an error far below
+   1e-3 of the last digit; products that land that close to a rounding tie,
+   scales past 10^26 and platforms whose long double is double fall back to
+   sprintf, so the text always matches printf. */
+int fmt_g15(char *out, double x){
+    static long double p10[28];
+    if(p10[0] == 0){ long double t = 1; for(int i=0;i<28;i++, t *= 10) p10[i] = t; }
+    if(!isfinite(x) || x == 0 || LDBL_MANT_DIG < 64) return sprintf(out, "%.15g", x);
+    char *p = out, dig[16];
+    if(x < 0){ *p++ = '-'; x = -x; }
+    int e = (int)floor(log10(x)), k = 14 - e;
+    if(k > 26 || k < -26) return sprintf(out, "%.15g", out == p ? x : -x);
+    long double f = k >= 0 ? x * p10[k] : x / p10[-k];
+    if(f >= 1e15L){ e++; k--; }
+    else if(f < 1e14L){ e--; k++; }
+    if(k > 26 || k < -26) return sprintf(out, "%.15g", out == p ? x : -x);
+    f = k >= 0 ? x * p10[k] : x / p10[-k];
+    long double frac = f - floorl(f);
+    if(frac > 0.499L && frac < 0.501L) return sprintf(out, "%.15g", out == p ? x : -x);
+    uint64_t d = (uint64_t)(f + 0.5L);
+    if(d >= 1000000000000000ULL){ d /= 10; e++; }
+    for(int i=14;i>=0;i--){ dig[i] = '0' + d % 10; d /= 10; }
+    int nd = 15;
+    while(nd > 1 && dig[nd-1] == '0') nd--;
+    if(e < -4 || e >= 15){
+        *p++ = dig[0];
+        if(nd > 1){ *p++ = '.'; memcpy(p, dig + 1, nd - 1); p += nd - 1; }
+        return p - out + sprintf(p, "e%c%02d", e < 0 ? '-' : '+', e < 0 ? -e : e);
+    }
+    if(e < 0){
+        *p++ = '0'; *p++ = '.';
+        for(int i=0;i<-e-1;i++) *p++ = '0';
+        memcpy(p, dig, nd); p += nd;
+    } else {
+        memcpy(p, dig, e + 1); p += e + 1;
+        if(nd > e + 1){ *p++ = '.'; memcpy(p, dig + e + 1, nd - e - 1); p += nd - e - 1; }
+    }
+    *p = 0;
+    return p - out;
+}
+
+/* Line reader over a fixed cap-byte buffer, so memory does not grow with the
+   input; lines longer than the buffer come back in pieces. base is the file
+   offset of buf[0], so line_offset() is where the next line starts. */
+typedef struct { FILE *f; char *buf; size_t cap, len, pos; long long base; int eof; } LineReader;
+
+int line_reader_init(LineReader *r, FILE *f, size_t cap, long long base){
+    memset(r, 0, sizeof *r);
+    r->f = f; r->cap = cap; r->base = base;
+    r->buf = malloc(cap + 1);
+    return r->buf != NULL;
+}
+
+void line_reader_free(LineReader *r){ free(r->buf); r->buf = NULL; }
+
+long long line_offset(const LineReader *r){ return r->base + (long long)r->pos; }
+
+char *line_next(LineReader *r){
+    for(;;){
+        char *s = r->buf + r->pos, *nl = memchr(s, '\n', r->len - r->pos);
+        if(nl){ *nl = 0; r->pos = nl - r->buf + 1; return s; }
+        if(r->eof){
+            if(r->pos == r->len) return NULL;
+            r->buf[r->len] = 0; r->pos = r->len;
+            return s;
+        }
+        memmove(r->buf, s, r->len - r->pos);
+        r->base += (long long)r->pos;
+        r->len -= r->pos; r->pos = 0;
+        if(r->len == r->cap){ r->buf[r->len] = 0; r->pos = r->len; return r->buf; }
+        size_t got = fread(r->buf + r->len, 1, r->cap - r->len, r->f);
+        if(got == 0) r->eof = 1;
+        r->len += got;
+    }
+}
+
+/* Bulk output: text is formatted straight into a large buffer and written
+   with one fwrite per buffer-full instead of one stdio call per item. */
+typedef struct { FILE *f; char *buf; size_t cap, len; int err; } OutBuf;
+
+int outbuf_init(OutBuf *o, FILE *f, size_t cap){
+    memset(o, 0, sizeof *o);
+    o->f = f; o->cap = cap;
+    o->buf = malloc(cap);
+    return o->buf != NULL;
+}
+
+int outbuf_flush(OutBuf *o){
+    if(o->len && fwrite(o->buf, 1, o->len, o->f) != o->len) o->err = 1;
+    o->len = 0;
+    return !o->err;
+}
+
+/* Room for at least n more bytes (n <= cap); returns the write position. */
+char *outbuf_reserve(OutBuf *o, size_t n){
+    if(o->cap - o->len < n) outbuf_flush(o);
+    return o->buf + o->len;
+}
+
+void outbuf_put(OutBuf *o, const char *s, size_t n){
+    if(n > o->cap){ outbuf_flush(o); if(fwrite(s, 1, n, o->f) != n) o->err = 1; return; }
+    memcpy(outbuf_reserve(o, n), s, n);
+    o->len += n;
+}
+
+void outbuf_puts(OutBuf *o, const char *s){ outbuf_put(o, s, strlen(s)); }
+
+void outbuf_int(OutBuf *o, long long v){
+    char tmp[24], *p = tmp + sizeof tmp;
+    unsigned long long u = v < 0 ? 0ULL - (unsigned long long)v : (unsigned long long)v;
+    do { *--p = '0' + u % 10; u /= 10; } while(u);
+    if(v < 0) *--p = '-';
+    outbuf_put(o, p, tmp + sizeof tmp - p);
+}
+
+/* Flushes and releases; returns 0 if any write failed. */
+int outbuf_close(OutBuf *o){
+    int ok = outbuf_flush(o) && fflush(o->f) == 0;
+    free(o->buf); o->buf = NULL;
+    return ok;
+}
+
+/* Runs fn(ctx, i) for every i in [0, n) on up to `threads` threads, the
+   caller being one of them; indices are handed out dynamically. Helper
+   threads come from a pool that is created on first use and grows to the
+   largest count asked for. One job runs on the pool at a time; a call made
+   while it is busy (including from inside a job) runs on the caller alone. */
+typedef void (*ParallelFn)(void *ctx, int i);
+typedef struct { ParallelFn fn; void *ctx; int n; atomic_int next; } ParallelJob;
+
+typedef struct {
+    pthread_mutex_t mu;
+    pthread_cond_t wake, done;
+    int size;               /* helper threads started */
+    int want;               /* helpers taking part in the current job */
+    int running;            /* helpers still working on it */
+    unsigned long gen;      /* bumped for each job */
+    ParallelJob *job;
+} ThreadPool;
+
+ThreadPool pool = { PTHREAD_MUTEX_INITIALIZER, PTHREAD_COND_INITIALIZER, PTHREAD_COND_INITIALIZER, 0, 0, 0, 0, NULL };
+pthread_mutex_t pool_busy = PTHREAD_MUTEX_INITIALIZER;
+
+void parallel_run(ParallelJob *j){
+    int i;
+    while((i = atomic_fetch_add(&j->next, 1)) < j->n) j->fn(j->ctx, i);
+}
+
+void *pool_worker(void *arg){
+    int id = (int)(intptr_t)arg;
+    unsigned long seen = 0;
+    pthread_mutex_lock(&pool.mu);
+    for(;;){
+        while(pool.gen == seen) pthread_cond_wait(&pool.wake, &pool.mu);
+        seen = pool.gen;
+        if(id >= pool.want) continue;
+        ParallelJob *j = pool.job;
+        pthread_mutex_unlock(&pool.mu);
+        parallel_run(j);
+        pthread_mutex_lock(&pool.mu);
+        if(--pool.running == 0) pthread_cond_signal(&pool.done);
+    }
+    return NULL;
+}
+
+void parallel_for(int n, int threads, ParallelFn fn, void *ctx){
+    if(threads > n) threads = n;
+    if(threads <= 1 || pthread_mutex_trylock(&pool_busy) != 0){ for(int i=0;i<n;i++) fn(ctx, i); return; }
+    ParallelJob j;
+    j.fn = fn; j.ctx = ctx; j.n = n;
+    atomic_init(&j.next, 0);
+    pthread_mutex_lock(&pool.mu);
+    while(pool.size < threads-1){
+        pthread_t th;
+        if(pthread_create(&th, NULL, pool_worker, (void*)(intptr_t)pool.size) != 0) break;
+        pthread_detach(th);
+        pool.size++;
+    }
+    pool.want = threads-1 < pool.size ? threads-1 : pool.size;
+    pool.running = pool.want;
+    pool.job = &j;
+    pool.gen++;
+    pthread_cond_broadcast(&pool.wake);
+    pthread_mutex_unlock(&pool.mu);
+    parallel_run(&j);
+    pthread_mutex_lock(&pool.mu);
+    while(pool.running > 0) pthread_cond_wait(&pool.done, &pool.mu);
+    pthread_mutex_unlock(&pool.mu);
+    pthread_mutex_unlock(&pool_busy);
+}
+
+
+int cpu_has_avx2(void){
+#ifdef CPG_X86
+    __builtin_cpu_init();
+    return __builtin_cpu_supports("avx2");
+#else
+    return 0;
+#endif
+}
+
+int cpu_has_shani(void){
+#ifdef CPG_X86
+    unsigned a, b, c, d;
+    if(!__get_cpuid_count(7, 0, &a, &b, &c, &d)) return 0;
+    return (b >> 29) & 1;
+#else
+    return 0;
+#endif
+}
+
+/* Fills out with n bytes from the OS CSPRNG, falling back to a clock-seeded
+   mix where /dev/urandom is unavailable. */
+void random_bytes(uint8_t *out, size_t n){
+    FILE *f = fopen("/dev/urandom", "rb");
+    size_t got = f ? fread(out, 1, n, f) : 0;
+    if(f) fclose(f);
+    if(got == n) return;
+    static unsigned long long counter = 0;
+    for(size_t i=got;i<n;i++){
+        unsigned long long x = (unsigned long long)time(NULL) ^ ((unsigned long long)clock() << 20) ^ (++counter * 0x9E3779B97F4A7C15ULL) ^ (uintptr_t)&x;
+        x ^= x >> 33; x *= 0xff51afd7ed558ccdULL; x ^= x >> 33;
+        out[i] = (uint8_t)x;
+    }
+}
+
+/* xoshiro256**: per-thread generator for games and simulations, much
+   faster than rand() and without its shared state. rng_thread() seeds each
+   thread from random_bytes() on first use, or from CPLAYGROUND_SEED plus a
+   thread counter so replays pick the same numbers. */
+typedef struct { uint64_t s[4]; } Rng;
+
+void rng_seed(Rng *r, uint64_t seed){
+    for(int i=0;i<4;i++) r->s[i] = splitmix64(&seed);
+}
+
+static inline uint64_t rng_next(Rng *r){
+    uint64_t *s = r->s, x = s[1] * 5;
+    uint64_t out = ((x << 7) | (x >> 57)) * 9, t = s[1] << 17;
+    s[2] ^= s[0]; s[3] ^= s[1]; s[1] ^= s[2]; s[0] ^= s[3];
+    s[2] ^= t;
+    s[3] = (s[3] << 45) | (s[3] >> 19);
+    return out;
+}
+
+/* Full 64x64 -> 128-bit product from 32-bit halves (ISO C, no __int128):
+   returns the high word, stores the low one. */
+static inline uint64_t mul_64x64(uint64_t a, uint64_t b, uint64_t *lo){
+    uint64_t al = a & 0xffffffffu, ah = a >> 32, bl = b & 0xffffffffu, bh = b >> 32;
+    uint64_t ll = al * bl, lh = al * bh, hl = ah * bl;
+    uint64_t mid = (ll >> 32) + (lh & 0xffffffffu) + (hl & 0xffffffffu);
+    *lo = mid << 32 | (ll & 0xffffffffu);
+    return ah * bh + (lh >> 32) + (hl >> 32) + (mid >> 32);
+}
+
+/* Uniform in [0, n) for n > 0, without modulo bias: the high word of
+   x * n, rejecting the few x whose low word lands below 2^64 mod n. */
+static inline uint64_t rng_below(Rng *r, uint64_t n){
+    uint64_t lo, hi = mul_64x64(rng_next(r), n, &lo);
+    if(lo < n){
+        uint64_t floor = -n % n;
+        while(lo < floor) hi = mul_64x64(rng_next(r), n, &lo);
+    }
+    return hi;
+}
+
+_Thread_local Rng thread_rng;
+_Thread_local int thread_rng_ready;
+atomic_ullong rng_threads;
+
+Rng *rng_thread(void){
+    if(!thread_rng_ready){
+        const char *e = getenv("CPLAYGROUND_SEED");
+        uint64_t seed;
+        if(e && *e) seed = strtoull(e, NULL, 0) + atomic_fetch_add(&rng_threads, 1) * 0x9E3779B97F4A7C15ull;
+        else random_bytes((uint8_t*)&seed, sizeof seed);
+        rng_seed(&thread_rng, seed);
+        thread_rng_ready = 1;
+    }
+    return &thread_rng;
+}
+
+/* Read-only view of a whole file: mmap on POSIX, a heap copy elsewhere. */
+typedef struct {
+    const uint8_t *data;
+    size_t size;
+    int mapped;
+} MappedFile;
+
+int map_file(const char *path, MappedFile *m){
+    memset(m, 0, sizeof *m);
+#ifndef _WIN32
+    int fd = open(path, O_RDONLY);
+    if(fd < 0) return 0;
+    struct stat st;
+    if(fstat(fd, &st) != 0){ close(fd); return 0; }
+    m->size = (size_t)st.st_size;
+    if(m->size == 0){ close(fd); return 1; }
+    void *p = mmap(NULL, m->size, PROT_READ, MAP_SHARED, fd, 0);
+    close(fd);
+    if(p == MAP_FAILED){ m->size = 0; return 0; }
+    m->data = p; m->mapped = 1;
+    return 1;
+#else
+    FILE *f = fopen(path, "rb");
+    if(!f) return 0;
+    fseek(f, 0, SEEK_END);
+    long size = ftell(f);
+    fseek(f, 0, SEEK_SET);
+    uint8_t *p = size > 0 ? malloc((size_t)size) : NULL;
+    if(size > 0 && (!p || fread(p, 1, (size_t)size, f) != (size_t)size)){ free(p); fclose(f); return 0; }
+    fclose(f);
+    m->data = p; m->size = size > 0 ? (size_t)size : 0;
+    return 1;
+#endif
+}
+
+void unmap_file(MappedFile *m){
+#ifndef _WIN32
+    if(m->mapped) munmap((void*)m->data, m->size);
+#else
+    free((void*)m->data);
+#endif
+    memset(m, 0, sizeof *m);
+}
+
+/* Flushes f and forces it to disk; 0 on failure. */
+int sync_file(FILE *f){
+    if(fflush(f) != 0) return 0;
+#ifndef _WIN32
+    return fsync(fileno(f)) == 0;
+#else
+    return 1;
+#endif
+}
+
+/* Makes a rename or unlink in path's directory durable. */
+void sync_parent_dir(const char *path){
+#ifndef _WIN32
+    char dir[300];
+    const char *slash = strrchr(path, '/');
+    if(slash) snprintf(dir, sizeof dir, "%.*s", (int)(slash - path), path);
+    else strcpy(dir, ".");
+    int fd = open(dir[0] ? dir : "/", O_RDONLY);
+    if(fd >= 0){ fsync(fd); close(fd); }
+#else
+    (void)path;
+#endif
+}
+
+/* Atomically replaces path with tmp: rename() swaps in the new file, so
+   there is no window without a database. Windows cannot rename over an
+   existing file and keeps the remove. */
+int replace_file(const char *tmp, const char *path){
+#ifdef _WIN32
+    remove(path);
+#endif
+    if(rename(tmp, path) != 0){ remove(tmp); return 0; }
+    sync_parent_dir(path);
+    return 1;
+}
+
+/* FNV-1a, used to key usernames in the index and in-memory tables and
+   topic ids in content packs. */
+uint32_t name_hash_n(const char *s, size_t n){
+    uint32_t h = 2166136261u;
+    for(size_t i=0;i<n;i++){ h ^= (uint8_t)s[i]; h *= 16777619u; }
+    return h;
+}
+
+uint32_t name_hash(const char *s){ return name_hash_n(s, strlen(s)); }
+
+/* ---------- Profiler ----------
+   Build with -DCPG_PROF to count calls, cumulative time and a log2-ns latency
+   histogram for the hot paths below. Without the flag PROF_BEGIN/PROF_END
+   expand to nothing. Stats are shown by "Profiler stats (admin)" and written
+   as JSON to CPLAYGROUND_PROF_OUT (default data/profile.json) at exit and on
+   SIGUSR1. Time blocked in read_line() is not counted, so the game and quiz
+   sites measure their own work rather than the player's think time. */
+enum {
+    PROF_LOAD_USERS, PROF_SAVE_USERS, PROF_JOURNAL_APPEND, PROF_DB_FIND_USER,
+    PROF_FIND_USER_INDEX, PROF_SHA256_HEX, PROF_PBKDF2, PROF_NUMBER_GUESS,
+    PROF_TICTACTOE, PROF_QUIZ, PROF_NSITES
+};
+#define PROF_BUCKETS 40     /* bucket b: [2^b, 2^(b+1)) ns */
+
+#ifdef CPG_PROF
+const char *prof_names[PROF_NSITES] = {
+    "load_users", "save_users", "journal_append", "db_find_user",
+    "find_user_index", "sha256_hex", "pbkdf2_sha256", "game_number_guess",
+    "game_tictactoe", "run_quiz_simple"
+};
+
+typedef struct {
+    atomic_ullong calls, ns;
+    atomic_ullong hist[PROF_BUCKETS];
+} ProfSite;
+
+ProfSite prof_sites[PROF_NSITES];
+
+uint64_t prof_now_ns(void){
+    struct timespec ts;
+#ifdef _WIN32
+    timespec_get(&ts, TIME_UTC);
+#else
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+#endif
+    return (uint64_t)ts.tv_sec*1000000000u + (uint64_t)ts.tv_nsec;
+}
+
+void prof_record(int id, uint64_t t0){
+    uint64_t d = prof_now_ns() - t0;
+    int b = 63 - __builtin_clzll(d | 1);
+    ProfSite *s = &prof_sites[id];
+    atomic_fetch_add_explicit(&s->calls, 1, memory_order_relaxed);
+    atomic_fetch_add_explicit(&s->ns, d, memory_order_relaxed);
+    atomic_fetch_add_explicit(&s->hist[b < PROF_BUCKETS ? b : PROF_BUCKETS-1], 1, memory_order_relaxed);
+}
+
+#define PROF_BEGIN() uint64_t prof_t0_ = prof_now_ns(), prof_w0_ = prof_wait_ns
+#define PROF_END(id) prof_record(id, prof_t0_ + (prof_wait_ns - prof_w0_))
+
+/* Upper bound in ns of the bucket holding the p-th percentile call. */
+double prof_percentile(ProfSite *s, double p){
+    unsigned long long n = atomic_load(&s->calls), acc = 0;
+    for(int b=0;b<PROF_BUCKETS;b++){
+        acc += atomic_load(&s->hist[b]);
+        if(n && acc >= p/100.0 * n) return ldexp(1.0, b+1);
+    }
+    return 0;
+}
+
+int prof_dump_json(const char *path){
+    FILE *f = fopen(path, "w");
+    if(!f) return 0;
+    fprintf(f, "{\"unit\":\"ns\",\"sites\":[");
+    for(int i=0;i<PROF_NSITES;i++){
+        ProfSite *s = &prof_sites[i];
+        fprintf(f, "%s\n {\"name\":\"%s\",\"calls\":%llu,\"total_ns\":%llu,\"hist_log2_ns\":[",
+                i ? "," : "", prof_names[i], (unsigned long long)atomic_load(&s->calls),
+                (unsigned long long)atomic_load(&s->ns));
+        for(int b=0;b<PROF_BUCKETS;b++) fprintf(f, "%s%llu", b ? "," : "", (unsigned long long)atomic_load(&s->hist[b]));
+        fprintf(f, "]}");
+    }
+    fprintf(f, "\n]}\n");
+    return fclose(f) == 0;
+}
+
+const char *prof_out_path(void){
+    const char *p = getenv("CPLAYGROUND_PROF_OUT");
+    return p && p[0] ? p : DATA_DIR "/profile.json";
+}
+
+void prof_dump_at_exit(void){ ensure_data_dir(); prof_dump_json(prof_out_path()); }
+
+#ifndef _WIN32
+/* SIGUSR1 is blocked in every thread and taken synchronously here, so the
+   dump runs in normal thread context. */
+void *prof_signal_thread(void *arg){
+    sigset_t *set = arg;
+    int sig;
+    while(sigwait(set, &sig) == 0) prof_dump_at_exit();
+    return NULL;
+}
+#endif
+
+/* Call from main() before any other thread is started. */
+void prof_init(void){
+    atexit(prof_dump_at_exit);
+#ifndef _WIN32
+    static sigset_t set;
+    sigemptyset(&set);
+    sigaddset(&set, SIGUSR1);
+    pthread_sigmask(SIG_BLOCK, &set, NULL);
+    pthread_t th;
+    if(pthread_create(&th, NULL, prof_signal_thread, &set) == 0) pthread_detach(th);
+#endif
+}
+#else
+#define PROF_BEGIN() ((void)0)
+#define PROF_END(id) ((void)0)
+void prof_init(void){}
+#endif
+
+void show_profile_stats(void){
+#ifdef CPG_PROF
+    uprintf("\n--- Profiler (log2 buckets; percentiles are bucket upper bounds) ---\n");
+    uprintf("%-18s %10s %12s %10s %10s %10s\n", "site", "calls", "total ms", "mean us", "p50 us", "p99 us");
+    for(int i=0;i<PROF_NSITES;i++){
+        ProfSite *s = &prof_sites[i];
+        unsigned long long n = atomic_load(&s->calls), ns = atomic_load(&s->ns);
+        if(!n) continue;
+        uprintf("%-18s %10llu %12.3f %10.2f %10.2f %10.2f\n", prof_names[i], n, ns/1e6, ns/1e3/n,
+               prof_percentile(s, 50)/1e3, prof_percentile(s, 99)/1e3);
+    }
+    uprintf("JSON: %s (written at exit and on SIGUSR1)\n", prof_out_path());
+#else
+    uprintf("Profiler not compiled in; rebuild with -DCPG_PROF.\n");
+#endif
 }
 
-/* ---------- SHA-256 (compact) ---------- */
+/* ---------- SHA-256 ----------
+   sha256_update() feeds whole 64-byte blocks straight from the input to
+   sha256_compress, which main() binds once, before any thread starts, to the
+   SHA-NI kernel when the CPU has it and to the portable one otherwise. sha256_many() hashes a batch
+   of independent messages, eight at a time on AVX2 when SHA-NI is absent. */
 typedef struct {
     uint8_t data[64];
     uint32_t datalen;
@@ -72,38 +799,176 @@ static const uint32_t k256[64] = {
   0x748f82ee,0x78a5636f,0x84c87814,0x8cc70208,0x90befffa,0xa4506ceb,0xbef9a3f7,0xc67178f2
 };
 
+static const uint32_t sha256_iv[8] = {
+  0x6a09e667,0xbb67ae85,0x3c6ef372,0xa54ff53a,0x510e527f,0x9b05688c,0x1f83d9ab,0x5be0cd19
+};
+
+void sha256_compress_generic(uint32_t state[8], const uint8_t *data, size_t nblocks){
+    for( ; nblocks; nblocks--, data += 64){
+        uint32_t a,b,c,d,e,f,g,h,i,j,t1,t2,m[64];
+        for (i=0,j=0; i < 16; ++i, j+=4)
+            m[i] = ((uint32_t)data[j] << 24) | (data[j+1] << 16) | (data[j+2] << 8) | (data[j+3]);
+        for ( ; i < 64; ++i)
+            m[i] = SIG1(m[i-2]) + m[i-7] + SIG0(m[i-15]) + m[i-16];
+        a=state[0]; b=state[1]; c=state[2]; d=state[3];
+        e=state[4]; f=state[5]; g=state[6]; h=state[7];
+        for(i=0;i<64;i++){
+            t1 = h + EP1(e) + CH(e,f,g) + k256[i] + m[i];
+            t2 = EP0(a) + MAJ(a,b,c);
+            h=g; g=f; f=e; e=d + t1; d=c; c=b; b=a; a=t1 + t2;
+        }
+        state[0]+=a; state[1]+=b; state[2]+=c; state[3]+=d;
+        state[4]+=e; state[5]+=f; state[6]+=g; state[7]+=h;
+    }
+}
+
+#ifdef CPG_X86
+/* Intel SHA extensions: two rounds per sha256rnds2, state kept as ABEF/CDGH. */
+__attribute__((target("sha,sse4.1")))
+void sha256_compress_shani(uint32_t state[8], const uint8_t *data, size_t nblocks){
+    const __m128i MASK = _mm_set_epi64x(0x0c0d0e0f08090a0bULL, 0x0405060700010203ULL);
+    __m128i tmp = _mm_shuffle_epi32(_mm_loadu_si128((const __m128i*)&state[0]), 0xB1);
+    __m128i st1 = _mm_shuffle_epi32(_mm_loadu_si128((const __m128i*)&state[4]), 0x1B);
+    __m128i st0 = _mm_alignr_epi8(tmp, st1, 8);
+    st1 = _mm_blend_epi16(st1, tmp, 0xF0);
+    for( ; nblocks; nblocks--, data += 64){
+        __m128i abef = st0, cdgh = st1, w[4], msg;
+        for(int r=0;r<4;r++) w[r] = _mm_shuffle_epi8(_mm_loadu_si128((const __m128i*)(data + 16*r)), MASK);
+#pragma GCC unroll 16
+        for(int r=0;r<16;r++){
+            if(r >= 4)
+                w[r&3] = _mm_sha256msg2_epu32(
+                    _mm_add_epi32(_mm_sha256msg1_epu32(w[r&3], w[(r+1)&3]), _mm_alignr_epi8(w[(r+3)&3], w[(r+2)&3], 4)),
+                    w[(r+3)&3]);
+            msg = _mm_add_epi32(w[r&3], _mm_loadu_si128((const __m128i*)&k256[4*r]));
+            st1 = _mm_sha256rnds2_epu32(st1, st0, msg);
+            st0 = _mm_sha256rnds2_epu32(st0, st1, _mm_shuffle_epi32(msg, 0x0E));
+        }
+        st0 = _mm_add_epi32(st0, abef);
+        st1 = _mm_add_epi32(st1, cdgh);
+    }
+    tmp = _mm_shuffle_epi32(st0, 0x1B);
+    st1 = _mm_shuffle_epi32(st1, 0xB1);
+    st0 = _mm_blend_epi16(tmp, st1, 0xF0);
+    st1 = _mm_alignr_epi8(st1, tmp, 8);
+    _mm_storeu_si128((__m128i*)&state[0], st0);
+    _mm_storeu_si128((__m128i*)&state[4], st1);
+}
+
+/* Eight independent messages, one per 32-bit lane; s[i] holds state word i. */
+#define ROTR8(x,n) _mm256_or_si256(_mm256_srli_epi32(x,n), _mm256_slli_epi32(x,32-(n)))
+__attribute__((target("avx2")))
+void sha256_compress_x8(__m256i s[8], const uint8_t *const p[8]){
+    __m256i w[64];
+    for(int j=0;j<16;j++){
+        uint32_t v[8];
+        for(int l=0;l<8;l++){ uint32_t x; memcpy(&x, p[l] + 4*j, 4); v[l] = __builtin_bswap32(x); }
+        w[j] = _mm256_loadu_si256((const __m256i*)v);
+    }
+    for(int j=16;j<64;j++){
+        __m256i x = w[j-15], y = w[j-2];
+        __m256i s0 = _mm256_xor_si256(_mm256_xor_si256(ROTR8(x,7), ROTR8(x,18)), _mm256_srli_epi32(x,3));
+        __m256i s1 = _mm256_xor_si256(_mm256_xor_si256(ROTR8(y,17), ROTR8(y,19)), _mm256_srli_epi32(y,10));
+        w[j] = _mm256_add_epi32(_mm256_add_epi32(s1, w[j-7]), _mm256_add_epi32(s0, w[j-16]));
+    }
+    __m256i a=s[0], b=s[1], c=s[2], d=s[3], e=s[4], f=s[5], g=s[6], h=s[7];
+    for(int i=0;i<64;i++){
+        __m256i ep1 = _mm256_xor_si256(_mm256_xor_si256(ROTR8(e,6), ROTR8(e,11)), ROTR8(e,25));
+        __m256i ch = _mm256_xor_si256(_mm256_and_si256(e,f), _mm256_andnot_si256(e,g));
+        __m256i t1 = _mm256_add_epi32(_mm256_add_epi32(h, ep1),
+                     _mm256_add_epi32(ch, _mm256_add_epi32(_mm256_set1_epi32((int)k256[i]), w[i])));
+        __m256i ep0 = _mm256_xor_si256(_mm256_xor_si256(ROTR8(a,2), ROTR8(a,13)), ROTR8(a,22));
+        __m256i maj = _mm256_or_si256(_mm256_and_si256(a,b), _mm256_and_si256(c, _mm256_or_si256(a,b)));
+        __m256i t2 = _mm256_add_epi32(ep0, maj);
+        h=g; g=f; f=e; e=_mm256_add_epi32(d,t1); d=c; c=b; b=a; a=_mm256_add_epi32(t1,t2);
+    }
+    s[0]=_mm256_add_epi32(s[0],a); s[1]=_mm256_add_epi32(s[1],b); s[2]=_mm256_add_epi32(s[2],c); s[3]=_mm256_add_epi32(s[3],d);
+    s[4]=_mm256_add_epi32(s[4],e); s[5]=_mm256_add_epi32(s[5],f); s[6]=_mm256_add_epi32(s[6],g); s[7]=_mm256_add_epi32(s[7],h);
+}
+
+/* Hashes up to 8 messages in lockstep. Lanes whose padded message is shorter
+   keep their state once they run out of blocks. */
+__attribute__((target("avx2")))
+void sha256_many_x8(const uint8_t *const msgs[], const size_t lens[], int count, uint8_t digests[][32]){
+    static const uint8_t zero_block[64];
+    uint8_t tail[8][128];
+    size_t full[8], total[8], maxb = 0;
+    for(int l=0;l<8;l++){
+        if(l >= count){ full[l] = total[l] = 0; continue; }
+        size_t len = lens[l], rem = len % 64;
+        full[l] = len / 64;
+        size_t tb = rem < 56 ? 1 : 2;
+        memset(tail[l], 0, 64*tb);
+        memcpy(tail[l], msgs[l] + 64*full[l], rem);
+        tail[l][rem] = 0x80;
+        uint64_t bits = (uint64_t)len * 8;
+        for(int k=0;k<8;k++) tail[l][64*tb - 1 - k] = (uint8_t)(bits >> (8*k));
+        total[l] = full[l] + tb;
+        if(total[l] > maxb) maxb = total[l];
+    }
+    __m256i s[8], old[8];
+    for(int k=0;k<8;k++) s[k] = _mm256_set1_epi32((int)sha256_iv[k]);
+    for(size_t b=0;b<maxb;b++){
+        const uint8_t *p[8];
+        uint32_t active[8];
+        for(int l=0;l<8;l++){
+            p[l] = b < full[l] ? msgs[l] + 64*b : b < total[l] ? tail[l] + 64*(b - full[l]) : zero_block;
+            active[l] = b < total[l] ? 0xffffffffu : 0;
+        }
+        __m256i mask = _mm256_loadu_si256((const __m256i*)active);
+        for(int k=0;k<8;k++) old[k] = s[k];
+        sha256_compress_x8(s, p);
+        for(int k=0;k<8;k++) s[k] = _mm256_blendv_epi8(old[k], s[k], mask);
+    }
+    uint32_t st[8][8];
+    for(int k=0;k<8;k++) _mm256_storeu_si256((__m256i*)st[k], s[k]);
+    for(int l=0;l<count;l++)
+        for(int k=0;k<8;k++){
+            digests[l][4*k]   = (uint8_t)(st[k][l] >> 24);
+            digests[l][4*k+1] = (uint8_t)(st[k][l] >> 16);
+            digests[l][4*k+2] = (uint8_t)(st[k][l] >> 8);
+            digests[l][4*k+3] = (uint8_t)st[k][l];
+        }
+}
+#endif
+
+void (*sha256_compress)(uint32_t state[8], const uint8_t *data, size_t nblocks) = sha256_compress_generic;
+
+void sha256_select(void){
+#ifdef CPG_X86
+    if(cpu_has_shani()){ sha256_compress = sha256_compress_shani; return; }
+#endif
+    sha256_compress = sha256_compress_generic;
+}
+
 void sha256_transform(SHA256_CTX *ctx, const uint8_t data[]){
-    uint32_t a,b,c,d,e,f,g,h,i,j,t1,t2,m[64];
-    for (i=0,j=0; i < 16; ++i, j+=4)
-        m[i] = (data[j] << 24) | (data[j+1] << 16) | (data[j+2] << 8) | (data[j+3]);
-    for ( ; i < 64; ++i)
-        m[i] = SIG1(m[i-2]) + m[i-7] + SIG0(m[i-15]) + m[i-16];
-    a=ctx->state[0]; b=ctx->state[1]; c=ctx->state[2]; d=ctx->state[3];
-    e=ctx->state[4]; f=ctx->state[5]; g=ctx->state[6]; h=ctx->state[7];
-    for(i=0;i<64;i++){
-        t1 = h + EP1(e) + CH(e,f,g) + k256[i] + m[i];
-        t2 = EP0(a) + MAJ(a,b,c);
-        h=g; g=f; f=e; e=d + t1; d=c; c=b; b=a; a=t1 + t2;
-    }
-    ctx->state[0]+=a; ctx->state[1]+=b; ctx->state[2]+=c; ctx->state[3]+=d;
-    ctx->state[4]+=e; ctx->state[5]+=f; ctx->state[6]+=g; ctx->state[7]+=h;
+    sha256_compress(ctx->state, data, 1);
 }
 
 void sha256_init(SHA256_CTX *ctx){
     ctx->datalen = 0; ctx->bitlen = 0;
-    ctx->state[0]=0x6a09e667; ctx->state[1]=0xbb67ae85; ctx->state[2]=0x3c6ef372; ctx->state[3]=0xa54ff53a;
-    ctx->state[4]=0x510e527f; ctx->state[5]=0x9b05688c; ctx->state[6]=0x1f83d9ab; ctx->state[7]=0x5be0cd19;
+    memcpy(ctx->state, sha256_iv, sizeof sha256_iv);
 }
 
 void sha256_update(SHA256_CTX *ctx, const uint8_t data[], size_t len){
-    for(size_t i=0;i<len;i++){
-        ctx->data[ctx->datalen++] = data[i];
-        if(ctx->datalen==64){
-            sha256_transform(ctx, ctx->data);
-            ctx->bitlen += 512;
-            ctx->datalen = 0;
-        }
+    if(ctx->datalen){
+        size_t take = 64 - ctx->datalen;
+        if(take > len) take = len;
+        memcpy(ctx->data + ctx->datalen, data, take);
+        ctx->datalen += take; data += take; len -= take;
+        if(ctx->datalen < 64) return;
+        sha256_compress(ctx->state, ctx->data, 1);
+        ctx->bitlen += 512;
+        ctx->datalen = 0;
+    }
+    size_t nb = len / 64;
+    if(nb){
+        sha256_compress(ctx->state, data, nb);
+        ctx->bitlen += 512ULL * nb;
+        data += 64*nb; len -= 64*nb;
     }
+    memcpy(ctx->data, data, len);
+    ctx->datalen = (uint32_t)len;
 }
 
 void sha256_final(SHA256_CTX *ctx, uint8_t hash[]){
@@ -139,36 +1004,5520 @@ void sha256_final(SHA256_CTX *ctx, uint8_t hash[]){
     }
 }
 
-void sha256_hex(const char *input, char out_hex[HASH_HEX]){
+void hex_encode(const uint8_t *in, size_t n, char *out){
+    static const char digits[] = "0123456789abcdef";
+    for(size_t i=0;i<n;i++){ out[2*i] = digits[in[i] >> 4]; out[2*i+1] = digits[in[i] & 15]; }
+    out[2*n] = '\0';
+}
+
+void sha256(const uint8_t *data, size_t len, uint8_t hash[32]){
     SHA256_CTX ctx;
-    uint8_t hash[32];
     sha256_init(&ctx);
-    sha256_update(&ctx, (const uint8_t*)input, strlen(input));
+    sha256_update(&ctx, data, len);
     sha256_final(&ctx, hash);
-    for(int i=0;i<32;i++) sprintf(out_hex + i*2, "%02x", hash[i]);
-    out_hex[64]=0;
 }
 
-/* ---------- User DB ---------- */
-typedef struct {
-    char username[MAX_USER];
-    char hash[HASH_HEX];
-    int games_played;
-    int games_won;
-    int quizzes;
-    char last_login[32];
-} User;
+void sha256_hex(const char *input, char out_hex[HASH_HEX]){
+    PROF_BEGIN();
+    uint8_t hash[32];
+    sha256((const uint8_t*)input, strlen(input), hash);
+    hex_encode(hash, 32, out_hex);
+    PROF_END(PROF_SHA256_HEX);
+}
 
-int load_users(User **arr_out){
-    ensure_data_dir();
-    FILE *f = fopen(USERS_DB, "r");
+/* Batch API: digests[i] = SHA-256(msgs[i][0..lens[i]) ). */
+void sha256_many(const uint8_t *const msgs[], const size_t lens[], size_t count, uint8_t digests[][32]){
+    size_t i = 0;
+#ifdef CPG_X86
+    if(sha256_compress != sha256_compress_shani && cpu_has_avx2())
+        for( ; i < count; i += 8) sha256_many_x8(msgs + i, lens + i, count-i < 8 ? (int)(count-i) : 8, digests + i);
+#endif
+    for( ; i < count; i++) sha256(msgs[i], lens[i], digests[i]);
+}
+
+/* ---------- Password hashing (PBKDF2-HMAC-SHA256) ----------
+   Stored form: pbkdf2$<iterations>$<salt hex>$<derived key hex>. The cost is
+   kept per record, so raising kdf_iterations only affects new hashes and
+   logins of users whose record is older (rehashed on successful login).
+   Bare 64-hex values are legacy unsalted sha256_hex() records. */
+#define KDF_ITERATIONS 100000
+#define KDF_SALT_BYTES 16
+
+int kdf_iterations = KDF_ITERATIONS;
+
+/* HMAC key with the ipad/opad blocks already compressed. */
+typedef struct { uint32_t inner[8], outer[8]; } HmacKey;
+
+void hmac_sha256_key(HmacKey *k, const uint8_t *key, size_t keylen){
+    uint8_t kb[64] = {0}, pad[64];
+    if(keylen > 64) sha256(key, keylen, kb);
+    else memcpy(kb, key, keylen);
+    for(int i=0;i<64;i++) pad[i] = kb[i] ^ 0x36;
+    memcpy(k->inner, sha256_iv, sizeof sha256_iv);
+    sha256_compress(k->inner, pad, 1);
+    for(int i=0;i<64;i++) pad[i] = kb[i] ^ 0x5c;
+    memcpy(k->outer, sha256_iv, sizeof sha256_iv);
+    sha256_compress(k->outer, pad, 1);
+}
+
+void hmac_sha256(const HmacKey *k, const uint8_t *msg, size_t len, uint8_t out[32]){
+    SHA256_CTX ctx;
+    uint8_t inner[32];
+    memcpy(ctx.state, k->inner, sizeof ctx.state);
+    ctx.datalen = 0; ctx.bitlen = 512;
+    sha256_update(&ctx, msg, len);
+    sha256_final(&ctx, inner);
+    memcpy(ctx.state, k->outer, sizeof ctx.state);
+    ctx.datalen = 0; ctx.bitlen = 512;
+    sha256_update(&ctx, inner, 32);
+    sha256_final(&ctx, out);
+}
+
+static void store_be32x8(uint8_t *out, const uint32_t st[8]){
+    for(int i=0;i<8;i++){
+        out[4*i] = (uint8_t)(st[i] >> 24); out[4*i+1] = (uint8_t)(st[i] >> 16);
+        out[4*i+2] = (uint8_t)(st[i] >> 8); out[4*i+3] = (uint8_t)st[i];
+    }
+}
+
+/* PBKDF2 with the HMAC midstates computed once per password: every
+   iteration after the first is exactly two compressions of pre-padded
+   single blocks. */
+void pbkdf2_sha256(const uint8_t *pw, size_t pwlen, const uint8_t *salt, size_t saltlen,
+                   uint32_t iterations, uint8_t *out, size_t outlen){
+    PROF_BEGIN();
+    HmacKey k;
+    hmac_sha256_key(&k, pw, pwlen);
+    uint8_t *msg = malloc(saltlen + 4);
+    if(!msg){ memset(out, 0, outlen); return; }
+    memcpy(msg, salt, saltlen);
+    uint8_t blk_in[64] = {0}, blk_out[64] = {0};
+    blk_in[32] = blk_out[32] = 0x80;                 /* 64+32 bytes = 768 bits */
+    blk_in[62] = blk_out[62] = 0x03;
+    for(uint32_t b=1; outlen; b++){
+        uint8_t u[32], t[32];
+        msg[saltlen] = (uint8_t)(b >> 24); msg[saltlen+1] = (uint8_t)(b >> 16);
+        msg[saltlen+2] = (uint8_t)(b >> 8); msg[saltlen+3] = (uint8_t)b;
+        hmac_sha256(&k, msg, saltlen + 4, u);
+        memcpy(t, u, 32);
+        memcpy(blk_in, u, 32);
+        for(uint32_t j=1;j<iterations;j++){
+            uint32_t st[8];
+            memcpy(st, k.inner, sizeof st);
+            sha256_compress(st, blk_in, 1);
+            store_be32x8(blk_out, st);
+            memcpy(st, k.outer, sizeof st);
+            sha256_compress(st, blk_out, 1);
+            store_be32x8(blk_in, st);
+            for(int i=0;i<32;i++) t[i] ^= blk_in[i];
+        }
+        size_t take = outlen < 32 ? outlen : 32;
+        memcpy(out, t, take);
+        out += take; outlen -= take;
+    }
+    free(msg);
+    PROF_END(PROF_PBKDF2);
+}
+
+/* Callers hashing many passwords draw their salts in bulk. */
+void password_hash_salted(const char *password, uint32_t iterations, const uint8_t salt[KDF_SALT_BYTES], char out[HASH_FIELD]){
+    uint8_t dk[32];
+    char salt_hex[2*KDF_SALT_BYTES+1], dk_hex[65];
+    pbkdf2_sha256((const uint8_t*)password, strlen(password), salt, KDF_SALT_BYTES, iterations, dk, sizeof dk);
+    hex_encode(salt, KDF_SALT_BYTES, salt_hex);
+    hex_encode(dk, sizeof dk, dk_hex);
+    snprintf(out, HASH_FIELD, "pbkdf2$%u$%s$%s", (unsigned)iterations, salt_hex, dk_hex);
+}
+
+void password_hash(const char *password, uint32_t iterations, char out[HASH_FIELD]){
+    uint8_t salt[KDF_SALT_BYTES];
+    random_bytes(salt, sizeof salt);
+    password_hash_salted(password, iterations, salt, out);
+}
+
+int hex_decode(const char *in, uint8_t *out, size_t n){
+    for(size_t i=0;i<n;i++){
+        int v = 0;
+        for(int j=0;j<2;j++){
+            char c = in[2*i+j];
+            int d = (c>='0'&&c<='9') ? c-'0' : (c>='a'&&c<='f') ? c-'a'+10 : (c>='A'&&c<='F') ? c-'A'+10 : -1;
+            if(d < 0) return 0;
+            v = v*16 + d;
+        }
+        out[i] = (uint8_t)v;
+    }
+    return 1;
+}
+
+/* Splits a pbkdf2$ record; returns 0 if stored is not one. */
+int parse_pbkdf2(const char *stored, uint32_t *iterations, uint8_t salt[KDF_SALT_BYTES], uint8_t dk[32]){
+    unsigned it;
+    char salt_hex[2*KDF_SALT_BYTES+1], dk_hex[65];
+    if(sscanf(stored, "pbkdf2$%u$%32[0-9a-f]$%64[0-9a-f]", &it, salt_hex, dk_hex)!=3) return 0;
+    if(strlen(salt_hex)!=2*KDF_SALT_BYTES || strlen(dk_hex)!=64 || it==0) return 0;
+    *iterations = it;
+    return hex_decode(salt_hex, salt, KDF_SALT_BYTES) && hex_decode(dk_hex, dk, 32);
+}
+
+int password_verify(const char *password, const char *stored){
+    uint8_t expect[32], got[32], salt[KDF_SALT_BYTES];
+    uint32_t it;
+    if(parse_pbkdf2(stored, &it, salt, expect)){
+        pbkdf2_sha256((const uint8_t*)password, strlen(password), salt, sizeof salt, it, got, sizeof got);
+    } else {
+        if(strlen(stored)!=64 || !hex_decode(stored, expect, 32)) return 0;
+        sha256((const uint8_t*)password, strlen(password), got);
+    }
+    uint8_t diff = 0;
+    for(int i=0;i<32;i++) diff |= got[i] ^ expect[i];
+    return diff == 0;
+}
+
+int password_needs_rehash(const char *stored){
+    uint8_t salt[KDF_SALT_BYTES], dk[32];
+    uint32_t it;
+    return !parse_pbkdf2(stored, &it, salt, dk) || it < (uint32_t)kdf_iterations;
+}
+
+/* ---------- User DB ---------- */
+typedef struct {
+    char username[MAX_USER];
+    char hash[HASH_FIELD];
+    int games_played;
+    int games_won;
+    int quizzes;
+    char last_login[32];
+} User;
+
+/* Hand-rolled field scanners for users.db lines, equivalent to
+   sscanf("%63s %127s %d %d %d %31s") on what save_users() writes but
+   without format-string interpretation or locale lookups. */
+static inline int is_field_space(char c){ return c==' ' || c=='\t' || c=='\r' || c=='\n' || c=='\v' || c=='\f'; }
+
+const char *scan_token(const char *p, const char *e, char *out, size_t cap){
+    while(p < e && is_field_space(*p)) p++;
+    if(p == e) return NULL;
+    const char *s = p;
+    while(p < e && !is_field_space(*p)) p++;
+    size_t len = (size_t)(p - s) < cap-1 ? (size_t)(p - s) : cap-1;
+    memcpy(out, s, len);
+    out[len] = '\0';
+    return p;
+}
+
+const char *scan_int(const char *p, const char *e, int *out){
+    while(p < e && is_field_space(*p)) p++;
+    int neg = 0;
+    if(p < e && (*p=='-' || *p=='+')){ neg = *p=='-'; p++; }
+    if(p == e || *p < '0' || *p > '9') return NULL;
+    long long v = 0;
+    while(p < e && *p >= '0' && *p <= '9'){ if(v < 0x7fffffffLL) v = v*10 + (*p - '0'); p++; }
+    if(v > 0x7fffffffLL) v = 0x7fffffffLL;
+    *out = (int)(neg ? -v : v);
+    return p;
+}
+
+/* Parses the users.db line [p, e); returns 0 for lines without username and
+   hash and for '#' header lines. */
+int parse_user_range(const char *p, const char *e, User *u){
+    if(p < e && *p=='#') return 0;
+    if(!(p = scan_token(p, e, u->username, sizeof u->username))) return 0;
+    if(!(p = scan_token(p, e, u->hash, sizeof u->hash))) return 0;
+    u->games_played = u->games_won = u->quizzes = 0;
+    u->last_login[0] = '\0';
+    if(!(p = scan_int(p, e, &u->games_played))) return 1;
+    if(!(p = scan_int(p, e, &u->games_won))) return 1;
+    if(!(p = scan_int(p, e, &u->quizzes))) return 1;
+    scan_token(p, e, u->last_login, sizeof u->last_login);
+    return 1;
+}
+
+int parse_user_line(const char *line, User *u){
+    return parse_user_range(line, line + strlen(line), u);
+}
+
+/* 1 if s[0..len) can be stored as a username: no whitespace, which splits
+   the fields of a line, no leading '#', which marks a header line, and no
+   ',', which would split an --export row. */
+int username_valid(const char *s, size_t len){
+    if(len == 0 || len >= MAX_USER || s[0] == '#') return 0;
+    for(size_t i=0;i<len;i++) if(is_field_space(s[i]) || s[i] == ',') return 0;
+    return 1;
+}
+
+/* ---------- DB locking ----------
+   Two levels, each enforced by a mutex/condvar for the threads of this
+   process and by an fcntl lock on <users.db>.lock against other processes:
+   - db_lock() is exclusive and re-entrant per thread. Every load, save and
+     lookup takes it, so concurrent sessions cannot interleave a
+     read-modify-write and lose updates.
+   - db_lock_shared() plus journal_shard_lock(k) is what a journal commit
+     takes: byte 0 shared and byte 1+k exclusive. Commits to different
+     shards then run in parallel and only exclude whole-database operations.
+   Waiting writers hold off new shared holders, so a stream of commits
+   cannot starve a compaction. fcntl locks belong to the process, not the
+   thread, so the first shared holder in a process takes the byte-0 read
+   lock and the last one releases it. The lock file also stays open:
+   closing any descriptor on it would drop every lock the process holds. */
+typedef struct {
+    pthread_mutex_t mu;
+    pthread_cond_t cv;
+    int writer, writers_waiting, readers;
+    int fd;
+    char path[300];
+} DbGate;
+
+DbGate db_gate = { PTHREAD_MUTEX_INITIALIZER, PTHREAD_COND_INITIALIZER, 0, 0, 0, -1, "" };
+_Thread_local int db_lock_depth;    /* exclusive holds by this thread */
+
+/* Lock file for users_db_path; called with db_gate.mu held before taking
+   the first lock, so reopening for a new path drops nothing. */
+int db_lock_file(void){
+#ifndef _WIN32
+    char path[300];
+    snprintf(path, sizeof path, "%s.lock", users_db_path);
+    if(db_gate.fd >= 0 && strcmp(db_gate.path, path) == 0) return db_gate.fd;
+    if(db_gate.fd >= 0) close(db_gate.fd);
+    ensure_data_dir();
+    db_gate.fd = open(path, O_RDWR | O_CREAT, 0644);
+    strcpy(db_gate.path, path);
+    return db_gate.fd;
+#else
+    return -1;
+#endif
+}
+
+/* Locks or unlocks one byte of the lock file. EDEADLK is retried: the
+   kernel sees processes, not threads, and can report a cycle that the
+   other process's threads are about to break. */
+void db_flock(int fd, short type, long byte){
+#ifndef _WIN32
+    if(fd < 0) return;
+    struct flock fl;
+    memset(&fl, 0, sizeof fl);
+    fl.l_type = type; fl.l_whence = SEEK_SET; fl.l_start = byte; fl.l_len = 1;
+    while(fcntl(fd, F_SETLKW, &fl) != 0 && (errno == EINTR || errno == EDEADLK))
+        if(errno == EDEADLK) nanosleep(&(struct timespec){0, 1000000}, NULL);
+#endif
+}
+
+void db_lock(void){
+    if(db_lock_depth++ > 0) return;
+    pthread_mutex_lock(&db_gate.mu);
+    db_gate.writers_waiting++;
+    while(db_gate.writer || db_gate.readers) pthread_cond_wait(&db_gate.cv, &db_gate.mu);
+    db_gate.writers_waiting--;
+    db_gate.writer = 1;
+    int fd = db_lock_file();
+    pthread_mutex_unlock(&db_gate.mu);
+    db_flock(fd, F_WRLCK, 0);
+}
+
+void db_unlock(void){
+    if(--db_lock_depth > 0) return;
+    pthread_mutex_lock(&db_gate.mu);
+    db_flock(db_gate.fd, F_UNLCK, 0);
+    db_gate.writer = 0;
+    pthread_cond_broadcast(&db_gate.cv);
+    pthread_mutex_unlock(&db_gate.mu);
+}
+
+/* Not re-entrant, and not to be taken while holding db_lock(). */
+void db_lock_shared(void){
+    pthread_mutex_lock(&db_gate.mu);
+    while(db_gate.writer || db_gate.writers_waiting) pthread_cond_wait(&db_gate.cv, &db_gate.mu);
+    if(db_gate.readers++ == 0) db_flock(db_lock_file(), F_RDLCK, 0);
+    pthread_mutex_unlock(&db_gate.mu);
+}
+
+void db_unlock_shared(void){
+    pthread_mutex_lock(&db_gate.mu);
+    if(--db_gate.readers == 0){
+        db_flock(db_gate.fd, F_UNLCK, 0);
+        pthread_cond_broadcast(&db_gate.cv);
+    }
+    pthread_mutex_unlock(&db_gate.mu);
+}
+
+/* Cross-process lock on journal shard k; in-process exclusion comes from
+   the shard's own mutex. Taken under db_lock_shared(). */
+void journal_shard_lock(int k){ db_flock(db_gate.fd, F_WRLCK, 1 + k); }
+void journal_shard_unlock(int k){ db_flock(db_gate.fd, F_UNLCK, 1 + k); }
+
+/* ---------- Binary user DB ----------
+   Optional fixed-width format: a 64-byte header and 192-byte (three cache
+   line) records sorted by username. The file is mmapped and binary-searched
+   in place, so opening it and looking a user up parse and copy nothing but
+   the one record returned. Hashes are stored raw (key, salt, iterations;
+   0 iterations = legacy sha256) and last_login as epoch seconds. The format
+   is detected by its magic, so users.db may hold either; switch with
+   cplayground --convert text|binary [in] [out]. */
+#define BIN_MAGIC 0x42555043u /* "CPUB" */
+#define BIN_VERSION 1
+
+typedef struct {
+    uint32_t magic, version, record_size, count;
+    int64_t gen;
+    uint8_t reserved[40];
+} BinHeader;
+
+typedef struct {
+    char username[MAX_USER];
+    uint8_t key[32];
+    uint8_t salt[KDF_SALT_BYTES];
+    uint32_t iterations;
+    int32_t games_played, games_won, quizzes;
+    int64_t last_login;       /* 0 = never */
+    uint8_t reserved[56];
+} BinUser;
+
+_Static_assert(sizeof(BinHeader) == 64, "BinHeader must be one cache line");
+_Static_assert(sizeof(BinUser) % 64 == 0, "BinUser must be whole cache lines");
+
+int64_t iso_to_epoch(const char *s){
+    struct tm tm;
+    memset(&tm, 0, sizeof tm);
+    if(sscanf(s, "%d-%d-%dT%d:%d:%d", &tm.tm_year, &tm.tm_mon, &tm.tm_mday, &tm.tm_hour, &tm.tm_min, &tm.tm_sec)!=6) return 0;
+    tm.tm_year -= 1900; tm.tm_mon -= 1; tm.tm_isdst = -1;
+    time_t t = mktime(&tm);
+    return t == (time_t)-1 ? 0 : (int64_t)t;
+}
+
+void epoch_to_iso(int64_t t, char *out, size_t n){
+    if(!t){ out[0] = '\0'; return; }
+    struct tm tm;
+    strftime(out, n, "%Y-%m-%dT%H:%M:%S", local_time((time_t)t, &tm));
+}
+
+/* Returns 0 if the stored hash is neither pbkdf2$ nor 64 hex digits. */
+int user_to_bin(const User *u, BinUser *b){
+    memset(b, 0, sizeof *b);
+    snprintf(b->username, sizeof b->username, "%s", u->username);
+    if(!parse_pbkdf2(u->hash, &b->iterations, b->salt, b->key)){
+        if(strlen(u->hash)!=64 || !hex_decode(u->hash, b->key, 32)) return 0;
+        b->iterations = 0;
+    }
+    b->games_played = u->games_played;
+    b->games_won = u->games_won;
+    b->quizzes = u->quizzes;
+    b->last_login = iso_to_epoch(u->last_login);
+    return 1;
+}
+
+void bin_to_user(const BinUser *b, User *u){
+    memset(u, 0, sizeof *u);
+    memcpy(u->username, b->username, sizeof u->username-1);
+    if(b->iterations){
+        char salt_hex[2*KDF_SALT_BYTES+1], key_hex[65];
+        hex_encode(b->salt, sizeof b->salt, salt_hex);
+        hex_encode(b->key, sizeof b->key, key_hex);
+        snprintf(u->hash, sizeof u->hash, "pbkdf2$%u$%s$%s", (unsigned)b->iterations, salt_hex, key_hex);
+    } else {
+        hex_encode(b->key, sizeof b->key, u->hash);
+    }
+    u->games_played = b->games_played;
+    u->games_won = b->games_won;
+    u->quizzes = b->quizzes;
+    epoch_to_iso(b->last_login, u->last_login, sizeof u->last_login);
+}
+
+int db_is_binary(void){
+    FILE *f = fopen(users_db_path, "rb");
+    if(!f) return 0;
+    uint32_t magic = 0;
+    int ok = fread(&magic, sizeof magic, 1, f)==1 && magic==BIN_MAGIC;
+    fclose(f);
+    return ok;
+}
+
+/* The current mapping, kept while the file (same inode, size, mtime) is
+   unchanged so repeated lookups cost no syscalls beyond a stat. */
+struct {
+    MappedFile m;
+    const BinHeader *h;
+    char path[256];
+    int64_t size, mtime;
+    uint64_t ino;
+} bin_db;
+
+void bin_close(void){
+    if(bin_db.h) unmap_file(&bin_db.m);
+    bin_db.h = NULL;
+}
+
+const BinHeader *bin_open(void){
+    struct stat st;
+    if(stat(users_db_path, &st) != 0){ bin_close(); return NULL; }
+    if(bin_db.h && strcmp(bin_db.path, users_db_path)==0 && bin_db.size==(int64_t)st.st_size &&
+       bin_db.mtime==(int64_t)st.st_mtime && bin_db.ino==(uint64_t)st.st_ino) return bin_db.h;
+    bin_close();
+    if(!map_file(users_db_path, &bin_db.m)) return NULL;
+    const BinHeader *h = (const BinHeader*)bin_db.m.data;
+    if(bin_db.m.size < sizeof *h || h->magic!=BIN_MAGIC || h->version!=BIN_VERSION || h->record_size!=sizeof(BinUser) ||
+       bin_db.m.size < sizeof *h + (size_t)h->count * sizeof(BinUser)){
+        unmap_file(&bin_db.m); return NULL;
+    }
+    bin_db.h = h;
+    strcpy(bin_db.path, users_db_path);
+    bin_db.size = (int64_t)st.st_size; bin_db.mtime = (int64_t)st.st_mtime; bin_db.ino = (uint64_t)st.st_ino;
+    return h;
+}
+
+const BinUser *bin_records(const BinHeader *h){ return (const BinUser*)(h + 1); }
+
+/* Same contract as idx_lookup(). */
+int bin_lookup(const char *username, User *out){
+    const BinHeader *h = bin_open();
+    if(!h) return -1;
+    const BinUser *r = bin_records(h);
+    size_t lo = 0, hi = h->count;
+    while(lo < hi){
+        size_t mid = lo + (hi-lo)/2;
+        int c = strncmp(r[mid].username, username, MAX_USER);
+        if(c == 0){ bin_to_user(&r[mid], out); return 1; }
+        if(c < 0) lo = mid+1; else hi = mid;
+    }
+    return 0;
+}
+
+int cmp_bin_user(const void *a, const void *b){
+    return strncmp(((const BinUser*)a)->username, ((const BinUser*)b)->username, MAX_USER);
+}
+
+int bin_write(const char *path, User *arr, int n, long gen){
+    BinUser *recs = n>0 ? malloc((size_t)n * sizeof(BinUser)) : NULL;
+    if(n>0 && !recs) return 0;
+    for(int i=0;i<n;i++)
+        if(!user_to_bin(&arr[i], &recs[i])){
+            printf("Cannot store hash of '%s' in binary format.\n", arr[i].username);
+            free(recs); return 0;
+        }
+    if(n>0) qsort(recs, n, sizeof(BinUser), cmp_bin_user);
+    BinHeader h;
+    memset(&h, 0, sizeof h);
+    h.magic = BIN_MAGIC; h.version = BIN_VERSION; h.record_size = sizeof(BinUser);
+    h.count = (uint32_t)n; h.gen = gen;
+    FILE *f = fopen(path, "wb");
+    if(!f){ free(recs); return 0; }
+    int ok = fwrite(&h, sizeof h, 1, f)==1 && (n==0 || fwrite(recs, sizeof(BinUser), n, f)==(size_t)n);
+    ok = sync_file(f) && ok;
+    ok = (fclose(f)==0) && ok;
+    db_bytes_written += sizeof h + (long long)n * sizeof(BinUser);
+    free(recs);
+    return ok;
+}
+
+/* ---------- Stats journal ----------
+   Stat changes are appended as small delta records instead of rewriting
+   users.db:
+       username d_games_played d_games_won d_quizzes last_login|- [hash]
+   The optional hash replaces the stored password hash (rehash on login).
+   The journal is split into journal_shards files, <users.db>.journal.<k>,
+   by name_hash(username). Each shard has its own lock and commits with
+   group commit: writers queue records in memory, and one of them writes
+   everything queued with one write() and one fdatasync(). Records that
+   arrive while that fsync runs form the next batch. A record is
+   acknowledged only once it is on disk, and writes to different shards
+   proceed in parallel.
+   users.db starts with a "#gen N" line and every shard file with the
+   generation it applies to. save_users() writes and fsyncs the new
+   users.db with the next generation, renames it over the old one and then
+   drops the shards. A crash in between leaves stale shards that are
+   ignored rather than replayed twice. A shard is compacted into users.db
+   at exit, or once it outgrows both its share of JOURNAL_MAX_BYTES and of
+   1/16 of users.db. That keeps the amortized rewrite cost per update
+   independent of the database size. */
+#define JOURNAL_MAX_BYTES (64*1024)
+#define JOURNAL_SHARDS 8
+#define JOURNAL_MAX_SHARDS 64
+
+int journal_shards = JOURNAL_SHARDS;    /* CPLAYGROUND_SHARDS; same for every process on a db */
+
+/* Leaderboard hooks, defined with the leaderboard below. */
+_Thread_local int lb_settling;      /* set while a session writes deltas the board already counts */
+void lb_journal_begin(int shard);
+void lb_journal_appended(const char *name, int dgp, int dgw, int dq, int settling);
+void lb_journal_end(int shard, long end_off);
+void lb_db_saved(const User *arr, int n, long gen);
+
+/* Shard k's file; k = -1 is the single journal of older versions, still
+   read so that it gets folded in. */
+void journal_path(char *out, size_t n, int k){
+    if(k < 0) snprintf(out, n, "%s.journal", users_db_path);
+    else snprintf(out, n, "%s.journal.%d", users_db_path, k);
+}
+
+int journal_shard_of(const char *username){ return (int)(name_hash(username) % (uint32_t)journal_shards); }
+
+long read_db_gen(void){
+    FILE *f = fopen(users_db_path, "rb");
+    if(!f) return 0;
+    union { BinHeader h; char line[64]; } buf;
+    long gen = 0;
+    size_t got = fread(&buf, 1, sizeof buf, f);
+    if(got==sizeof buf && buf.h.magic==BIN_MAGIC) gen = (long)buf.h.gen;
+    else {
+        buf.line[got < sizeof buf ? got : sizeof buf - 1] = '\0';
+        if(sscanf(buf.line, "#gen %ld", &gen)!=1) gen = 0;
+    }
+    fclose(f);
+    return gen;
+}
+
+/* Applies one journal file to arr (slots: optional name -> index+1 table)
+   and returns the offset up to which it was read (0 if it does not apply).
+   A last line without its newline is a commit still being written and is
+   left for later. */
+long journal_replay_file(const char *path, User *arr, int n, long gen, const int *slots, uint32_t mask){
+    FILE *f = fopen(path, "r");
+    if(!f) return 0;
+    char line[512]; long jgen;
+    if(!fgets(line, sizeof line, f) || sscanf(line, "#gen %ld", &jgen)!=1 || jgen!=gen){ fclose(f); return 0; }
+    size_t L = strlen(arr[0].username);
+    long end = ftell(f);
+    while(fgets(line, sizeof line, f)){
+        char user[MAX_USER], ll[32], hash[HASH_FIELD];
+        int dgp, dgw, dq;
+        if(!strchr(line, '\n')) break;
+        end = ftell(f);
+        if(n==1 && (strncmp(line, arr[0].username, L)!=0 || line[L]!=' ')) continue;
+        int items = sscanf(line, "%63s %d %d %d %31s %127s", user, &dgp, &dgw, &dq, ll, hash);
+        if(items < 5) continue;
+        int idx = -1;
+        if(slots){
+            for(uint32_t p = name_hash(user) & mask; slots[p]; p = (p+1) & mask)
+                if(strcmp(arr[slots[p]-1].username, user)==0){ idx = slots[p]-1; break; }
+        } else {
+            for(int i=0;i<n;i++) if(strcmp(arr[i].username, user)==0){ idx = i; break; }
+        }
+        if(idx<0) continue;
+        arr[idx].games_played += dgp;
+        arr[idx].games_won += dgw;
+        arr[idx].quizzes += dq;
+        if(strcmp(ll,"-")!=0) snprintf(arr[idx].last_login, sizeof arr[idx].last_login, "%s", ll);
+        if(items==6) snprintf(arr[idx].hash, sizeof arr[idx].hash, "%s", hash);
+    }
+    fclose(f);
+    return end;
+}
+
+/* Replays the journal for generation gen onto arr. A single user only
+   needs its own shard. offs (optional) receives how far each shard
+   was read. */
+void journal_replay(User *arr, int n, long gen, long *offs){
+    char path[300];
+    if(offs) memset(offs, 0, JOURNAL_MAX_SHARDS * sizeof *offs);
+    if(n == 0) return;
+    if(n == 1){
+        int k = journal_shard_of(arr[0].username);
+        journal_path(path, sizeof path, k);
+        long end = journal_replay_file(path, arr, 1, gen, NULL, 0);
+        if(offs) offs[k] = end;
+        journal_path(path, sizeof path, -1);
+        journal_replay_file(path, arr, 1, gen, NULL, 0);
+        return;
+    }
+    int *slots = NULL; uint32_t mask = 0;
+    if(n > 8){
+        uint32_t ns = 16;
+        while(ns < 2u*(uint32_t)n) ns <<= 1;
+        slots = calloc(ns, sizeof(int)); mask = ns-1;
+        if(slots) for(int i=0;i<n;i++){
+            uint32_t p = name_hash(arr[i].username) & mask;
+            while(slots[p]) p = (p+1) & mask;
+            slots[p] = i+1;
+        }
+    }
+    for(int k=-1;k<JOURNAL_MAX_SHARDS;k++){
+        journal_path(path, sizeof path, k);
+        long end = journal_replay_file(path, arr, n, gen, slots, mask);
+        if(offs && k >= 0) offs[k] = end;
+    }
+    free(slots);
+}
+
+void journal_remove_all(void){
+    char path[300];
+    for(int k=-1;k<JOURNAL_MAX_SHARDS;k++){ journal_path(path, sizeof path, k); remove(path); }
+}
+
+/* 1 if any journal file was written with another shard count (or is the
+   old single journal), so single-user lookups could miss records. */
+int journal_layout_stale(void){
+    char path[300], line[64];
+    struct stat st;
+    journal_path(path, sizeof path, -1);
+    if(stat(path, &st) == 0) return 1;
+    for(int k=0;k<JOURNAL_MAX_SHARDS;k++){
+        journal_path(path, sizeof path, k);
+        FILE *f = fopen(path, "r");
+        if(!f) continue;
+        long gen; int shards = 0;
+        int stale = !fgets(line, sizeof line, f) || sscanf(line, "#gen %ld shards %d", &gen, &shards)!=2 || shards!=journal_shards;
+        fclose(f);
+        if(stale) return 1;
+    }
+    return 0;
+}
+
+/* Advertises this process's shard count with a shared lock on byte
+   1 + JOURNAL_MAX_SHARDS + journal_shards of the lock file. Returns 0 if a
+   live process on the same database holds one for another count: each
+   would put records in shards the other's single-user lookups never read.
+   The locks go away with their processes. */
+int journal_claim_layout(void){
+#ifndef _WIN32
+    pthread_mutex_lock(&db_gate.mu);
+    int fd = db_lock_file();
+    pthread_mutex_unlock(&db_gate.mu);
+    if(fd < 0) return 1;
+    long base = 1 + JOURNAL_MAX_SHARDS;
+    db_flock(fd, F_RDLCK, base + journal_shards);
+    long others[2][2] = { { base + 1, journal_shards - 1 },     /* start, length */
+                          { base + journal_shards + 1, JOURNAL_MAX_SHARDS - journal_shards } };
+    for(int i=0;i<2;i++){
+        if(others[i][1] <= 0) continue;     /* l_len 0 would mean "to EOF" */
+        struct flock fl;
+        memset(&fl, 0, sizeof fl);
+        fl.l_type = F_WRLCK; fl.l_whence = SEEK_SET; fl.l_start = others[i][0]; fl.l_len = others[i][1];
+        if(fcntl(fd, F_GETLK, &fl) == 0 && fl.l_type != F_UNLCK) return 0;
+    }
+#endif
+    return 1;
+}
+
+/* Loads users.db with the journal applied; joff (optional) receives how far
+   each shard was replayed. */
+int load_users_at(User **arr_out, long *joff){
+    ensure_data_dir();
+    if(joff) memset(joff, 0, JOURNAL_MAX_SHARDS * sizeof *joff);
+    if(db_is_binary()){
+        const BinHeader *h = bin_open();
+        if(!h || h->count==0){ *arr_out = NULL; return 0; }
+        User *arr = malloc((size_t)h->count * sizeof(User));
+        if(!arr){ *arr_out = NULL; return 0; }
+        for(uint32_t i=0;i<h->count;i++) bin_to_user(&bin_records(h)[i], &arr[i]);
+        journal_replay(arr, (int)h->count, (long)h->gen, joff);
+        *arr_out = arr;
+        return (int)h->count;
+    }
+    /* Text: map the file, count lines to size the array exactly, then split
+       with memchr (vectorized in libc) and parse each line in place. */
+    MappedFile m;
+    if(!map_file(users_db_path, &m)){ *arr_out = NULL; return 0; }
+    const char *p = (const char*)m.data, *end = p + m.size;
+    size_t lines = 0;
+    for(const char *q = p; q < end; ){
+        const char *nl = memchr(q, '\n', (size_t)(end - q));
+        lines++;
+        if(!nl) break;
+        q = nl + 1;
+    }
+    User *arr = lines ? malloc(lines * sizeof(User)) : NULL;
+    if(lines && !arr){ unmap_file(&m); *arr_out = NULL; return 0; }
+    int n = 0;
+    long gen = 0;
+    if(p < end && *p=='#'){
+        char hdr[64];
+        size_t len = (size_t)(end - p) < sizeof hdr - 1 ? (size_t)(end - p) : sizeof hdr - 1;
+        memcpy(hdr, p, len); hdr[len] = '\0';
+        sscanf(hdr, "#gen %ld", &gen);
+    }
+    while(p < end){
+        const char *nl = memchr(p, '\n', (size_t)(end - p));
+        const char *le = nl ? nl : end;
+        if(parse_user_range(p, le, &arr[n])) n++;
+        p = le + 1;
+    }
+    unmap_file(&m);
+    journal_replay(arr, n, gen, joff);
+    *arr_out = arr;
+    return n;
+}
+
+int load_users_nolock(User **arr_out){ return load_users_at(arr_out, NULL); }
+
+int load_users(User **arr_out){
+    PROF_BEGIN();
+    db_lock();
+    int n = load_users_nolock(arr_out);
+    db_unlock();
+    PROF_END(PROF_LOAD_USERS);
+    return n;
+}
+
+/* ---------- User index ----------
+   <users.db>.idx is an open-addressing hash table keyed by username. Each slot
+   holds the offset and length of that user's line in users.db, so a lookup
+   probes a few slots and parses one line instead of the whole file. The header
+   records size and mtime of the users.db it was built from; on mismatch the
+   index is stale and gets rebuilt by the next lookup. */
+#define IDX_MAGIC 0x58495043u /* "CPIX" */
+#define IDX_VERSION 1
+
+typedef struct {
+    uint32_t magic, version, nslots, count;
+    int64_t db_size, db_mtime;
+} IdxHeader;
+
+typedef struct {
+    uint64_t off;      /* line offset + 1, 0 = empty slot */
+    uint32_t hash, len;
+} IdxSlot;
+
+void idx_path(char *out, size_t n){ snprintf(out, n, "%s.idx", users_db_path); }
+
+int idx_write(const IdxSlot *entries, int n){
+    struct stat st;
+    if(stat(users_db_path, &st) != 0) return 0;
+    uint32_t nslots = 16;
+    while(nslots < 2u*(uint32_t)n) nslots <<= 1;
+    IdxSlot *slots = calloc(nslots, sizeof(IdxSlot));
+    if(!slots) return 0;
+    for(int i=0;i<n;i++){
+        uint32_t p = entries[i].hash & (nslots-1);
+        while(slots[p].off) p = (p+1) & (nslots-1);
+        slots[p] = entries[i];
+    }
+    IdxHeader h = { IDX_MAGIC, IDX_VERSION, nslots, (uint32_t)n, (int64_t)st.st_size, (int64_t)st.st_mtime };
+    char path[300], tmp[310];
+    idx_path(path, sizeof path);
+    snprintf(tmp, sizeof tmp, "%s.tmp", path);
+    FILE *f = fopen(tmp, "wb");
+    if(!f){ free(slots); return 0; }
+    int ok = fwrite(&h, sizeof h, 1, f)==1 && fwrite(slots, sizeof(IdxSlot), nslots, f)==nslots;
+    ok = (fclose(f)==0) && ok;
+    db_bytes_written += sizeof h + (long long)nslots * sizeof(IdxSlot);
+    free(slots);
+    if(!ok){ remove(tmp); return 0; }
+    remove(path);
+    return rename(tmp, path)==0;
+}
+
+int idx_rebuild(void){
+    if(db_is_binary()) return 0;
+    FILE *f = fopen(users_db_path, "r");
+    if(!f) return 0;
+    IdxSlot *e = NULL; int cap=0, n=0;
+    char line[512];
+    long off = 0;
+    while(fgets(line, sizeof line, f)){
+        long next = ftell(f);
+        User u;
+        if(parse_user_line(line, &u)){
+            if(n+1 > cap){ cap = cap?cap*2:64; e = realloc(e, cap * sizeof(IdxSlot)); }
+            e[n].off = (uint64_t)off + 1;
+            e[n].len = (uint32_t)(next - off);
+            e[n].hash = name_hash(u.username);
+            n++;
+        }
+        off = next;
+    }
+    fclose(f);
+    int ok = idx_write(e, n);
+    free(e);
+    return ok;
+}
+
+/* Returns 1 and fills *out if found, 0 if not, -1 if the index is missing or stale. */
+int idx_lookup(const char *username, User *out){
+    char path[300];
+    idx_path(path, sizeof path);
+    struct stat st;
+    if(stat(users_db_path, &st) != 0) return 0;
+    FILE *fi = fopen(path, "rb");
+    if(!fi) return -1;
+    IdxHeader h;
+    if(fread(&h, sizeof h, 1, fi)!=1 || h.magic!=IDX_MAGIC || h.version!=IDX_VERSION ||
+       h.nslots==0 || (h.nslots & (h.nslots-1)) ||
+       h.db_size!=(int64_t)st.st_size || h.db_mtime!=(int64_t)st.st_mtime){
+        fclose(fi); return -1;
+    }
+    FILE *fd = fopen(users_db_path, "r");
+    if(!fd){ fclose(fi); return -1; }
+    uint32_t hash = name_hash(username), p = hash & (h.nslots-1);
+    int found = 0;
+    for(uint32_t probes=0; probes<h.nslots; probes++, p=(p+1)&(h.nslots-1)){
+        IdxSlot s;
+        if(fseek(fi, (long)(sizeof h + (size_t)p*sizeof s), SEEK_SET)!=0 || fread(&s, sizeof s, 1, fi)!=1){ found=-1; break; }
+        if(!s.off) break;
+        if(s.hash!=hash) continue;
+        char line[512];
+        size_t len = s.len < sizeof line-1 ? s.len : sizeof line-1;
+        if(fseek(fd, (long)(s.off-1), SEEK_SET)!=0 || fread(line, 1, len, fd)!=len){ found=-1; break; }
+        line[len] = '\0';
+        User u;
+        if(parse_user_line(line, &u) && strcmp(u.username, username)==0){ *out = u; found=1; break; }
+    }
+    fclose(fd); fclose(fi);
+    return found;
+}
+
+/* Writes arr as the new users.db in text or binary format. arr must already
+   include the journal (i.e. come from load_users()); the journal is dropped
+   afterwards. The new file is on disk before it replaces the old one. */
+int save_users_as_nolock(User *arr, int n, int binary){
+    ensure_data_dir();
+    char tmp[300];
+    snprintf(tmp, sizeof tmp, "%s.tmp", users_db_path);
+    long gen = read_db_gen() + 1;
+    if(binary){
+        if(!bin_write(tmp, arr, n, gen)){ remove(tmp); return 0; }
+        if(!replace_file(tmp, users_db_path)) return 0;
+        journal_remove_all();
+        idx_path(tmp, sizeof tmp);
+        remove(tmp);
+        lb_db_saved(arr, n, gen);
+        return 1;
+    }
+    FILE *f = fopen(tmp, "w");
+    if(!f) return 0;
+    IdxSlot *e = malloc((n>0?n:1) * sizeof(IdxSlot));
+    long off = fprintf(f, "#gen %ld\n", gen);
+    for(int i=0;i<n;i++){
+        int len = fprintf(f, "%s %s %d %d %d %s\n",
+                arr[i].username,
+                arr[i].hash,
+                arr[i].games_played,
+                arr[i].games_won,
+                arr[i].quizzes,
+                arr[i].last_login[0]?arr[i].last_login:"-");
+        if(e){
+            e[i].off = (uint64_t)off + 1;
+            e[i].len = (uint32_t)len;
+            e[i].hash = name_hash(arr[i].username);
+        }
+        off += len;
+    }
+    int ok = sync_file(f);
+    ok = fclose(f) == 0 && ok;
+    db_bytes_written += off;
+    if(!ok){ remove(tmp); free(e); return 0; }
+    if(!replace_file(tmp, users_db_path)){ free(e); return 0; }
+    journal_remove_all();
+    if(e){ idx_write(e, n); free(e); }
+    lb_db_saved(arr, n, gen);
+    return 1;
+}
+
+int save_users_as(User *arr, int n, int binary){
+    PROF_BEGIN();
+    db_lock();
+    int ok = save_users_as_nolock(arr, n, binary);
+    db_unlock();
+    PROF_END(PROF_SAVE_USERS);
+    return ok;
+}
+
+/* Saves in the format users.db already has (text for a new database). */
+int save_users(User *arr, int n){
+    return save_users_as(arr, n, db_is_binary());
+}
+
+/* Folds the journal into users.db. */
+int db_compact(void){
+    db_lock();
+    int any = 0;
+    char path[300];
+    struct stat st;
+    for(int k=-1;k<JOURNAL_MAX_SHARDS && !any;k++){ journal_path(path, sizeof path, k); any = stat(path, &st) == 0; }
+    int ok = 1;
+    if(any){
+        User *arr; int n = load_users(&arr);
+        ok = save_users(arr, n);
+        free(arr);
+    }
+    db_unlock();
+    return ok;
+}
+
+/* Folds shard k into users.db if it is still over its size threshold once
+   the exclusive lock is held; writers that saw the same full shard queue
+   up here, and only the first one compacts. */
+int journal_compact_if_full(int k){
+    db_lock();
+    char path[300];
+    struct stat js, st;
+    journal_path(path, sizeof path, k);
+    long share = JOURNAL_MAX_BYTES / journal_shards;
+    int ok = 1;
+    if(stat(path, &js) == 0 && js.st_size > share &&
+       (stat(users_db_path, &st)!=0 || js.st_size > st.st_size/16/journal_shards)) ok = db_compact();
+    db_unlock();
+    return ok;
+}
+
+/* Group commit state of one shard. `cur` collects records until a
+   committer swaps it for `spare` and writes it; byte counts in queue order
+   tell each writer when its record is on disk, and the committer stores the
+   batch's result in each record's `ok` slot. */
+typedef struct { char name[MAX_USER]; int dgp, dgw, dq, settling; int *ok; } JournalRec;
+typedef struct { char *buf; size_t len, cap; JournalRec *recs; int n, rcap; } JournalBatch;
+
+typedef struct {
+    pthread_mutex_t mu;
+    pthread_cond_t cv;
+    JournalBatch cur, spare;
+    uint64_t queued, durable;       /* bytes queued / committed so far */
+    int committing;
+    long size;                      /* shard file size after the last commit */
+    long long commits, records;
+} JournalShard;
+
+JournalShard jshards[JOURNAL_MAX_SHARDS];
+pthread_once_t jshards_once = PTHREAD_ONCE_INIT;
+
+void jshards_init(void){
+    for(int k=0;k<JOURNAL_MAX_SHARDS;k++){
+        pthread_mutex_init(&jshards[k].mu, NULL);
+        pthread_cond_init(&jshards[k].cv, NULL);
+    }
+}
+
+/* 1 if the shard file at path belongs to an older users.db generation. A
+   crash between replacing users.db and dropping the journal leaves such a
+   shard behind; its records are already in users.db, and replay ignores
+   anything appended to it. */
+int journal_shard_stale(const char *path, long gen){
+    FILE *f = fopen(path, "r");
+    if(!f) return 0;
+    char line[64]; long jgen;
+    int stale = fgets(line, sizeof line, f) && (sscanf(line, "#gen %ld", &jgen)!=1 || jgen != gen);
+    fclose(f);
+    return stale;
+}
+
+/* Writes shard k's queued records with one write and one fdatasync. Called
+   with sh->mu held and with db_lock(), or with db_lock_shared() and the
+   shard's file lock; sh->mu is dropped during the I/O so the next batch
+   can queue up. */
+void journal_commit(JournalShard *sh, int k){
+    if(sh->cur.len == 0) return;
+    JournalBatch b = sh->cur;
+    sh->cur = sh->spare;
+    memset(&sh->spare, 0, sizeof sh->spare);
+    uint64_t end = sh->queued;
+    pthread_mutex_unlock(&sh->mu);
+
+    char path[300], hdr[64];
+    journal_path(path, sizeof path, k);
+    int hl = 0, ok = 0;
+    long size = -1, gen = read_db_gen();         /* size -1: unknown */
+    int stale = journal_shard_stale(path, gen);     /* start it over */
+    lb_journal_begin(k);
+#ifndef _WIN32
+    int fd = open(path, O_WRONLY | O_APPEND | O_CREAT | (stale ? O_TRUNC : 0), 0644);
+    struct stat st;
+    if(fd >= 0 && fstat(fd, &st) == 0){
+        if(st.st_size == 0) hl = snprintf(hdr, sizeof hdr, "#gen %ld shards %d\n", gen, journal_shards);
+        ok = write(fd, hdr, hl) == hl && write(fd, b.buf, b.len) == (ssize_t)b.len && fdatasync(fd) == 0;
+        if(ok) size = (long)st.st_size + hl + (long)b.len;
+        else if(ftruncate(fd, st.st_size) == 0) size = (long)st.st_size;    /* drop a partial line */
+    }
+    if(fd >= 0) close(fd);
+#else
+    FILE *f = fopen(path, stale ? "wb" : "ab");
+    if(f){
+        fseek(f, 0, SEEK_END);
+        long start = ftell(f);
+        if(start == 0) hl = fprintf(f, "#gen %ld shards %d\n", gen, journal_shards);
+        ok = hl >= 0 && fwrite(b.buf, 1, b.len, f) == b.len && fflush(f) == 0;
+        if(ok) size = ftell(f);
+        else if(_chsize(_fileno(f), start) == 0) size = start;
+        ok = fclose(f) == 0 && ok;
+    }
+#endif
+    db_bytes_written += hl + (long long)b.len;
+    if(ok) for(int i=0;i<b.n;i++) lb_journal_appended(b.recs[i].name, b.recs[i].dgp, b.recs[i].dgw, b.recs[i].dq, b.recs[i].settling);
+    lb_journal_end(k, ok ? size : -1);
+
+    pthread_mutex_lock(&sh->mu);
+    for(int i=0;i<b.n;i++) *b.recs[i].ok = ok;
+    sh->durable = end;
+    if(size >= 0) sh->size = size;
+    sh->commits++; sh->records += b.n;
+    b.len = 0; b.n = 0;
+    sh->spare = b;
+    pthread_cond_broadcast(&sh->cv);
+}
+
+/* Appends one delta record and returns once it is on disk (0 if its batch
+   failed); last_login and hash may be NULL to leave them unchanged.
+   Compacts once the shard grows too large. */
+int journal_append(const char *username, int dgp, int dgw, int dq, const char *last_login, const char *hash){
+    PROF_BEGIN();
+    ensure_data_dir();
+    pthread_once(&jshards_once, jshards_init);
+    int k = journal_shard_of(username);
+    JournalShard *sh = &jshards[k];
+    char line[MAX_USER + HASH_FIELD + 96];
+    int len = snprintf(line, sizeof line, "%s %d %d %d %s%s%s\n", username, dgp, dgw, dq,
+                       last_login && last_login[0] ? last_login : "-", hash ? " " : "", hash ? hash : "");
+    pthread_mutex_lock(&sh->mu);
+    JournalBatch *b = &sh->cur;
+    if(b->len + len > b->cap){
+        size_t cap = b->cap ? b->cap : 4096;
+        while(b->len + len > cap) cap *= 2;
+        char *buf = realloc(b->buf, cap);
+        if(!buf){ pthread_mutex_unlock(&sh->mu); PROF_END(PROF_JOURNAL_APPEND); return 0; }
+        b->buf = buf; b->cap = cap;
+    }
+    if(b->n == b->rcap){
+        int rcap = b->rcap ? b->rcap*2 : 64;
+        JournalRec *recs = realloc(b->recs, rcap * sizeof *recs);
+        if(!recs){ pthread_mutex_unlock(&sh->mu); PROF_END(PROF_JOURNAL_APPEND); return 0; }
+        b->recs = recs; b->rcap = rcap;
+    }
+    memcpy(b->buf + b->len, line, len);
+    b->len += len;
+    JournalRec *r = &b->recs[b->n++];
+    strcpy(r->name, username);
+    r->dgp = dgp; r->dgw = dgw; r->dq = dq; r->settling = lb_settling;
+    int ok = 0;
+    r->ok = &ok;
+    uint64_t mine = sh->queued += len;
+    if(db_lock_depth > 0) journal_commit(sh, k);    /* nobody else can commit now */
+    while(sh->durable < mine){
+        if(sh->committing){ pthread_cond_wait(&sh->cv, &sh->mu); continue; }
+        sh->committing = 1;
+        pthread_mutex_unlock(&sh->mu);
+        db_lock_shared();
+        journal_shard_lock(k);
+        pthread_mutex_lock(&sh->mu);
+        journal_commit(sh, k);
+        pthread_mutex_unlock(&sh->mu);
+        journal_shard_unlock(k);
+        db_unlock_shared();
+        pthread_mutex_lock(&sh->mu);
+        sh->committing = 0;
+        pthread_cond_broadcast(&sh->cv);
+    }
+    long size = sh->size;
+    pthread_mutex_unlock(&sh->mu);
+    if(ok && size > JOURNAL_MAX_BYTES / journal_shards) journal_compact_if_full(k);
+    PROF_END(PROF_JOURNAL_APPEND);
+    return ok;
+}
+
+int find_user_index(User *arr, int n, const char *username){
+    PROF_BEGIN();
+    int idx = -1;
+    if(arr) for(int i=0;i<n;i++) if(strcmp(arr[i].username, username)==0){ idx = i; break; }
+    PROF_END(PROF_FIND_USER_INDEX);
+    return idx;
+}
+
+/* Single-user lookup through the mmapped binary DB or the text index; falls
+   back to a full scan only if the index cannot be (re)built. */
+int db_find_user_nolock(const char *username, User *out){
+    int r;
+    if(db_is_binary()) r = bin_lookup(username, out);
+    else {
+        r = idx_lookup(username, out);
+        if(r < 0 && idx_rebuild()) r = idx_lookup(username, out);
+    }
+    if(r == 1) journal_replay(out, 1, read_db_gen(), NULL);
+    if(r >= 0) return r;
+    User *arr; int n = load_users(&arr);
+    int idx = find_user_index(arr, n, username);
+    if(idx!=-1) *out = arr[idx];
+    free(arr);
+    return idx!=-1;
+}
+
+int db_find_user(const char *username, User *out){
+    PROF_BEGIN();
+    db_lock();
+    int r = db_find_user_nolock(username, out);
+    db_unlock();
+    PROF_END(PROF_DB_FIND_USER);
+    return r;
+}
+
+/* ---------- Session cache ----------
+   The logged-in user's record is read once at login. Stat changes update the
+   cached copy and accumulate as pending deltas, which are written back as one
+   journal record at logout, every session_flush_secs seconds, or at exit
+   (including Ctrl-C, via install_signal_handlers() and atexit). */
+#define SESSION_FLUSH_SECS 300
+
+typedef struct {
+    int active, dirty;
+    User user;              /* disk record with pending deltas applied */
+    int dgp, dgw, dq;       /* pending deltas */
+    char last_login[32];    /* pending last_login, "" if unchanged */
+    double last_flush;
+} Session;
+
+_Thread_local Session session;  /* one per connection in --serve mode */
+int session_flush_secs = SESSION_FLUSH_SECS;
+
+void session_flush(void){
+    if(!session.active || !session.dirty) return;
+    lb_settling = 1;
+    int ok = journal_append(session.user.username, session.dgp, session.dgw, session.dq, session.last_login, NULL);
+    lb_settling = 0;
+    if(ok){
+        session.dgp = session.dgw = session.dq = 0;
+        session.last_login[0] = '\0';
+        session.dirty = 0;
+    }
+    session.last_flush = now_sec();
+}
+
+void session_begin(const User *u){
+    session_flush();
+    memset(&session, 0, sizeof session);
+    session.user = *u;
+    session.active = 1;
+    session.last_flush = now_sec();
+}
+
+void session_end(void){
+    session_flush();
+    session.active = 0;
+}
+
+/* Returns the cached record if username is the logged-in user, else NULL. */
+User *session_user(const char *username){
+    if(session.active && strcmp(session.user.username, username)==0) return &session.user;
+    return NULL;
+}
+
+void session_touch(void){
+    session.dirty = 1;
+    if(session_flush_secs >= 0 && now_sec() - session.last_flush >= session_flush_secs) session_flush();
+}
+
+/* ---------- Leaderboard ----------
+   Top-K by games won, win rate and quizzes from indexable skip lists: every
+   link stores how many nodes it skips, so rank and "K-th entry" are
+   O(log n) and a top-K page is O(log n + K). Lists are ordered by score
+   (descending) and then username.
+
+   The board is built once per process from users.db plus the journal. After
+   that it follows stat changes incrementally:
+   - Session increments count at once as pending deltas. They are settled
+     (not counted twice) when the session flushes them to the journal.
+   - Journal records written by this process are applied as they are
+     appended.
+   - Records appended by other processes are picked up by tailing the
+     journal from the last offset seen.
+   A rewrite of users.db by this process rebuilds from the saved array; a new
+   generation written elsewhere rebuilds from disk. Pending deltas live in
+   their own table, so they survive rebuilds. */
+#define LB_MAX_LEVEL 24
+#define LB_MIN_GAMES 5      /* games needed to be ranked by win rate */
+
+enum { LB_WINS, LB_RATE, LB_QUIZZES, LB_METRICS };
+
+typedef struct LbNode LbNode;
+struct LbNode {
+    int64_t score;
+    int user, level;
+    struct { LbNode *next; int span; } lv[];
+};
+
+typedef struct { LbNode *head; int level, len; } SkipList;
+
+typedef struct { char name[MAX_USER]; int gp, gw, q; LbNode *node[LB_METRICS]; } LbUser;
+typedef struct { char name[MAX_USER]; int dgp, dgw, dq; } LbPending;
+typedef struct { char name[MAX_USER]; int rank, gp, gw, q; int64_t score; } LbRow;
+
+typedef struct {
+    int loaded;
+    char path[256];             /* users.db the board was built from */
+    long gen;                   /* its generation */
+    long joff[JOURNAL_MAX_SHARDS];  /* how much of each journal shard is applied */
+    int busy[JOURNAL_MAX_SHARDS];   /* shard has a commit in flight */
+    LbUser *users; int nusers;
+    int *slots; uint32_t mask;  /* username -> users[] index + 1 */
+    SkipList list[LB_METRICS];
+    LbPending *pend; int npend, cpend;
+    uint64_t rng;
+} Leaderboard;
+
+Leaderboard lb;
+pthread_mutex_t lb_mu = PTHREAD_MUTEX_INITIALIZER;
+const char *lb_metric_names[LB_METRICS] = {"games won", "win rate", "quizzes"};
+
+int64_t lb_score(const LbUser *u, int metric){
+    if(metric == LB_WINS) return u->gw;
+    if(metric == LB_QUIZZES) return u->q;
+    return u->gp >= LB_MIN_GAMES ? (int64_t)u->gw * 1000000 / u->gp : -1;  /* ppm; -1 = unranked */
+}
+
+/* Whether node n sorts before (score, name). */
+static inline int lb_before(const LbNode *n, int64_t score, const char *name){
+    return n->score > score || (n->score == score && strcmp(lb.users[n->user].name, name) < 0);
+}
+
+LbNode *lb_node_new(int level, int64_t score, int user){
+    LbNode *n = malloc(sizeof *n + level * sizeof n->lv[0]);
+    n->score = score; n->user = user; n->level = level;
+    for(int i=0;i<level;i++){ n->lv[i].next = NULL; n->lv[i].span = 0; }
+    return n;
+}
+
+int lb_random_level(void){
+    uint64_t r = splitmix64(&lb.rng);
+    int level = 1;
+    while((r & 3) == 0 && level < LB_MAX_LEVEL){ level++; r >>= 2; }   /* p = 1/4 */
+    return level;
+}
+
+LbNode *sl_insert(SkipList *sl, int64_t score, int user){
+    LbNode *update[LB_MAX_LEVEL], *x = sl->head;
+    int rank[LB_MAX_LEVEL];
+    const char *name = lb.users[user].name;
+    for(int i=sl->level-1;i>=0;i--){
+        rank[i] = i == sl->level-1 ? 0 : rank[i+1];
+        while(x->lv[i].next && lb_before(x->lv[i].next, score, name)){ rank[i] += x->lv[i].span; x = x->lv[i].next; }
+        update[i] = x;
+    }
+    int level = lb_random_level();
+    for(int i=sl->level;i<level;i++){ rank[i] = 0; update[i] = sl->head; sl->head->lv[i].span = sl->len; }
+    if(level > sl->level) sl->level = level;
+    x = lb_node_new(level, score, user);
+    for(int i=0;i<level;i++){
+        x->lv[i].next = update[i]->lv[i].next;
+        update[i]->lv[i].next = x;
+        x->lv[i].span = update[i]->lv[i].span - (rank[0] - rank[i]);
+        update[i]->lv[i].span = rank[0] - rank[i] + 1;
+    }
+    for(int i=level;i<sl->level;i++) update[i]->lv[i].span++;
+    sl->len++;
+    return x;
+}
+
+void sl_delete(SkipList *sl, LbNode *node){
+    LbNode *update[LB_MAX_LEVEL], *x = sl->head;
+    const char *name = lb.users[node->user].name;
+    for(int i=sl->level-1;i>=0;i--){
+        while(x->lv[i].next && lb_before(x->lv[i].next, node->score, name)) x = x->lv[i].next;
+        update[i] = x;
+    }
+    for(int i=0;i<sl->level;i++){
+        if(update[i]->lv[i].next == node){
+            update[i]->lv[i].span += node->lv[i].span - 1;
+            update[i]->lv[i].next = node->lv[i].next;
+        } else update[i]->lv[i].span--;
+    }
+    while(sl->level > 1 && !sl->head->lv[sl->level-1].next) sl->level--;
+    sl->len--;
+    free(node);
+}
+
+/* Number of entries that sort before (score, name). */
+int sl_rank(const SkipList *sl, int64_t score, const char *name){
+    const LbNode *x = sl->head;
+    int r = 0;
+    for(int i=sl->level-1;i>=0;i--)
+        while(x->lv[i].next && lb_before(x->lv[i].next, score, name)){ r += x->lv[i].span; x = x->lv[i].next; }
+    return r;
+}
+
+/* Entry at 0-based position pos, or NULL. */
+LbNode *sl_at(const SkipList *sl, int pos){
+    LbNode *x = sl->head;
+    int seen = 0;
+    for(int i=sl->level-1;i>=0;i--){
+        while(x->lv[i].next && seen + x->lv[i].span <= pos + 1){ seen += x->lv[i].span; x = x->lv[i].next; }
+        if(seen == pos + 1) return x;
+    }
+    return NULL;
+}
+
+void sl_free(SkipList *sl){
+    if(!sl->head) return;
+    for(LbNode *x = sl->head->lv[0].next, *next; x; x = next){ next = x->lv[0].next; free(x); }
+    free(sl->head);
+    sl->head = NULL;
+}
+
+int lb_metric_sort;
+int lb_cmp_users(const void *a, const void *b){
+    const LbUser *x = &lb.users[*(const int*)a], *y = &lb.users[*(const int*)b];
+    int64_t sx = lb_score(x, lb_metric_sort), sy = lb_score(y, lb_metric_sort);
+    if(sx != sy) return sx > sy ? -1 : 1;
+    return strcmp(x->name, y->name);
+}
+
+/* Links pre-sorted users into a fresh list in O(n). */
+void sl_build(SkipList *sl, int metric, const int *order, int n){
+    LbNode *last[LB_MAX_LEVEL];
+    int lastpos[LB_MAX_LEVEL];
+    sl->head = lb_node_new(LB_MAX_LEVEL, 0, -1);
+    sl->level = 1; sl->len = 0;
+    for(int i=0;i<LB_MAX_LEVEL;i++){ last[i] = sl->head; lastpos[i] = 0; }
+    for(int k=0;k<n;k++){
+        int64_t s = lb_score(&lb.users[order[k]], metric);
+        if(s < 0) continue;
+        int level = lb_random_level(), pos = ++sl->len;
+        LbNode *x = lb_node_new(level, s, order[k]);
+        lb.users[order[k]].node[metric] = x;
+        for(int i=0;i<level;i++){
+            last[i]->lv[i].next = x;
+            last[i]->lv[i].span = pos - lastpos[i];
+            last[i] = x; lastpos[i] = pos;
+        }
+        if(level > sl->level) sl->level = level;
+    }
+    for(int i=0;i<sl->level;i++) last[i]->lv[i].span = sl->len - lastpos[i];
+}
+
+int lb_find(const char *name){
+    if(!lb.slots) return -1;
+    for(uint32_t p = name_hash(name) & lb.mask; lb.slots[p]; p = (p+1) & lb.mask)
+        if(strcmp(lb.users[lb.slots[p]-1].name, name)==0) return lb.slots[p]-1;
+    return -1;
+}
+
+LbPending *lb_pending_find(const char *name){
+    for(int i=0;i<lb.npend;i++) if(strcmp(lb.pend[i].name, name)==0) return &lb.pend[i];
+    return NULL;
+}
+
+void lb_clear(void){
+    for(int m=0;m<LB_METRICS;m++) sl_free(&lb.list[m]);
+    free(lb.users); free(lb.slots);
+    lb.users = NULL; lb.slots = NULL; lb.nusers = 0;
+    lb.loaded = 0;
+}
+
+/* Rebuilds from a full user array (plus pending deltas). joff gives how far
+   each journal shard is already included in arr; NULL if the journal was
+   empty. Caller holds lb_mu. */
+void lb_build(const User *arr, int n, long gen, const long *joff){
+    lb_clear();
+    if(!lb.rng) lb.rng = 0x1eade7b0a7dULL;
+    lb.users = calloc(n > 0 ? n : 1, sizeof(LbUser));
+    uint32_t ns = 16;
+    while(ns < 2u*(uint32_t)n) ns <<= 1;
+    lb.slots = calloc(ns, sizeof(int)); lb.mask = ns - 1;
+    int *order = malloc((n > 0 ? n : 1) * sizeof(int));
+    if(!lb.users || !lb.slots || !order){ free(order); lb_clear(); return; }
+    for(int i=0;i<n;i++){
+        LbUser *u = &lb.users[i];
+        strcpy(u->name, arr[i].username);
+        u->gp = arr[i].games_played; u->gw = arr[i].games_won; u->q = arr[i].quizzes;
+        LbPending *p = lb_pending_find(u->name);
+        if(p){ u->gp += p->dgp; u->gw += p->dgw; u->q += p->dq; }
+        uint32_t s = name_hash(u->name) & lb.mask;
+        while(lb.slots[s]) s = (s+1) & lb.mask;
+        lb.slots[s] = i + 1;
+        order[i] = i;
+    }
+    lb.nusers = n;
+    for(int m=0;m<LB_METRICS;m++){
+        lb_metric_sort = m;
+        qsort(order, n, sizeof(int), lb_cmp_users);
+        sl_build(&lb.list[m], m, order, n);
+    }
+    free(order);
+    strcpy(lb.path, users_db_path);
+    lb.gen = gen;
+    if(joff) memcpy(lb.joff, joff, sizeof lb.joff);
+    else memset(lb.joff, 0, sizeof lb.joff);
+    lb.loaded = 1;
+}
+
+/* Applies a stat delta to one user, moving it in each list whose score changed. */
+void lb_apply(const char *name, int dgp, int dgw, int dq){
+    int i = lb.loaded ? lb_find(name) : -1;
+    if(i < 0) return;
+    LbUser *u = &lb.users[i];
+    int64_t old[LB_METRICS];
+    for(int m=0;m<LB_METRICS;m++) old[m] = lb_score(u, m);
+    u->gp += dgp; u->gw += dgw; u->q += dq;
+    for(int m=0;m<LB_METRICS;m++){
+        int64_t s = lb_score(u, m);
+        if(s == old[m]) continue;
+        if(u->node[m]){ sl_delete(&lb.list[m], u->node[m]); u->node[m] = NULL; }
+        if(s >= 0) u->node[m] = sl_insert(&lb.list[m], s, i);
+    }
+}
+
+/* Session increments: counted now, settled when the session flushes.
+   Without memory to track one, it is left to show up at the flush. */
+void lb_pending_add(const char *name, int dgp, int dgw, int dq){
+    pthread_mutex_lock(&lb_mu);
+    LbPending *p = lb_pending_find(name);
+    if(!p){
+        if(lb.npend == lb.cpend){
+            int cap = lb.cpend ? lb.cpend*2 : 16;
+            LbPending *pend = realloc(lb.pend, cap * sizeof *pend);
+            if(!pend){ pthread_mutex_unlock(&lb_mu); return; }
+            lb.pend = pend; lb.cpend = cap;
+        }
+        p = &lb.pend[lb.npend++];
+        memset(p, 0, sizeof *p);
+        strcpy(p->name, name);
+    }
+    p->dgp += dgp; p->dgw += dgw; p->dq += dq;
+    if(!p->dgp && !p->dgw && !p->dq) *p = lb.pend[--lb.npend];
+    lb_apply(name, dgp, dgw, dq);
+    pthread_mutex_unlock(&lb_mu);
+}
+
+/* Applies journal records appended since lb.joff[], rebuilding if users.db
+   was replaced. Shards with a commit in flight are skipped: their
+   committer applies its own records and moves the offset past them, and
+   a rebuild waits until none is in flight. Caller holds db_lock() or
+   db_lock_shared(), and lb_mu. */
+void lb_sync_locked(void){
+    long gen = read_db_gen();
+    if(!lb.loaded || strcmp(lb.path, users_db_path)!=0 || gen != lb.gen){
+        for(int k=0;k<journal_shards;k++) if(lb.busy[k]) return;
+        User *arr = NULL;
+        long joff[JOURNAL_MAX_SHARDS];
+        pthread_mutex_unlock(&lb_mu);   /* keep db_lock -> lb_mu ordering while loading */
+        int n = load_users_at(&arr, joff);
+        pthread_mutex_lock(&lb_mu);
+        lb_build(arr, n, gen, joff);
+        free(arr);
+    }
+    char path[300];
+    for(int k=0;k<journal_shards;k++){
+        journal_path(path, sizeof path, k);
+        struct stat st;
+        if(lb.busy[k] || stat(path, &st) != 0) continue;
+        if(st.st_size < lb.joff[k]) lb.joff[k] = 0;    /* a stale shard was started over */
+        if(st.st_size <= lb.joff[k]) continue;
+        FILE *f = fopen(path, "r");
+        if(!f) continue;
+        char line[512];
+        fseek(f, lb.joff[k], SEEK_SET);
+        long pos = lb.joff[k];
+        int skip = 0;
+        while(fgets(line, sizeof line, f)){
+            if(!strchr(line, '\n')) break;         /* another process is mid-commit */
+            pos = ftell(f);
+            long jgen;
+            if(line[0] == '#'){ skip = sscanf(line, "#gen %ld", &jgen)!=1 || jgen != lb.gen; continue; }
+            char user[MAX_USER]; int dgp, dgw, dq;
+            if(!skip && sscanf(line, "%63s %d %d %d", user, &dgp, &dgw, &dq)==4) lb_apply(user, dgp, dgw, dq);
+        }
+        lb.joff[k] = pos;
+        fclose(f);
+    }
+}
+
+/* Journal hooks, called by the committer of a shard around its write. */
+void lb_journal_begin(int shard){
+    pthread_mutex_lock(&lb_mu);
+    if(lb.loaded) lb_sync_locked();
+    lb.busy[shard] = 1;
+    pthread_mutex_unlock(&lb_mu);
+}
+
+void lb_journal_appended(const char *name, int dgp, int dgw, int dq, int settling){
+    pthread_mutex_lock(&lb_mu);
+    LbPending *p = settling ? lb_pending_find(name) : NULL;
+    if(p){
+        p->dgp -= dgp; p->dgw -= dgw; p->dq -= dq;
+        if(!p->dgp && !p->dgw && !p->dq) *p = lb.pend[--lb.npend];
+    } else lb_apply(name, dgp, dgw, dq);
+    pthread_mutex_unlock(&lb_mu);
+}
+
+/* end_off < 0: the write failed; whatever reached the file is tailed later. */
+void lb_journal_end(int shard, long end_off){
+    pthread_mutex_lock(&lb_mu);
+    if(lb.loaded && end_off >= 0) lb.joff[shard] = end_off;
+    lb.busy[shard] = 0;
+    pthread_mutex_unlock(&lb_mu);
+}
+
+void lb_db_saved(const User *arr, int n, long gen){
+    pthread_mutex_lock(&lb_mu);
+    if(lb.loaded) lb_build(arr, n, gen, NULL);
+    pthread_mutex_unlock(&lb_mu);
+}
+
+/* Top k entries from position `from`, with competition ranks (ties share a
+   rank). Returns the number of rows filled. */
+int lb_top(int metric, int from, int k, LbRow *rows, int *total){
+    db_lock();
+    pthread_mutex_lock(&lb_mu);
+    lb_sync_locked();
+    SkipList *sl = &lb.list[metric];
+    int n = 0;
+    *total = lb.loaded ? sl->len : 0;
+    LbNode *x = lb.loaded ? sl_at(sl, from) : NULL;
+    int64_t prev = -2; int rank = 0;
+    for(int pos=from; x && n<k; pos++, x = x->lv[0].next){
+        if(x->score != prev){
+            rank = pos == from ? sl_rank(sl, x->score, "") + 1 : pos + 1;
+            prev = x->score;
+        }
+        LbUser *u = &lb.users[x->user];
+        strcpy(rows[n].name, u->name);
+        rows[n].rank = rank; rows[n].gp = u->gp; rows[n].gw = u->gw; rows[n].q = u->q; rows[n].score = x->score;
+        n++;
+    }
+    pthread_mutex_unlock(&lb_mu);
+    db_unlock();
+    return n;
+}
+
+/* Competition rank of name (1 = best), 0 if unranked. */
+int lb_rank(int metric, const char *name, LbRow *row, int *total){
+    db_lock();
+    pthread_mutex_lock(&lb_mu);
+    lb_sync_locked();
+    int i = lb.loaded ? lb_find(name) : -1, rank = 0;
+    *total = lb.loaded ? lb.list[metric].len : 0;
+    if(i >= 0){
+        LbUser *u = &lb.users[i];
+        strcpy(row->name, u->name);
+        row->gp = u->gp; row->gw = u->gw; row->q = u->q; row->score = lb_score(u, metric);
+        if(u->node[metric]) rank = sl_rank(&lb.list[metric], u->node[metric]->score, "") + 1;
+        row->rank = rank;
+    }
+    pthread_mutex_unlock(&lb_mu);
+    db_unlock();
+    return rank;
+}
+
+void lb_print_row(const LbRow *r){
+    char rate[16];
+    if(r->gp) snprintf(rate, sizeof rate, "%.1f%%", 100.0 * r->gw / r->gp); else strcpy(rate, "-");
+    uprintf("%5d  %-20s %6d %6d %7s %7d\n", r->rank, r->name, r->gw, r->gp, rate, r->q);
+}
+
+void show_leaderboard(const char *username){
+    char buf[32];
+    uprintf("\n--- Leaderboard ---\n1) Most games won\n2) Best win rate (min %d games)\n3) Most quizzes\nChoose: ", LB_MIN_GAMES);
+    if(!read_line("", buf, sizeof buf)) return;
+    int metric = atoi(buf) - 1;
+    if(metric < 0 || metric >= LB_METRICS){ uprintf("Invalid.\n"); return; }
+    if(!read_line("How many [10]: ", buf, sizeof buf)) return;
+    int k = atoi(buf);
+    if(k <= 0) k = 10;
+    if(k > 1000) k = 1000;
+    LbRow *rows = malloc(k * sizeof *rows), me = {0};
+    if(!rows){ uprintf("Out of memory.\n"); return; }
+    int total;
+    int n = lb_top(metric, 0, k, rows, &total);
+    uprintf("\nTop %d by %s (%d ranked)\n%5s  %-20s %6s %6s %7s %7s\n", n, lb_metric_names[metric], total, "rank", "user", "won", "played", "rate", "quizzes");
+    for(int i=0;i<n;i++) lb_print_row(&rows[i]);
+    if(lb_rank(metric, username, &me, &total)) uprintf("You are #%d of %d.\n", me.rank, total);
+    else if(metric == LB_RATE) uprintf("Play %d game(s) to be ranked by win rate.\n", LB_MIN_GAMES - me.gp);
+    else uprintf("You are not ranked yet.\n");
+    free(rows);
+}
+
+/* ---------- User listing ----------
+   A streaming iterator over users.db for the admin view. Text databases are
+   read through a fixed 64 KB line buffer and binary ones straight from the
+   mapping, so memory stays constant at any size. A cursor is a generation
+   plus a position: a byte offset (text) or a record index (binary). Only
+   one page is touched per request, so the first page costs the same on any
+   database. With a prefix filter the binary format binary-searches to the
+   first match (its records are sorted); text is scanned from the cursor.
+   Journal deltas are applied page by page. */
+#define LIST_PAGE 50
+#define LIST_READ_BUF (64*1024)
+
+typedef struct { long gen; long long pos; } UserCursor;
+
+typedef struct {
+    FILE *f;
+    LineReader rd;              /* text */
+    const BinHeader *h;         /* binary */
+    long long pos;
+    char prefix[MAX_USER];
+    size_t plen;
+} UserIter;
+
+int user_iter_open(UserIter *it, const char *prefix, const UserCursor *cur){
+    memset(it, 0, sizeof *it);
+    strncpy(it->prefix, prefix ? prefix : "", sizeof it->prefix - 1);
+    it->plen = strlen(it->prefix);
+    it->pos = cur->pos;
+    if(db_is_binary()){
+        if(!(it->h = bin_open())) return 0;
+        if(it->pos == 0 && it->plen){
+            const BinUser *r = bin_records(it->h);
+            size_t lo = 0, hi = it->h->count;
+            while(lo < hi){
+                size_t mid = lo + (hi-lo)/2;
+                if(strncmp(r[mid].username, it->prefix, it->plen) < 0) lo = mid+1; else hi = mid;
+            }
+            it->pos = (long long)lo;
+        }
+        return 1;
+    }
+    if(!(it->f = fopen(users_db_path, "rb"))) return 0;
+    if(fseek(it->f, (long)it->pos, SEEK_SET) != 0 || !line_reader_init(&it->rd, it->f, LIST_READ_BUF, it->pos)){
+        fclose(it->f); it->f = NULL; return 0;
+    }
+    return 1;
+}
+
+/* Next user matching the prefix; it->pos then points just past it. */
+int user_iter_next(UserIter *it, User *u){
+    if(it->h){
+        const BinUser *r = bin_records(it->h);
+        if(it->pos >= (long long)it->h->count || strncmp(r[it->pos].username, it->prefix, it->plen) != 0) return 0;
+        bin_to_user(&r[it->pos++], u);
+        return 1;
+    }
+    if(!it->f) return 0;
+    char *line;
+    while((line = line_next(&it->rd))){
+        it->pos = line_offset(&it->rd);
+        while(*line == ' ' || *line == '\t') line++;
+        if(it->plen && strncmp(line, it->prefix, it->plen) != 0) continue;
+        if(parse_user_range(line, line + strlen(line), u)) return 1;
+    }
+    it->pos = line_offset(&it->rd);
+    return 0;
+}
+
+void user_iter_close(UserIter *it){
+    if(it->f){ line_reader_free(&it->rd); fclose(it->f); }
+    it->f = NULL; it->h = NULL;
+}
+
+/* Fills up to max users after *cur (journal applied) and advances it.
+   Returns the count, or -1 if the cursor's generation is gone (users.db was
+   rewritten since) so the caller can restart from the top. */
+int users_page(const char *prefix, UserCursor *cur, User *out, int max){
+    db_lock();
+    long gen = read_db_gen();
+    if(cur->pos && cur->gen != gen){ db_unlock(); return -1; }
+    UserIter it;
+    int n = 0;
+    if(user_iter_open(&it, prefix, cur)){
+        while(n < max && user_iter_next(&it, &out[n])) n++;
+        cur->pos = it.pos;
+        user_iter_close(&it);
+    }
+    cur->gen = gen;
+    journal_replay(out, n, gen, NULL);
+    db_unlock();
+    return n;
+}
+
+void list_format_user(OutBuf *o, const User *u){
+    outbuf_puts(o, u->username);
+    outbuf_puts(o, " | hash=");
+    outbuf_puts(o, u->hash);
+    outbuf_puts(o, " | games=");
+    outbuf_int(o, u->games_played);
+    outbuf_puts(o, " won=");
+    outbuf_int(o, u->games_won);
+    outbuf_puts(o, " quizzes=");
+    outbuf_int(o, u->quizzes);
+    outbuf_puts(o, " last=");
+    outbuf_puts(o, u->last_login[0] ? u->last_login : "-");
+    outbuf_put(o, "\n", 1);
+}
+
+/* Streams every user matching prefix to out through one bulk buffer,
+   LIST_BATCH users (and one journal pass) at a time. Returns the count. */
+#define LIST_BATCH 4096
+long long list_users_stream(FILE *out, const char *prefix){
+    User *batch = malloc(LIST_BATCH * sizeof(User));
+    OutBuf ob;
+    if(!batch || !outbuf_init(&ob, out, 1 << 20)){ free(batch); return 0; }
+    UserCursor cur = {0, 0};
+    long long total = 0;
+    int n;
+    while((n = users_page(prefix, &cur, batch, LIST_BATCH)) > 0){
+        for(int i=0;i<n;i++) list_format_user(&ob, &batch[i]);
+        total += n;
+        if(n < LIST_BATCH) break;
+    }
+    outbuf_close(&ob);
+    free(batch);
+    return total;
+}
+
+void show_all_users(){
+    session_flush();
+    char prefix[MAX_USER] = "", buf[MAX_USER + 8];
+    int size = LIST_PAGE, page = 0, depth = 0, cap = 16;
+    UserCursor cur = {0, 0}, *back = malloc(cap * sizeof *back);   /* start of each page shown */
+    User *rows = malloc(1001 * sizeof(User));
+    if(!back || !rows){ free(back); free(rows); uprintf("Memory error.\n"); return; }
+    while(1){
+        UserCursor start = cur;
+        int n = users_page(prefix, &cur, rows, size);
+        if(n < 0){ uprintf("Users changed; back to the first page.\n"); cur.pos = 0; depth = page = 0; continue; }
+        if(n == 0 && page == 0){ uprintf(prefix[0] ? "No users match '%s'.\n" : "No users registered.\n", prefix); }
+        else {
+            OutBuf ob;
+            if(outbuf_init(&ob, out_stream(), 256*1024)){
+                char hdr[128];
+                snprintf(hdr, sizeof hdr, "\n--- Registered Users (page %d%s%s%s) ---\n", page + 1,
+                         prefix[0] ? ", prefix '" : "", prefix, prefix[0] ? "'" : "");
+                outbuf_puts(&ob, hdr);
+                for(int i=0;i<n;i++) list_format_user(&ob, &rows[i]);
+                outbuf_close(&ob);
+            }
+        }
+        if(depth == cap){ cap *= 2; back = realloc(back, cap * sizeof *back); }
+        back[depth++] = start;
+        UserCursor peek = cur;
+        int more = n == size && users_page(prefix, &peek, &rows[n], 1) > 0;
+        if(!read_line(more ? "[n]ext, [p]revious, [f]ilter, [s]ize, [a]ll, [q]uit: " : "[p]revious, [f]ilter, [s]ize, [a]ll, [q]uit: ", buf, sizeof buf)) break;
+        if(buf[0] == 'n' && more){ page++; continue; }
+        if(buf[0] == 'p' && depth >= 2){ depth -= 2; cur = back[depth]; page--; continue; }
+        if(buf[0] == 'f'){ if(!read_line("Username prefix (blank = all): ", prefix, sizeof prefix)) break; }
+        else if(buf[0] == 's'){
+            if(!read_line("Users per page (1..1000): ", buf, sizeof buf)) break;
+            int s = atoi(buf);
+            if(s >= 1 && s <= 1000) size = s;
+        }
+        else if(buf[0] == 'a'){
+            double t0 = now_sec();
+            long long total = list_users_stream(out_stream(), prefix);
+            uprintf("%lld users listed in %.3f s.\n", total, now_sec() - t0);
+            break;
+        }
+        else if(buf[0] == 'q' || buf[0] == 0) break;
+        else { cur = start; depth--; continue; }      /* redisplay */
+        cur.pos = 0; depth = page = 0;
+    }
+    free(back); free(rows);
+}
+
+/* ---------- Auth flows ---------- */
+
+int signup_flow(){
+    char username[64], password[128], hash[HASH_FIELD];
+    if(!read_line("Choose a username: ", username, sizeof username)) return 0;
+    if(strlen(username)==0){ uprintf("Username cannot be empty.\n"); return 0; }
+    if(!username_valid(username, strlen(username))){ uprintf("Username cannot contain spaces or commas or start with '#'.\n"); return 0; }
+    if(!read_password("Choose a password: ", password, sizeof password)) return 0;
+    if(strlen(password)==0){ uprintf("Password cannot be empty.\n"); return 0; }
+    password_hash(password, (uint32_t)kdf_iterations, hash);
+    db_lock();
+    User *arr; int n = load_users(&arr);
+    int idx = find_user_index(arr, n, username);
+    if(idx!=-1){ db_unlock(); uprintf("User already exists.\n"); if(arr) free(arr); return 0; }
+    User u; memset(&u,0,sizeof u);
+    strncpy(u.username, username, sizeof u.username-1);
+    strncpy(u.hash, hash, sizeof u.hash-1);
+    u.games_played = 0; u.games_won = 0; u.quizzes = 0; u.last_login[0]='-';
+    User *newarr = realloc(arr, (n+1)*sizeof(User));
+    if(!newarr){ db_unlock(); uprintf("Memory error.\n"); if(arr) free(arr); return 0; }
+    newarr[n] = u; n++;
+    int saved = save_users(newarr, n);
+    db_unlock();
+    free(newarr);
+    if(!saved){ uprintf("Error saving user.\n"); return 0; }
+    uprintf("Signup successful! You can now log in.\n");
+    return 1;
+}
+
+int login_flow(char *out_username){
+    char username[64], password[128];
+    if(!read_line("Enter username: ", username, sizeof username) || !read_password("Enter password: ", password, sizeof password)) return 0;
+    User u;
+    if(!db_find_user(username, &u)){ uprintf("User not found.\n"); return 0; }
+    if(!password_verify(password, u.hash)){ uprintf("Authentication failed.\n"); return 0; }
+    if(password_needs_rehash(u.hash)){
+        char hash[HASH_FIELD];
+        password_hash(password, (uint32_t)kdf_iterations, hash);
+        if(journal_append(username, 0, 0, 0, NULL, hash)) strcpy(u.hash, hash);
+    }
+    session_begin(&u);
+    now_iso(session.last_login, sizeof session.last_login);
+    strcpy(session.user.last_login, session.last_login);
+    session_touch();
+    if(out_username) strncpy(out_username, username, MAX_USER-1);
+    uprintf("Login successful. Welcome, %s!\n", username);
+    return 1;
+}
+
+/* ---------- Profile & Stats ---------- */
+void show_profile(const char *username){
+    User u, *cached = session_user(username);
+    if(cached) u = *cached;
+    else if(!db_find_user(username, &u)){ uprintf("Profile not found.\n"); return; }
+    uprintf("\n--- Profile: %s ---\n", username);
+    uprintf("Games played: %d\nGames won: %d\nQuizzes completed: %d\nLast login: %s\n",
+           u.games_played, u.games_won, u.quizzes, u.last_login[0]?u.last_login:"-");
+}
+
+void increment_games_played(const char *username, int won){
+    User *u = session_user(username);
+    if(!u){ journal_append(username, 1, won?1:0, 0, NULL, NULL); return; }
+    u->games_played++; session.dgp++;
+    if(won){ u->games_won++; session.dgw++; }
+    lb_pending_add(username, 1, won?1:0, 0);
+    session_touch();
+}
+void increment_quiz(const char *username){
+    User *u = session_user(username);
+    if(!u){ journal_append(username, 0, 0, 1, NULL, NULL); return; }
+    u->quizzes++; session.dq++;
+    lb_pending_add(username, 0, 0, 1);
+    session_touch();
+}
+
+/* ---------- Games ---------- */
+void game_number_guess(const char *username){
+    int target = (int)rng_below(rng_thread(), 100) + 1;
+    uprintf("\n-- Number Guess (1..100) --\n");
+    int tries=0, guess;
+    char buf[64];
+    while(1){
+        if(!read_line("Your guess (or 'q' to quit): ", buf, sizeof buf)) return;
+        if(buf[0]=='q'){ uprintf("Quit. The number was %d.\n", target); break; }
+        if(sscanf(buf, "%d", &guess)!=1){ uprintf("Invalid.\n"); continue; }
+        tries++;
+        if(guess<target) uprintf("Higher.\n");
+        else if(guess>target) uprintf("Lower.\n");
+        else { uprintf("Correct in %d tries!\n", tries); increment_games_played(username, 1); break; }
+    }
+}
+
+/* Number-guess simulation: millions of games on all cores. The guesser is
+   one of guess_strategies[]. The host is either fair (uniform target) or
+   adversarial: it never commits to a target and always answers so that the
+   larger side of the range stays possible. Each chunk of games has its own
+   Rng seeded from (seed, chunk), so results do not depend on the thread
+   count. */
+#define GUESS_HIST 64           /* tries 1..63; the last bucket collects 63+ */
+#define GUESS_CHUNK 65536
+
+typedef int64_t (*GuessFn)(int64_t lo, int64_t hi, Rng *r);
+int64_t guess_binary(int64_t lo, int64_t hi, Rng *r){ (void)r; return lo + (hi - lo) / 2; }
+int64_t guess_random(int64_t lo, int64_t hi, Rng *r){ return lo + (int64_t)rng_below(r, (uint64_t)(hi - lo) + 1); }
+int64_t guess_skewed(int64_t lo, int64_t hi, Rng *r){ (void)r; return lo + (hi - lo) / 4; }
+
+typedef struct { const char *name; GuessFn fn; } GuessStrategy;
+const GuessStrategy guess_strategies[] = {
+    {"binary", guess_binary}, {"random", guess_random}, {"skewed", guess_skewed},
+};
+#define GUESS_STRATEGIES (int)(sizeof guess_strategies / sizeof guess_strategies[0])
+
+typedef struct {
+    int64_t lo, hi;
+    int strategy, adversarial;
+    uint64_t seed;
+    long long games;
+    uint64_t hist[GUESS_HIST];
+    long long total_tries;
+    int max_tries;
+} GuessSim;
+
+int guess_play(const GuessSim *s, Rng *r){
+    GuessFn fn = guess_strategies[s->strategy].fn;
+    int64_t lo = s->lo, hi = s->hi;
+    int64_t target = s->adversarial ? 0 : lo + (int64_t)rng_below(r, (uint64_t)(hi - lo) + 1);
+    for(int tries=1;;tries++){
+        int64_t g = fn(lo, hi, r);
+        if(s->adversarial){
+            if(lo == hi) return tries;
+            if(g - lo >= hi - g) hi = g - 1; else lo = g + 1;
+        } else {
+            if(g == target) return tries;
+            if(g < target) lo = g + 1; else hi = g - 1;
+        }
+    }
+}
+
+typedef struct { GuessSim *sim; uint64_t (*hist)[GUESS_HIST]; long long *tries; int *max; } GuessJob;
+
+void guess_chunk(void *arg, int c){
+    GuessJob *j = arg;
+    const GuessSim *s = j->sim;
+    Rng r;
+    rng_seed(&r, s->seed ^ ((uint64_t)c * 0xD1B54A32D192ED03ull));
+    long long lo = (long long)c * GUESS_CHUNK, hi = lo + GUESS_CHUNK < s->games ? lo + GUESS_CHUNK : s->games;
+    uint64_t *h = j->hist[c];
+    long long sum = 0;
+    int mx = 0;
+    for(long long g=lo; g<hi; g++){
+        int t = guess_play(s, &r);
+        sum += t;
+        if(t > mx) mx = t;
+        h[t < GUESS_HIST ? t : GUESS_HIST-1]++;
+    }
+    j->tries[c] = sum;
+    j->max[c] = mx;
+}
+
+/* Plays s->games games on `threads` threads and fills the histogram and
+   totals. Returns the wall time in seconds, or -1 if out of memory. */
+double guess_simulate(GuessSim *s, int threads){
+    int chunks = (int)((s->games + GUESS_CHUNK - 1) / GUESS_CHUNK);
+    int nc = chunks > 0 ? chunks : 1;
+    GuessJob j = { s, calloc(nc, sizeof *j.hist), calloc(nc, sizeof(long long)), calloc(nc, sizeof(int)) };
+    if(!j.hist || !j.tries || !j.max){ free(j.hist); free(j.tries); free(j.max); return -1; }
+    double t0 = now_sec();
+    parallel_for(chunks, threads, guess_chunk, &j);
+    double t = now_sec() - t0;
+    memset(s->hist, 0, sizeof s->hist);
+    s->total_tries = 0; s->max_tries = 0;
+    for(int c=0;c<chunks;c++){
+        for(int i=0;i<GUESS_HIST;i++) s->hist[i] += j.hist[c][i];
+        s->total_tries += j.tries[c];
+        if(j.max[c] > s->max_tries) s->max_tries = j.max[c];
+    }
+    free(j.hist); free(j.tries); free(j.max);
+    return t;
+}
+
+/* Sum of tries of the binary guesser over every target in a range of n
+   (the node depths of the implied search tree): S(n) = n + S((n-1)/2) +
+   S(n/2). Each level has at most two distinct sizes, so a small memo keeps
+   it O(log n). */
+double guess_binary_tries(int64_t n, int64_t *keys, double *vals, int *cnt){
+    if(n <= 0) return 0;
+    for(int i=0;i<*cnt;i++) if(keys[i] == n) return vals[i];
+    double v = (double)n + guess_binary_tries((n-1)/2, keys, vals, cnt) + guess_binary_tries(n/2, keys, vals, cnt);
+    if(*cnt < 256){ keys[*cnt] = n; vals[(*cnt)++] = v; }
+    return v;
+}
+
+double guess_binary_expected(int64_t n){
+    int64_t keys[256]; double vals[256]; int cnt = 0;
+    return guess_binary_tries(n, keys, vals, &cnt) / (double)n;
+}
+
+void guess_print(const GuessSim *s, int threads, double t){
+    double n = (double)(s->hi - s->lo) + 1;
+    uprintf("%s guesser vs. %s host, %lld..%lld: %lld games on %d thread(s) in %.3f s (%.2f M games/s)\n",
+            guess_strategies[s->strategy].name, s->adversarial ? "adversarial" : "fair", (long long)s->lo, (long long)s->hi,
+            s->games, threads, t, s->games / (t > 0 ? t : 1e-9) / 1e6);
+    uprintf("tries: mean %.4f, max %d (binary search needs at most %d)\n",
+            (double)s->total_tries / (s->games ? s->games : 1), s->max_tries, (int)ceil(log2(n + 1)));
+    uint64_t peak = 0;
+    int first = GUESS_HIST, last = 0;
+    for(int i=1;i<GUESS_HIST;i++) if(s->hist[i]){ if(s->hist[i] > peak) peak = s->hist[i]; if(i < first) first = i; last = i; }
+    for(int i=first;i<=last;i++){
+        int bar = (int)(50.0 * s->hist[i] / (peak ? peak : 1) + 0.5);
+        uprintf("%3d%s %10llu %6.2f%% ", i, i == GUESS_HIST-1 ? "+" : " ", (unsigned long long)s->hist[i], 100.0 * s->hist[i] / (s->games ? s->games : 1));
+        for(int k=0;k<bar;k++) uprintf("#");
+        uprintf("\n");
+    }
+}
+
+void guess_simulator(void){
+    char buf[64];
+    GuessSim s;
+    memset(&s, 0, sizeof s);
+    long long lo = 1, hi = 100;
+    uprintf("\n-- Number Guess Simulator --\n");
+    if(!read_line("Range lo hi [1 100]: ", buf, sizeof buf)) return;
+    if(buf[0] && (sscanf(buf, "%lld %lld", &lo, &hi) != 2 || hi < lo || (unsigned long long)(hi - lo) >= (1ull << 62))){
+        uprintf("Invalid range.\n"); return;
+    }
+    if(!read_line("Games [1000000]: ", buf, sizeof buf)) return;
+    s.games = buf[0] ? atoll(buf) : 1000000;
+    if(s.games <= 0 || s.games > (long long)GUESS_CHUNK * 0x7fffffff){ uprintf("Invalid count.\n"); return; }
+    uprintf("Guesser (");
+    for(int i=0;i<GUESS_STRATEGIES;i++) uprintf("%s%s", i ? "/" : "", guess_strategies[i].name);
+    if(!read_line(") [binary]: ", buf, sizeof buf)) return;
+    s.strategy = -1;
+    for(int i=0;i<GUESS_STRATEGIES;i++) if(!buf[0] ? i == 0 : strcmp(buf, guess_strategies[i].name) == 0) s.strategy = i;
+    if(s.strategy < 0){ uprintf("Unknown guesser.\n"); return; }
+    if(!read_line("Host (fair/adversarial) [fair]: ", buf, sizeof buf)) return;
+    if(buf[0] && strcmp(buf, "fair") != 0 && strcmp(buf, "adversarial") != 0){ uprintf("Unknown host.\n"); return; }
+    s.adversarial = strcmp(buf, "adversarial") == 0;
+    s.lo = lo; s.hi = hi;
+    s.seed = rng_next(rng_thread());
+    int threads = cpu_count();
+    double t = guess_simulate(&s, threads);
+    if(t < 0){ uprintf("Memory error.\n"); return; }
+    guess_print(&s, threads, t);
+}
+
+/* Tic-tac-toe on bitboards: bit i of x/o is cell i (row-major). The AI plays
+   from a perfect-play table over every reachable position, keyed by the
+   base-3 position index (cell i adds 3^i for X, 2*3^i for O) and solved once
+   on first use, so a move is one lookup. */
+typedef struct { uint16_t x, o; } TttBoard;
+#define TTT_FULL 0x1FF
+#define TTT_POSITIONS 19683     /* 3^9 */
+
+const uint16_t ttt_lines[8] = {0x007,0x038,0x1C0,0x049,0x092,0x124,0x111,0x054};
+uint8_t ttt_is_win[512];        /* mask contains a full line */
+uint8_t ttt_popcount[512];
+uint16_t ttt_tern[512];         /* sum of 3^i over the set bits */
+int8_t ttt_best[TTT_POSITIONS]; /* best move for the side to move; -1 game over, -2 unreachable */
+int8_t ttt_score[TTT_POSITIONS];/* value for the side to move: 10-plies for a win, 0 draw */
+pthread_once_t ttt_once = PTHREAD_ONCE_INIT;
+_Thread_local TttBoard ttt_board;
+
+int ttt_index(TttBoard b){ return ttt_tern[b.x] + 2*ttt_tern[b.o]; }
+
+int ttt_solve(TttBoard b){
+    int idx = ttt_index(b);
+    if(ttt_best[idx] != -2) return ttt_score[idx];
+    int plies = ttt_popcount[b.x | b.o], best = -100, mv = -1;
+    if(ttt_is_win[b.x] || ttt_is_win[b.o]) best = -(10 - plies);   /* previous mover won */
+    else if((b.x | b.o) == TTT_FULL) best = 0;
+    else {
+        int x_to_move = ttt_popcount[b.x] == ttt_popcount[b.o];
+        for(int m=0;m<9;m++){
+            if((b.x | b.o) >> m & 1) continue;
+            TttBoard c = b;
+            if(x_to_move) c.x |= 1 << m; else c.o |= 1 << m;
+            int s = -ttt_solve(c);
+            if(s > best){ best = s; mv = m; }   /* ties keep the lowest cell */
+        }
+    }
+    ttt_best[idx] = (int8_t)mv;
+    ttt_score[idx] = (int8_t)best;
+    return best;
+}
+
+void ttt_init(void){
+    for(int m=0;m<512;m++){
+        int t = 0, p = 1, c = 0;
+        for(int i=0;i<9;i++, p*=3) if(m >> i & 1){ t += p; c++; }
+        ttt_tern[m] = (uint16_t)t;
+        ttt_popcount[m] = (uint8_t)c;
+        ttt_is_win[m] = 0;
+        for(int k=0;k<8;k++) if((m & ttt_lines[k]) == ttt_lines[k]) ttt_is_win[m] = 1;
+    }
+    memset(ttt_best, -2, sizeof ttt_best);
+    TttBoard empty = {0, 0};
+    ttt_solve(empty);
+}
+
+void ttt_draw(void){
+    uprintf("\n");
+    for(int r=0;r<3;r++){
+        for(int c=0;c<3;c++){
+            int i=3*r+c; char ch = ttt_board.x>>i & 1 ? 'X' : ttt_board.o>>i & 1 ? 'O' : '0'+i;
+            uprintf(" %c ", ch);
+            if(c<2) uprintf("|");
+        }
+        uprintf("\n");
+        if(r<2) uprintf("---+---+---\n");
+    }
+}
+int ttt_winner(void){
+    pthread_once(&ttt_once, ttt_init);
+    if(ttt_is_win[ttt_board.x]) return -1;
+    if(ttt_is_win[ttt_board.o]) return 1;
+    return (ttt_board.x | ttt_board.o) == TTT_FULL ? 0 : 2;
+}
+int ttt_ai_move(void){
+    pthread_once(&ttt_once, ttt_init);
+    return ttt_best[ttt_index(ttt_board)];
+}
+void game_tictactoe(const char *username){
+    memset(&ttt_board,0,sizeof ttt_board);
+    uprintf("\n-- Tic-Tac-Toe: You = X, AI = O --\n");
+    int turn = -1;
+    char buf[32];
+    while(1){
+        ttt_draw();
+        int w = ttt_winner();
+        if(w!=2){
+            if(w==1){ uprintf("AI wins.\n"); increment_games_played(username, 0); return; }
+            else if(w==-1){ uprintf("You win!\n"); increment_games_played(username, 1); return; }
+            else { uprintf("Draw.\n"); increment_games_played(username, 0); return; }
+        }
+        if(turn==-1){
+            if(!read_line("Your move (0-8): ", buf, sizeof buf)) return;
+            int m; if(sscanf(buf, "%d", &m)!=1 || m<0 || m>8 || ((ttt_board.x|ttt_board.o)>>m & 1)){ uprintf("Invalid move.\n"); continue; }
+            ttt_board.x |= 1 << m; turn=1;
+        } else {
+            int m = ttt_ai_move();
+            if(m>=0) ttt_board.o |= 1 << m;
+            turn=-1;
+        }
+    }
+}
+
+/* N x N, k-in-a-row (3x3 up to 15x15 gomoku). Every line of k cells is a
+   "window"; per-window stone counts are kept incrementally, which gives
+   win detection and the evaluation (sum of window weights) in O(k) per move.
+   The AI is a negamax alpha-beta search with iterative deepening, a shared
+   Zobrist-keyed transposition table and root splitting across threads. */
+#define GK_MAX_N 15
+#define GK_MAX_CELLS (GK_MAX_N*GK_MAX_N)
+#define GK_MAX_WINDOWS (4*GK_MAX_CELLS)
+#define GK_MAX_CELL_WINDOWS (4*GK_MAX_N)
+#define GK_WIN 1000000000
+#define GK_INF (GK_WIN + 1000)
+#define GK_TT_BITS 20
+
+typedef struct {
+    int n, k, cells, nwin;
+    int ncw[GK_MAX_CELLS];                          /* windows through each cell */
+    uint16_t cw[GK_MAX_CELLS][GK_MAX_CELL_WINDOWS];
+    int weight[GK_MAX_N + 2];                       /* value of a window holding c stones of one side */
+    uint64_t zob[2][GK_MAX_CELLS], zob_side;
+} GkGeom;
+
+typedef struct {
+    const GkGeom *g;
+    int8_t cell[GK_MAX_CELLS];      /* 0 empty, 1 X, 2 O */
+    uint8_t near[GK_MAX_CELLS];     /* stones within distance 2 */
+    uint8_t cnt[GK_MAX_WINDOWS][2];
+    int eval;                       /* from X's point of view */
+    int side, winner, nmoves;
+    uint64_t key;
+    int16_t moves[GK_MAX_CELLS];
+} GkBoard;
+
+/* Transposition table entry; key is stored xor'd with data so a torn
+   concurrent write reads back as a miss. Both words are relaxed atomics:
+   no ordering is needed, only race-free word-sized accesses. */
+typedef struct { _Atomic uint64_t key, data; } GkTTEntry;
+enum { GK_EXACT, GK_LOWER, GK_UPPER };
+GkTTEntry *gk_tt, gk_tt_one[1];    /* gk_tt_one stands in if the table cannot be allocated */
+uint64_t gk_tt_mask;
+pthread_once_t gk_tt_once = PTHREAD_ONCE_INIT;
+
+void gk_tt_alloc(void){
+    gk_tt = calloc((size_t)1 << GK_TT_BITS, sizeof(GkTTEntry));
+    gk_tt_mask = ((uint64_t)1 << GK_TT_BITS) - 1;
+    if(!gk_tt){ gk_tt = gk_tt_one; gk_tt_mask = 0; }
+}
+
+void gk_geom_init(GkGeom *g, int n, int k){
+    static const int dr[4] = {0,1,1,1}, dc[4] = {1,0,1,-1};
+    memset(g, 0, sizeof *g);
+    g->n = n; g->k = k; g->cells = n*n;
+    for(int r=0;r<n;r++) for(int c=0;c<n;c++) for(int d=0;d<4;d++){
+        int er = r + dr[d]*(k-1), ec = c + dc[d]*(k-1);
+        if(er<0 || er>=n || ec<0 || ec>=n) continue;
+        for(int i=0;i<k;i++){
+            int cell = (r+dr[d]*i)*n + c+dc[d]*i;
+            g->cw[cell][g->ncw[cell]++] = (uint16_t)g->nwin;
+        }
+        g->nwin++;
+    }
+    g->weight[0] = 0;
+    for(int c=1;c<=k+1;c++){ int e = 3*(c-1); g->weight[c] = 1 << (e < 20 ? e : 20); }
+    uint64_t seed = 0xC0FFEEull * (uint64_t)(n*64 + k);
+    for(int s=0;s<2;s++) for(int i=0;i<g->cells;i++) g->zob[s][i] = splitmix64(&seed);
+    g->zob_side = splitmix64(&seed);
+}
+
+void gk_board_init(GkBoard *b, const GkGeom *g){
+    memset(b, 0, sizeof *b);
+    b->g = g; b->side = 1;
+    b->key = g->zob_side * (uint64_t)(g->n*64 + g->k);
+}
+
+/* Contribution of window w to the X-relative evaluation. */
+static inline int gk_window_value(const GkBoard *b, int w){
+    int x = b->cnt[w][0], o = b->cnt[w][1];
+    if(x && o) return 0;
+    return x ? b->g->weight[x] : -b->g->weight[o];
+}
+
+void gk_near_add(GkBoard *b, int cell, int delta){
+    int n = b->g->n, r = cell / n, c = cell % n;
+    for(int rr = r-2; rr <= r+2; rr++){
+        if(rr < 0 || rr >= n) continue;
+        for(int cc = c-2; cc <= c+2; cc++)
+            if(cc >= 0 && cc < n) b->near[rr*n + cc] += delta;
+    }
+}
+
+void gk_play(GkBoard *b, int cell){
+    const GkGeom *g = b->g;
+    int me = b->side - 1;
+    for(int i=0;i<g->ncw[cell];i++){
+        int w = g->cw[cell][i];
+        b->eval -= gk_window_value(b, w);
+        if(++b->cnt[w][me] == g->k) b->winner = b->side;
+        b->eval += gk_window_value(b, w);
+    }
+    gk_near_add(b, cell, 1);
+    b->cell[cell] = (int8_t)b->side;
+    b->key ^= g->zob[me][cell] ^ g->zob_side;
+    b->moves[b->nmoves++] = (int16_t)cell;
+    b->side = 3 - b->side;
+}
+
+void gk_undo(GkBoard *b){
+    const GkGeom *g = b->g;
+    int cell = b->moves[--b->nmoves];
+    b->side = 3 - b->side;
+    int me = b->side - 1;
+    for(int i=0;i<g->ncw[cell];i++){
+        int w = g->cw[cell][i];
+        b->eval -= gk_window_value(b, w);
+        b->cnt[w][me]--;
+        b->eval += gk_window_value(b, w);
+    }
+    gk_near_add(b, cell, -1);
+    b->cell[cell] = 0;
+    b->key ^= g->zob[me][cell] ^ g->zob_side;
+    b->winner = 0;
+}
+
+/* Static ordering value of playing cell: windows it extends for the side to
+   move plus windows of the opponent it blocks. */
+int gk_move_value(const GkBoard *b, int cell){
+    const GkGeom *g = b->g;
+    int me = b->side - 1, v = 0;
+    for(int i=0;i<g->ncw[cell];i++){
+        int w = g->cw[cell][i], m = b->cnt[w][me], o = b->cnt[w][1-me];
+        if(!o) v += g->weight[m+1];
+        if(!m) v += g->weight[o+1];
+    }
+    return v;
+}
+
+/* Candidate moves (empty cells near a stone, or the centre on an empty
+   board), best first: tt_move, then static value plus history. */
+int gk_gen_moves(const GkBoard *b, int tt_move, const int *history, int16_t *out){
+    const GkGeom *g = b->g;
+    int n = 0, key[GK_MAX_CELLS];
+    if(b->nmoves == 0){ out[0] = (int16_t)(g->n/2 * g->n + g->n/2); return 1; }
+    for(int c=0;c<g->cells;c++){
+        if(b->cell[c] || !b->near[c]) continue;
+        int v = c == tt_move ? INT32_MAX : gk_move_value(b, c) + history[c];
+        int j = n++;
+        while(j > 0 && key[j-1] < v){ key[j] = key[j-1]; out[j] = out[j-1]; j--; }
+        key[j] = v; out[j] = (int16_t)c;
+    }
+    return n;
+}
+
+typedef struct {
+    double deadline;        /* now_sec() limit; 0 = none */
+    atomic_int stop;
+} GkLimits;
+
+typedef struct {
+    GkBoard b;
+    GkLimits *lim;
+    long long nodes;
+    int history[GK_MAX_CELLS];
+} GkThread;
+
+int gk_negamax(GkThread *t, int depth, int alpha, int beta, int ply){
+    GkBoard *b = &t->b;
+    if((++t->nodes & 1023) == 0 && t->lim->deadline > 0 && now_sec() > t->lim->deadline) t->lim->stop = 1;
+    if(t->lim->stop) return 0;
+    if(b->winner) return -(GK_WIN - ply);           /* the previous move won */
+    if(b->nmoves == b->g->cells) return 0;
+    if(depth == 0) return b->side == 1 ? b->eval : -b->eval;
+
+    GkTTEntry *e = &gk_tt[b->key & gk_tt_mask];
+    uint64_t data = atomic_load_explicit(&e->data, memory_order_relaxed);
+    int tt_move = -1, alpha0 = alpha;
+    if((atomic_load_explicit(&e->key, memory_order_relaxed) ^ data) == b->key){
+        int s = (int32_t)(uint32_t)data, d = (int)(data >> 32 & 0xFF), flag = (int)(data >> 40 & 0xFF);
+        tt_move = (int)(data >> 48 & 0xFFFF);
+        if(tt_move >= b->g->cells || b->cell[tt_move]) tt_move = -1;
+        if(s > GK_WIN - 1000) s -= ply; else if(s < -(GK_WIN - 1000)) s += ply;   /* stored root-relative */
+        if(d >= depth){
+            if(flag == GK_EXACT) return s;
+            if(flag == GK_LOWER && s >= beta) return s;
+            if(flag == GK_UPPER && s <= alpha) return s;
+        }
+    }
+
+    int16_t moves[GK_MAX_CELLS];
+    int nm = gk_gen_moves(b, tt_move, t->history, moves);
+    int best = -GK_INF, best_move = moves[0];
+    for(int i=0;i<nm;i++){
+        gk_play(b, moves[i]);
+        int s = -gk_negamax(t, depth-1, -beta, -alpha, ply+1);
+        gk_undo(b);
+        if(t->lim->stop) return 0;
+        if(s > best){ best = s; best_move = moves[i]; }
+        if(s > alpha) alpha = s;
+        if(alpha >= beta){ t->history[moves[i]] += depth*depth; break; }
+    }
+
+    int flag = best <= alpha0 ? GK_UPPER : best >= beta ? GK_LOWER : GK_EXACT;
+    int s = best;
+    if(s > GK_WIN - 1000) s += ply; else if(s < -(GK_WIN - 1000)) s -= ply;
+    data = (uint32_t)s | (uint64_t)(depth & 0xFF) << 32 | (uint64_t)flag << 40 | (uint64_t)(uint16_t)best_move << 48;
+    atomic_store_explicit(&e->data, data, memory_order_relaxed);
+    atomic_store_explicit(&e->key, b->key ^ data, memory_order_relaxed);
+    return best;
+}
+
+/* One root iteration shared by the search threads: the first (previous
+   best) move is searched alone for a bound, the rest are handed out one at
+   a time and searched against the best score so far. */
+typedef struct {
+    const GkBoard *root;
+    GkLimits *lim;
+    GkThread *th;           /* one per parallel_for task */
+    int depth, nm;
+    int16_t moves[GK_MAX_CELLS];
+    atomic_int next;
+    pthread_mutex_t mu;
+    int best, best_move;
+} GkRoot;
+
+void gk_root_move(GkRoot *r, GkThread *t, int i){
+    pthread_mutex_lock(&r->mu);
+    int alpha = r->best;
+    pthread_mutex_unlock(&r->mu);
+    gk_play(&t->b, r->moves[i]);
+    int s = -gk_negamax(t, r->depth-1, -GK_INF, -alpha, 1);
+    gk_undo(&t->b);
+    if(t->lim->stop) return;
+    pthread_mutex_lock(&r->mu);
+    if(s > r->best){ r->best = s; r->best_move = r->moves[i]; }
+    pthread_mutex_unlock(&r->mu);
+}
+
+/* parallel_for task: search thread t takes root moves until none are left. */
+void gk_root_task(void *ctx, int t){
+    GkRoot *r = ctx;
+    int i;
+    while((i = atomic_fetch_add(&r->next, 1)) < r->nm && !r->lim->stop)
+        gk_root_move(r, &r->th[t], i);
+}
+
+typedef struct { int move, score, depth; long long nodes; double secs; } GkResult;
+
+/* Iterative deepening from b for the side to move, until max_depth or the
+   time budget (ms, 0 = none) runs out. Each depth runs on the parallel_for
+   pool. Returns move -1 if memory runs out. */
+GkResult gk_search(const GkBoard *b, int nthreads, int max_depth, int budget_ms){
+    pthread_once(&gk_tt_once, gk_tt_alloc);
+    if(nthreads < 1) nthreads = 1;
+    GkResult res = { -1, 0, 0, 0, 0 };
+    GkLimits lim; atomic_init(&lim.stop, 0);
+    double t0 = now_sec();
+    lim.deadline = budget_ms > 0 ? t0 + budget_ms/1000.0 : 0;
+    GkThread *th = malloc(nthreads * sizeof *th);
+    GkRoot *r = malloc(sizeof *r);
+    if(!th || !r){ free(th); free(r); return res; }
+    for(int i=0;i<nthreads;i++){ th[i].b = *b; th[i].lim = &lim; th[i].nodes = 0; memset(th[i].history, 0, sizeof th[i].history); }
+    pthread_mutex_init(&r->mu, NULL);
+    r->root = b; r->lim = &lim; r->th = th;
+    r->nm = gk_gen_moves(b, -1, th[0].history, r->moves);
+    if(r->nm) res.move = r->moves[0];
+    for(int d=1; d<=max_depth && r->nm > 1; d++){
+        r->depth = d;
+        r->best = -GK_INF; r->best_move = r->moves[0];
+        gk_root_move(r, &th[0], 0);
+        atomic_init(&r->next, 1);
+        parallel_for(nthreads, nthreads, gk_root_task, r);
+        if(lim.stop) break;
+        res.move = r->best_move; res.score = r->best; res.depth = d;
+        for(int i=0;i<r->nm;i++) if(r->moves[i] == r->best_move){   /* search it first next time */
+            memmove(r->moves+1, r->moves, i * sizeof r->moves[0]);
+            r->moves[0] = (int16_t)res.move;
+            break;
+        }
+        if(r->best > GK_WIN - 1000 || r->best < -(GK_WIN - 1000)) break;   /* forced result found */
+    }
+    for(int i=0;i<nthreads;i++) res.nodes += th[i].nodes;
+    res.secs = now_sec() - t0;
+    pthread_mutex_destroy(&r->mu);
+    free(r); free(th);
+    return res;
+}
+
+void gk_draw(const GkBoard *b){
+    int n = b->g->n;
+    uprintf("\n   ");
+    for(int c=0;c<n;c++) uprintf("%2d", c);
+    uprintf("\n");
+    for(int r=0;r<n;r++){
+        uprintf("%2d ", r);
+        for(int c=0;c<n;c++){ int v = b->cell[r*n+c]; uprintf(" %c", v==1 ? 'X' : v==2 ? 'O' : '.'); }
+        uprintf("\n");
+    }
+}
+
+int gk_read_int(const char *prompt, int def, int lo, int hi){
+    char buf[32]; int v;
+    read_line(prompt, buf, sizeof buf);
+    if(sscanf(buf, "%d", &v) != 1) v = def;
+    return v < lo ? lo : v > hi ? hi : v;
+}
+
+void game_gomoku(const char *username){
+    int n = gk_read_int("Board size 3-15 [15]: ", 15, 3, GK_MAX_N);
+    int k = gk_read_int("Win length [5]: ", n < 5 ? n : 5, 3, n);
+    int ms = gk_read_int("AI time per move in ms [500]: ", 500, 10, 60000);
+    if(io_closed) return;
+    GkGeom *g = malloc(sizeof *g);
+    GkBoard *b = malloc(sizeof *b);
+    gk_geom_init(g, n, k);
+    gk_board_init(b, g);
+    uprintf("\n-- %dx%d, %d in a row: You = X, AI = O --\n", n, n, k);
+    char buf[32];
+    while(!b->winner && b->nmoves < g->cells){
+        gk_draw(b);
+        if(b->side == 1){
+            int r, c;
+            if(!read_line("Your move (row col): ", buf, sizeof buf)) break;
+            if(sscanf(buf, "%d %d", &r, &c)!=2 || r<0 || r>=n || c<0 || c>=n || b->cell[r*n+c]){ uprintf("Invalid move.\n"); continue; }
+            gk_play(b, r*n+c);
+        } else {
+            GkResult res = gk_search(b, cpu_count(), 64, ms);
+            if(res.move < 0){ uprintf("Out of memory.\n"); free(b); free(g); return; }
+            uprintf("AI plays %d %d (depth %d, %lld nodes)\n", res.move / n, res.move % n, res.depth, res.nodes);
+            gk_play(b, res.move);
+        }
+    }
+    if(io_closed){ free(b); free(g); return; }     /* abandoned */
+    gk_draw(b);
+    if(b->winner == 2){ uprintf("AI wins.\n"); increment_games_played(username, 0); }
+    else if(b->winner == 1){ uprintf("You win!\n"); increment_games_played(username, 1); }
+    else { uprintf("Draw.\n"); increment_games_played(username, 0); }
+    free(b); free(g);
+}
+
+void games_menu(const char *username){
+    while(1){
+        uprintf("\n=== Games ===\n1) Number Guess\n2) Tic-Tac-Toe\n3) Gomoku (N x N, k in a row)\n4) Number Guess Simulator\n0) Back\nChoose: ");
+        char buf[16];
+        if(!read_line("", buf, sizeof buf) || strcmp(buf,"0")==0) return;
+        else if(strcmp(buf,"1")==0){ PROF_BEGIN(); game_number_guess(username); PROF_END(PROF_NUMBER_GUESS); }
+        else if(strcmp(buf,"2")==0){ PROF_BEGIN(); game_tictactoe(username); PROF_END(PROF_TICTACTOE); }
+        else if(strcmp(buf,"3")==0) game_gomoku(username);
+        else if(strcmp(buf,"4")==0) guess_simulator();
+        else uprintf("Invalid.\n");
+    }
+}
+
+/* ---------- Content pack ----------
+   Tutorials and quiz questions come from a compiled pack, so they can be
+   shipped without recompiling. Build one with
+   cplayground --pack content.txt [out.pack] (default data/content.pack,
+   or $CPLAYGROUND_CONTENT). The file is mmapped and served in place:
+   - a 64-byte header;
+   - topics (id hash and string offsets), in source order;
+   - an open-addressed slot table mapping name_hash(id) to a topic;
+   - questions (topic, text and answer offsets), in source order;
+   - one table of interned NUL-terminated strings.
+   Every string handed out is a pointer into the mapping. Offsets are
+   checked when used, not at open time, so opening touches only the header
+   and a quiz touches only the questions it samples. Without a pack file
+   the built-in content below is packed in memory at first use.
+
+   Source format, one directive per line:
+     @topic <id> <title>   starts a topic; the lines up to the next
+                           directive are its text
+     @quiz <id>            following questions belong to topic <id>
+     @q <question>         a question (for the current topic)
+     @a <answer>           its answer, compared case-insensitively
+   Other lines outside a topic's text are ignored. */
+#define PACK_MAGIC 0x4B435043u /* "CPCK" */
+#define PACK_VERSION 1
+#define CONTENT_PACK DATA_DIR "/content.pack"
+
+typedef struct {
+    uint32_t magic, version, ntopics, nquestions, nslots, reserved0;
+    uint64_t topics_off, slots_off, questions_off, strings_off, strings_size;
+} PackHeader;
+
+typedef struct { uint32_t hash, id, title, body; } PackTopic;
+typedef struct { uint32_t topic, text, answer, reserved; } PackQuestion;
+
+_Static_assert(sizeof(PackHeader) == 64, "PackHeader must be one cache line");
+
+typedef struct {
+    MappedFile m;
+    uint8_t *owned;             /* built in memory instead of mapped */
+    const PackHeader *h;
+    const PackTopic *topics;
+    const uint32_t *slots;      /* topic index + 1, 0 = empty */
+    const PackQuestion *questions;
+    const char *strings;
+} ContentPack;
+
+const char builtin_content[] =
+    "@topic basics Basics\n"
+    "Variables, types, printf/scanf, functions.\n"
+    "@topic pointers Pointers\n"
+    "Pointers, & (address), * (dereference), malloc/free.\n"
+    "@topic ds Data Structures\n"
+    "Arrays, linked lists, stacks, queues, trees, graphs basics.\n"
+    "@quiz basics\n"
+    "@q Which function prints to stdout? (printf/print)\n@a printf\n"
+    "@quiz pointers\n"
+    "@q Operator to get variable address? (&/*)\n@a &\n"
+    "@q Which header for malloc? (stdlib.h/stdio.h)\n@a stdlib.h\n"
+    "@quiz basics\n"
+    "@q Loop that checks condition at end? (do-while/while)\n@a do-while\n"
+    "@quiz ds\n"
+    "@q What is array indexing base? (0/1)\n@a 0\n";
+
+/* Pack builder: growable sections plus a hash set that interns strings.
+   pack_intern returns 0 and sets oom when it cannot grow. */
+typedef struct {
+    PackTopic *topics; int ntopics, tcap;
+    PackQuestion *qs; int nqs, qcap;
+    char *str; size_t slen, scap;
+    uint32_t *intern; size_t icap, icount;   /* string offset + 1 */
+    char **ids; uint32_t *qtopic_name;       /* per-question pending @quiz id */
+    int oom;                                 /* an allocation failed */
+} PackBuilder;
+
+uint32_t pack_intern(PackBuilder *b, const char *s, size_t n){
+    if(b->icount * 2 >= b->icap){
+        size_t cap = b->icap ? b->icap * 2 : 1024;
+        uint32_t *t = calloc(cap, sizeof *t);
+        if(!t){ b->oom = 1; return 0; }
+        for(size_t i=0;i<b->icap;i++) if(b->intern[i]){
+            const char *o = b->str + b->intern[i] - 1;
+            size_t p = name_hash(o) & (cap - 1);
+            while(t[p]) p = (p + 1) & (cap - 1);
+            t[p] = b->intern[i];
+        }
+        free(b->intern);
+        b->intern = t; b->icap = cap;
+    }
+    size_t p = name_hash_n(s, n) & (b->icap - 1);
+    for(; b->intern[p]; p = (p + 1) & (b->icap - 1)){
+        const char *o = b->str + b->intern[p] - 1;
+        if(strncmp(o, s, n) == 0 && o[n] == 0) return b->intern[p] - 1;
+    }
+    if(b->slen + n + 1 > b->scap){
+        size_t cap = b->scap;
+        while(b->slen + n + 1 > cap) cap = cap ? cap * 2 : 1 << 16;
+        char *str = realloc(b->str, cap);
+        if(!str){ b->oom = 1; return 0; }
+        b->str = str; b->scap = cap;
+    }
+    uint32_t off = (uint32_t)b->slen;
+    memcpy(b->str + off, s, n);
+    b->str[off + n] = 0;
+    b->slen += n + 1;
+    b->intern[p] = off + 1;
+    b->icount++;
+    return off;
+}
+
+int pack_find_topic(const PackBuilder *b, const uint32_t *slots, uint32_t nslots, const char *id, size_t n){
+    for(uint32_t p = name_hash_n(id, n) & (nslots - 1); slots[p]; p = (p + 1) & (nslots - 1)){
+        const char *t = b->str + b->topics[slots[p] - 1].id;
+        if(strncmp(t, id, n) == 0 && t[n] == 0) return (int)slots[p] - 1;
+    }
+    return -1;
+}
+
+void pack_builder_free(PackBuilder *b){
+    free(b->topics); free(b->qs); free(b->str); free(b->intern); free(b->qtopic_name);
+    memset(b, 0, sizeof *b);
+}
+
+/* Compiles source text into a pack image in *out (malloc'd). Returns its
+   size, or 0 with a message in err. */
+size_t pack_build(const char *src, size_t len, uint8_t **out, char *err, size_t errn){
+    PackBuilder b;
+    memset(&b, 0, sizeof b);
+    *out = NULL;
+    pack_intern(&b, "", 0);                 /* offset 0 is the empty string */
+    if(b.oom) goto oom;
+    int cur = -1, lineno = 0, want_answer = 0, in_body = 0;
+    uint32_t quiz_name = UINT32_MAX;        /* @quiz id, resolved at the end */
+    size_t body_start = 0, body_end = 0;
+    const char *p = src, *end = src + len;
+    for(;;){
+        const char *nl = p < end ? memchr(p, '\n', (size_t)(end - p)) : NULL;
+        const char *le = nl ? nl : end;
+        int last = p >= end;
+        size_t n = last ? 0 : (size_t)(le - p);
+        if(n && p[n-1] == '\r') n--;
+        lineno++;
+        int directive = last || (n && p[0] == '@');
+        if(directive && in_body){
+            size_t bl = body_end - body_start;
+            while(bl && (src[body_start + bl - 1] == '\n' || src[body_start + bl - 1] == '\r')) bl--;
+            b.topics[cur].body = pack_intern(&b, src + body_start, bl);
+            body_start = body_end = 0;
+            in_body = 0;
+        }
+        if(last) break;
+        if(!directive){
+            if(in_body && (n || body_end > body_start)){
+                if(body_end == body_start) body_start = (size_t)(p - src);
+                body_end = (size_t)(le - src) + (nl ? 1 : 0);
+            }
+        } else {
+            const char *arg = p + 1;
+            size_t kw = 0;
+            while(kw + 1 < n && !is_field_space(arg[kw])) kw++;
+            const char *rest = arg + kw;
+            size_t rn = n - 1 - kw;
+            while(rn && is_field_space(*rest)){ rest++; rn--; }
+            if(want_answer && !(kw == 1 && arg[0] == 'a')){ snprintf(err, errn, "line %d: @a expected", lineno); goto fail; }
+            if(kw == 5 && strncmp(arg, "topic", 5) == 0){
+                size_t il = 0;
+                while(il < rn && !is_field_space(rest[il])) il++;
+                if(il == 0){ snprintf(err, errn, "line %d: @topic needs an id", lineno); goto fail; }
+                if(b.ntopics == b.tcap){
+                    int cap = b.tcap ? b.tcap * 2 : 64;
+                    PackTopic *topics = realloc(b.topics, cap * sizeof *topics);
+                    if(!topics) goto oom;
+                    b.topics = topics; b.tcap = cap;
+                }
+                PackTopic *t = &b.topics[b.ntopics];
+                t->id = pack_intern(&b, rest, il);
+                t->hash = name_hash(b.str + t->id);
+                const char *title = rest + il;
+                size_t tl = rn - il;
+                while(tl && is_field_space(*title)){ title++; tl--; }
+                t->title = pack_intern(&b, tl ? title : rest, tl ? tl : il);
+                t->body = 0;
+                cur = b.ntopics++;
+                quiz_name = UINT32_MAX;
+                in_body = 1;
+            } else if(kw == 4 && strncmp(arg, "quiz", 4) == 0){
+                if(rn == 0){ snprintf(err, errn, "line %d: @quiz needs a topic id", lineno); goto fail; }
+                quiz_name = pack_intern(&b, rest, rn);
+            } else if(kw == 1 && arg[0] == 'q'){
+                if(cur < 0 && quiz_name == UINT32_MAX){ snprintf(err, errn, "line %d: question outside a topic", lineno); goto fail; }
+                if(rn == 0){ snprintf(err, errn, "line %d: empty question", lineno); goto fail; }
+                if(b.nqs == b.qcap){
+                    int cap = b.qcap ? b.qcap * 2 : 256;
+                    PackQuestion *qs = realloc(b.qs, cap * sizeof *qs);
+                    if(!qs) goto oom;
+                    b.qs = qs;
+                    uint32_t *qn = realloc(b.qtopic_name, cap * sizeof *qn);
+                    if(!qn) goto oom;
+                    b.qtopic_name = qn; b.qcap = cap;
+                }
+                PackQuestion *q = &b.qs[b.nqs];
+                memset(q, 0, sizeof *q);
+                q->text = pack_intern(&b, rest, rn);
+                q->topic = (uint32_t)cur;
+                b.qtopic_name[b.nqs++] = quiz_name;
+                want_answer = 1;
+            } else if(kw == 1 && arg[0] == 'a'){
+                if(!want_answer){ snprintf(err, errn, "line %d: @a without @q", lineno); goto fail; }
+                char ans[256];
+                if(rn == 0 || rn >= sizeof ans){ snprintf(err, errn, "line %d: bad answer", lineno); goto fail; }
+                for(size_t i=0;i<rn;i++) ans[i] = rest[i]>='A' && rest[i]<='Z' ? rest[i] + 'a'-'A' : rest[i];
+                b.qs[b.nqs-1].answer = pack_intern(&b, ans, rn);
+                want_answer = 0;
+            } else { snprintf(err, errn, "line %d: unknown directive", lineno); goto fail; }
+        }
+        if(b.oom) goto oom;
+        if(!nl) p = end; else p = nl + 1;
+    }
+    if(b.oom) goto oom;
+    if(want_answer){ snprintf(err, errn, "line %d: @a expected", lineno); goto fail; }
+    if(b.ntopics == 0){ snprintf(err, errn, "no topics"); goto fail; }
+
+    uint32_t nslots = 16;
+    while(nslots < (uint32_t)b.ntopics * 2) nslots *= 2;
+    uint32_t *slots = calloc(nslots, sizeof *slots);
+    if(!slots) goto oom;
+    for(int i=0;i<b.ntopics;i++){
+        const char *id = b.str + b.topics[i].id;
+        if(pack_find_topic(&b, slots, nslots, id, strlen(id)) >= 0){
+            snprintf(err, errn, "duplicate topic id '%s'", id); free(slots); goto fail;
+        }
+        uint32_t s = name_hash(id) & (nslots - 1);
+        while(slots[s]) s = (s + 1) & (nslots - 1);
+        slots[s] = (uint32_t)i + 1;
+    }
+    for(int i=0;i<b.nqs;i++){
+        if(b.qtopic_name[i] == UINT32_MAX) continue;
+        const char *id = b.str + b.qtopic_name[i];
+        int t = pack_find_topic(&b, slots, nslots, id, strlen(id));
+        if(t < 0){ snprintf(err, errn, "@quiz names unknown topic '%s'", id); free(slots); goto fail; }
+        b.qs[i].topic = (uint32_t)t;
+    }
+
+    PackHeader h;
+    memset(&h, 0, sizeof h);
+    h.magic = PACK_MAGIC; h.version = PACK_VERSION;
+    h.ntopics = (uint32_t)b.ntopics; h.nquestions = (uint32_t)b.nqs; h.nslots = nslots;
+    h.topics_off = sizeof h;
+    h.slots_off = h.topics_off + (uint64_t)b.ntopics * sizeof(PackTopic);
+    h.questions_off = (h.slots_off + (uint64_t)nslots * 4 + 15) & ~(uint64_t)15;
+    h.strings_off = h.questions_off + (uint64_t)b.nqs * sizeof(PackQuestion);
+    h.strings_size = b.slen;
+    size_t size = (size_t)(h.strings_off + h.strings_size);
+    uint8_t *img = calloc(1, size);
+    if(!img){ free(slots); goto oom; }
+    memcpy(img, &h, sizeof h);
+    memcpy(img + h.topics_off, b.topics, (size_t)b.ntopics * sizeof(PackTopic));
+    memcpy(img + h.slots_off, slots, (size_t)nslots * 4);
+    if(b.nqs) memcpy(img + h.questions_off, b.qs, (size_t)b.nqs * sizeof(PackQuestion));
+    memcpy(img + h.strings_off, b.str, b.slen);
+    free(slots);
+    pack_builder_free(&b);
+    *out = img;
+    return size;
+oom:
+    snprintf(err, errn, "out of memory");
+fail:
+    pack_builder_free(&b);
+    return 0;
+}
+
+/* Checks the header and section bounds only; returns 0 if unusable. */
+int pack_attach(ContentPack *c, const uint8_t *data, size_t size){
+    const PackHeader *h = (const PackHeader*)data;
+    if(size < sizeof *h || h->magic != PACK_MAGIC || h->version != PACK_VERSION || h->ntopics == 0 ||
+       h->nslots == 0 || (h->nslots & (h->nslots - 1)) || h->nslots < h->ntopics ||
+       h->topics_off + (uint64_t)h->ntopics * sizeof(PackTopic) > h->slots_off ||
+       h->slots_off + (uint64_t)h->nslots * 4 > h->questions_off ||
+       h->questions_off + (uint64_t)h->nquestions * sizeof(PackQuestion) > h->strings_off ||
+       h->strings_off + h->strings_size > size || h->strings_size == 0 ||
+       data[h->strings_off + h->strings_size - 1] != 0 || (h->topics_off | h->slots_off | h->questions_off) & 3) return 0;
+    c->h = h;
+    c->topics = (const PackTopic*)(data + h->topics_off);
+    c->slots = (const uint32_t*)(data + h->slots_off);
+    c->questions = (const PackQuestion*)(data + h->questions_off);
+    c->strings = (const char*)(data + h->strings_off);
+    return 1;
+}
+
+/* Opens a pack file, or the built-in content if path is NULL. */
+int pack_open(ContentPack *c, const char *path){
+    memset(c, 0, sizeof *c);
+    if(path){
+        if(!map_file(path, &c->m)) return 0;
+        if(pack_attach(c, c->m.data, c->m.size)){
+#ifndef _WIN32
+            /* quizzes sample at random: no readahead around each question */
+            if(c->m.mapped) posix_madvise((void*)c->m.data, c->m.size, POSIX_MADV_RANDOM);
+#endif
+            return 1;
+        }
+        unmap_file(&c->m);
+        return 0;
+    }
+    char err[128];
+    size_t size = pack_build(builtin_content, sizeof builtin_content - 1, &c->owned, err, sizeof err);
+    return size && pack_attach(c, c->owned, size);
+}
+
+void pack_close(ContentPack *c){
+    if(c->m.data) unmap_file(&c->m);
+    free(c->owned);
+    memset(c, 0, sizeof *c);
+}
+
+/* Zero-copy string at off; "" if out of range. */
+const char *pack_str(const ContentPack *c, uint32_t off){
+    return off < c->h->strings_size ? c->strings + off : "";
+}
+
+/* Topic index for id by hash probe, or -1. */
+int pack_topic(const ContentPack *c, const char *id){
+    uint32_t hash = name_hash(id), mask = c->h->nslots - 1;
+    for(uint32_t p = hash & mask, n = 0; c->slots[p] && n < c->h->nslots; p = (p + 1) & mask, n++){
+        uint32_t t = c->slots[p] - 1;
+        if(t < c->h->ntopics && c->topics[t].hash == hash && strcmp(pack_str(c, c->topics[t].id), id) == 0) return (int)t;
+    }
+    return -1;
+}
+
+/* The pack used by the menus: $CPLAYGROUND_CONTENT or data/content.pack if
+   it opens, else the built-in content. Opened once per process. */
+ContentPack content;
+pthread_once_t content_once = PTHREAD_ONCE_INIT;
+
+void content_init(void){
+    const char *e = getenv("CPLAYGROUND_CONTENT");
+    if(pack_open(&content, e && e[0] ? e : CONTENT_PACK)) return;
+    if(e && e[0]) fprintf(stderr, "Cannot open content pack %s; using built-in content.\n", e);
+    pack_open(&content, NULL);
+}
+
+const ContentPack *content_pack(void){
+    pthread_once(&content_once, content_init);
+    return &content;
+}
+
+int pack_main(int argc, char **argv){
+    if(argc < 3){ printf("Usage: %s --pack content.txt [out.pack]\n", argv[0]); return 1; }
+    const char *out = argc >= 4 ? argv[3] : CONTENT_PACK;
+    MappedFile src;
+    if(!map_file(argv[2], &src)){ perror(argv[2]); return 1; }
+    char err[160];
+    uint8_t *img;
+    double t0 = now_sec();
+    size_t size = pack_build((const char*)src.data, src.size, &img, err, sizeof err);
+    double t = now_sec() - t0;
+    unmap_file(&src);
+    if(!size){ fprintf(stderr, "%s: %s\n", argv[2], err); return 1; }
+    if(argc < 4) ensure_data_dir();
+    char tmp[300];
+    snprintf(tmp, sizeof tmp, "%s.tmp", out);
+    FILE *f = fopen(tmp, "wb");
+    int ok = f && fwrite(img, 1, size, f) == size;
+    if(f && fclose(f) != 0) ok = 0;
+    if(ok) ok = rename(tmp, out) == 0; else remove(tmp);
+    const PackHeader *h = (const PackHeader*)img;
+    if(ok) printf("Packed %u topics, %u questions, %llu bytes of strings into %s (%zu bytes, %.3f s).\n",
+                  h->ntopics, h->nquestions, (unsigned long long)h->strings_size, out, size, t);
+    else fprintf(stderr, "Cannot write %s.\n", out);
+    free(img);
+    return ok ? 0 : 1;
+}
+
+/* ---------- Tutorials & Quiz ---------- */
+#define QUIZ_LEN 5
+#define LEARN_MENU_TOPICS 8     /* topics listed by number; the rest by id */
+
+void show_tutorial_topic(const char *topic){
+    const ContentPack *c = content_pack();
+    int t = pack_topic(c, topic);
+    if(t < 0){ uprintf("Unknown topic '%s'.\n", topic); return; }
+    uprintf("\n-- %s --\n%s\n", pack_str(c, c->topics[t].title), pack_str(c, c->topics[t].body));
+}
+
+/* Asks QUIZ_LEN questions: all of them in order if the pack has no more,
+   else a random sample (Floyd's algorithm, touching only those records). */
+int run_quiz_simple(const char *username){
+    const ContentPack *c = content_pack();
+    uint32_t total = c->h->nquestions, pick[QUIZ_LEN];
+    int n = total < QUIZ_LEN ? (int)total : QUIZ_LEN;
+    if(n == 0){ uprintf("No quiz questions available.\n"); return 0; }
+    if(total <= QUIZ_LEN) for(int i=0;i<n;i++) pick[i] = (uint32_t)i;
+    else {
+        Rng *r = rng_thread();
+        for(uint32_t j = total - QUIZ_LEN, k = 0; j < total; j++, k++){
+            uint32_t x = (uint32_t)rng_below(r, (uint64_t)j + 1);
+            for(uint32_t i=0;i<k;i++) if(pick[i] == x){ x = j; break; }
+            pick[k] = x;
+        }
+    }
+    int score=0; char buf[128];
+    for(int i=0;i<n;i++){
+        const PackQuestion *q = &c->questions[pick[i]];
+        const char *ans = pack_str(c, q->answer);
+        uprintf("\nQ%d) %s\n> ", i+1, pack_str(c, q->text));
+        if(!read_line(NULL, buf, sizeof buf)) return score;     /* left mid-quiz: not counted */
+        if(strlen(buf)==0){ uprintf("No answer. Correct: %s\n", ans); continue; }
+        for(char *p=buf; *p; ++p) if(*p>='A' && *p<='Z') *p += 'a'-'A';
+        if(strcmp(buf, ans)==0){ uprintf("Correct.\n"); score++; }
+        else uprintf("Wrong. Answer: %s\n", ans);
+    }
+    uprintf("You scored %d/%d\n", score, n);
+    if(score>0) increment_quiz(username);
+    return score;
+}
+
+void learn_menu(const char *username){
+    const ContentPack *c = content_pack();
+    int shown = c->h->ntopics < LEARN_MENU_TOPICS ? (int)c->h->ntopics : LEARN_MENU_TOPICS;
+    int more = (int)c->h->ntopics > shown;
+    while(1){
+        uprintf("\n=== Learn C ===\n");
+        for(int i=0;i<shown;i++) uprintf("%d) %s\n", i+1, pack_str(c, c->topics[i].title));
+        uprintf("%d) Short Quiz\n", shown+1);
+        if(more) uprintf("t) Topic by id (%u topics)\n", c->h->ntopics);
+        uprintf("0) Back\nChoose: ");
+        char buf[16];
+        if(!read_line("", buf, sizeof buf) || strcmp(buf,"0")==0) return;
+        int k = atoi(buf);
+        if(k >= 1 && k <= shown) show_tutorial_topic(pack_str(c, c->topics[k-1].id));
+        else if(k == shown+1){ PROF_BEGIN(); run_quiz_simple(username); PROF_END(PROF_QUIZ); }
+        else if(more && strcmp(buf,"t")==0){
+            char id[128];
+            if(!read_line("Topic id: ", id, sizeof id)) return;
+            show_tutorial_topic(id);
+        }
+        else uprintf("Invalid.\n");
+    }
+}
+
+/* ---------- Algorithms demo ---------- */
+static int cmp_int(const void *a, const void *b){
+    int ia = *(const int*)a;
+    int ib = *(const int*)b;
+    return (ia > ib) - (ia < ib);
+}
+
+void demo_sorting(void){
+    char buf[32]; int n=0;
+    if(!read_line("Enter array size (5..20): ", buf, sizeof buf)) return;
+    if(sscanf(buf, "%d", &n)!=1 || n<5 || n>20){ uprintf("Invalid size.\n"); return; }
+    int a[20];
+    srand((unsigned)time(NULL));
+    for(int i=0;i<n;i++) a[i]=rand()%100;
+    uprintf("Original: ");
+    for(int i=0;i<n;i++) uprintf("%d ", a[i]); uprintf("\n");
+    if(!read_line("Choose: 1) Bubble 2) Insertion 3) Quick (qsort)\nChoice: ", buf, sizeof buf)) return;
+    if(strcmp(buf,"1")==0){
+        for(int i=0;i<n-1;i++) for(int j=0;j<n-1-i;j++) if(a[j]>a[j+1]){ int t=a[j]; a[j]=a[j+1]; a[j+1]=t; }
+    } else if(strcmp(buf,"2")==0){
+        for(int i=1;i<n;i++){ int key=a[i], j=i-1; while(j>=0 && a[j]>key){ a[j+1]=a[j]; j--; } a[j+1]=key; }
+    } else {
+        qsort(a, n, sizeof(int), cmp_int);
+    }
+    uprintf("Sorted: ");
+    for(int i=0;i<n;i++) uprintf("%d ", a[i]); uprintf("\n");
+}
+
+void demo_binary_search(void){
+    int n=10, a[10];
+    for(int i=0;i<n;i++) a[i]=i*2;
+    uprintf("Array: ");
+    for(int i=0;i<n;i++) uprintf("%d ", a[i]); uprintf("\n");
+    char buf[32];
+    if(!read_line("Search for: ", buf, sizeof buf)) return;
+    int key = atoi(buf);
+    int l=0, r=n-1, found=-1, steps=0;
+    while(l<=r){
+        steps++;
+        int m=(l+r)/2;
+        if(a[m]==key){ found=m; break; }
+        else if(a[m]<key) l=m+1; else r=m-1;
+    }
+    if(found>=0) uprintf("Found at index %d in %d steps.\n", found, steps);
+    else uprintf("Not found after %d steps.\n", steps);
+}
+
+/* ---------- Sorting engine ----------
+   int sorts for the sorting benchmark: introsort with inline comparisons,
+   LSD radix, an AVX2 block sort (bitonic networks on 64-int blocks, then
+   merging), and a multithreaded merge sort. */
+void sort_insertion_int(int *a, size_t n){
+    for(size_t i=1;i<n;i++){
+        int key = a[i]; size_t j = i;
+        while(j > 0 && a[j-1] > key){ a[j] = a[j-1]; j--; }
+        a[j] = key;
+    }
+}
+
+void sort_heap_sift(int *a, size_t n, size_t i){
+    int v = a[i];
+    for(size_t c; (c = 2*i+1) < n; i = c){
+        if(c+1 < n && a[c+1] > a[c]) c++;
+        if(a[c] <= v) break;
+        a[i] = a[c];
+    }
+    a[i] = v;
+}
+
+void sort_heap_int(int *a, size_t n){
+    for(size_t i=n/2; i-- > 0; ) sort_heap_sift(a, n, i);
+    for(size_t i=n; i-- > 1; ){ int t = a[0]; a[0] = a[i]; a[i] = t; sort_heap_sift(a, i, 0); }
+}
+
+void introsort_loop(int *a, size_t n, int depth){
+    while(n > 16){
+        if(depth-- == 0){ sort_heap_int(a, n); return; }
+        int x = a[0], y = a[n/2], z = a[n-1];
+        int pivot = x < y ? (y < z ? y : x < z ? z : x) : (x < z ? x : y < z ? z : y);
+        size_t i = 0, j = n-1;
+        for(;;){                            /* Hoare partition */
+            while(a[i] < pivot) i++;
+            while(a[j] > pivot) j--;
+            if(i >= j) break;
+            int t = a[i]; a[i] = a[j]; a[j] = t;
+            i++; j--;
+        }
+        size_t left = j+1;                  /* [0, left) <= pivot <= [left, n) */
+        if(left < n-left){ introsort_loop(a, left, depth); a += left; n -= left; }
+        else { introsort_loop(a+left, n-left, depth); n = left; }
+    }
+}
+
+void sort_introsort_int(int *a, size_t n){
+    int depth = 0;
+    for(size_t m=n; m>1; m>>=1) depth += 2;
+    introsort_loop(a, n, depth);
+    sort_insertion_int(a, n);
+}
+
+/* LSD radix on the sign-flipped value, 8 bits per pass; passes where every
+   key has the same digit are skipped. tmp must hold n ints. */
+void sort_radix_int(int *a, size_t n, int *tmp){
+    size_t cnt[4][256] = {{0}};               /* 8 KB: fits any thread's stack */
+    for(size_t i=0;i<n;i++){
+        uint32_t v = (uint32_t)a[i] ^ 0x80000000u;
+        cnt[0][v & 255]++; cnt[1][v >> 8 & 255]++; cnt[2][v >> 16 & 255]++; cnt[3][v >> 24]++;
+    }
+    int *src = a, *dst = tmp;
+    for(int p=0;p<4;p++){
+        int sh = 8*p;
+        if(n == 0 || cnt[p][((uint32_t)src[0] ^ 0x80000000u) >> sh & 255] == n) continue;
+        size_t off = 0;
+        for(int d=0;d<256;d++){ size_t c = cnt[p][d]; cnt[p][d] = off; off += c; }
+        for(size_t i=0;i<n;i++){
+            uint32_t v = (uint32_t)src[i] ^ 0x80000000u;
+            dst[cnt[p][v >> sh & 255]++] = src[i];
+        }
+        int *t = src; src = dst; dst = t;
+    }
+    if(src != a) memcpy(a, src, n * sizeof(int));
+}
+
+void merge_int(const int *a, size_t na, const int *b, size_t nb, int *out){
+    size_t i = 0, j = 0, k = 0;
+    while(i < na && j < nb){
+        int x = a[i], y = b[j], t = y < x;    /* stable: ties take from a */
+        out[k++] = t ? y : x;
+        j += t; i += !t;
+    }
+    memcpy(out+k, a+i, (na-i) * sizeof(int)); k += na-i;
+    memcpy(out+k, b+j, (nb-j) * sizeof(int));
+}
+
+/* Bottom-up merge passes from run length `width`; returns the buffer that
+   holds the result (a or tmp). */
+int *merge_passes(int *a, int *tmp, size_t n, size_t width){
+    int *src = a, *dst = tmp;
+    for( ; width < n; width *= 2){
+        for(size_t lo=0; lo<n; lo += 2*width){
+            size_t mid = lo+width < n ? lo+width : n, hi = lo+2*width < n ? lo+2*width : n;
+            merge_int(src+lo, mid-lo, src+mid, hi-mid, dst+lo);
+        }
+        int *t = src; src = dst; dst = t;
+    }
+    return src;
+}
+
+#ifdef CPG_X86
+#define SORT_CX(a, b) do{ __m256i t_ = _mm256_min_epi32(a, b); b = _mm256_max_epi32(a, b); a = t_; }while(0)
+
+/* Sorts one bitonic vector of 8 ints. */
+__attribute__((target("avx2")))
+static inline __m256i avx2_bitonic8(__m256i v){
+    __m256i p = _mm256_permute2x128_si256(v, v, 1);
+    v = _mm256_blend_epi32(_mm256_min_epi32(v, p), _mm256_max_epi32(v, p), 0xF0);
+    p = _mm256_shuffle_epi32(v, _MM_SHUFFLE(1,0,3,2));
+    v = _mm256_blend_epi32(_mm256_min_epi32(v, p), _mm256_max_epi32(v, p), 0xCC);
+    p = _mm256_shuffle_epi32(v, _MM_SHUFFLE(2,3,0,1));
+    return _mm256_blend_epi32(_mm256_min_epi32(v, p), _mm256_max_epi32(v, p), 0xAA);
+}
+
+/* Merges sorted runs v[0,m) and v[m,2m) (m vectors each) in registers. */
+__attribute__((target("avx2")))
+static inline void avx2_merge_vecs(__m256i *v, int m){
+    const __m256i rev = _mm256_setr_epi32(7,6,5,4,3,2,1,0);
+    for(int i=0;i<m/2;i++){ __m256i t = v[m+i]; v[m+i] = v[2*m-1-i]; v[2*m-1-i] = t; }
+    for(int i=0;i<m;i++) v[m+i] = _mm256_permutevar8x32_epi32(v[m+i], rev);
+    for(int i=0;i<m;i++) SORT_CX(v[i], v[m+i]);
+    for(int h=0;h<2*m;h+=m){
+        for(int d=m/2; d>=1; d/=2)
+            for(int i=0;i<m;i++) if(!(i & d)) SORT_CX(v[h+i], v[h+i+d]);
+        for(int i=0;i<m;i++) v[h+i] = avx2_bitonic8(v[h+i]);
+    }
+}
+
+/* Sorts 64 ints in place: an 8-input network down the columns of an 8x8
+   register tile, a transpose, then three rounds of bitonic merges. */
+__attribute__((target("avx2")))
+void avx2_sort64(int *a){
+    __m256i r[8];
+    for(int i=0;i<8;i++) r[i] = _mm256_loadu_si256((const __m256i*)(a + 8*i));
+    static const int net[19][2] = {{0,2},{1,3},{4,6},{5,7},{0,4},{1,5},{2,6},{3,7},{0,1},{2,3},
+                                   {4,5},{6,7},{2,4},{3,5},{1,4},{3,6},{1,2},{3,4},{5,6}};
+    for(int i=0;i<19;i++) SORT_CX(r[net[i][0]], r[net[i][1]]);
+    __m256i t[8], u[8];
+    for(int i=0;i<8;i+=2){ t[i] = _mm256_unpacklo_epi32(r[i], r[i+1]); t[i+1] = _mm256_unpackhi_epi32(r[i], r[i+1]); }
+    for(int i=0;i<8;i+=4){
+        u[i]   = _mm256_unpacklo_epi64(t[i],   t[i+2]); u[i+1] = _mm256_unpackhi_epi64(t[i],   t[i+2]);
+        u[i+2] = _mm256_unpacklo_epi64(t[i+1], t[i+3]); u[i+3] = _mm256_unpackhi_epi64(t[i+1], t[i+3]);
+    }
+    for(int i=0;i<4;i++){
+        r[i]   = _mm256_permute2x128_si256(u[i], u[i+4], 0x20);
+        r[i+4] = _mm256_permute2x128_si256(u[i], u[i+4], 0x31);
+    }
+    for(int m=1; m<8; m*=2)
+        for(int i=0;i<8;i+=2*m) avx2_merge_vecs(r+i, m);
+    for(int i=0;i<8;i++) _mm256_storeu_si256((__m256i*)(a + 8*i), r[i]);
+}
+#endif
+
+/* 64-int blocks sorted with avx2_sort64, then bottom-up merges. Falls back
+   to introsort without AVX2. tmp must hold n ints. */
+void sort_avx2_int(int *a, size_t n, int *tmp){
+#ifdef CPG_X86
+    if(cpu_has_avx2()){
+        size_t full = n & ~(size_t)63;
+        for(size_t i=0;i<full;i+=64) avx2_sort64(a+i);
+        if(full < n){
+            int blk[64];
+            for(int i=0;i<64;i++) blk[i] = full+i < n ? a[full+i] : INT32_MAX;
+            avx2_sort64(blk);
+            memcpy(a+full, blk, (n-full) * sizeof(int));
+        }
+        int *r = merge_passes(a, tmp, n, 64);
+        if(r != a) memcpy(a, r, n * sizeof(int));
+        return;
+    }
+#endif
+    (void)tmp;
+    sort_introsort_int(a, n);
+}
+
+/* Parallel merge sort: chunks are introsorted concurrently, then each merge
+   round is split across threads along the merge path, so the last rounds
+   stay parallel too. */
+typedef struct {
+    int *src, *dst;
+    size_t n, width;
+    int parts;              /* merge-path pieces per pair of runs */
+} ParMergeCtx;
+
+/* Number of elements taken from a in the first k outputs of merge(a, b). */
+size_t merge_corank(size_t k, const int *a, size_t na, const int *b, size_t nb){
+    size_t lo = k > nb ? k - nb : 0, hi = k < na ? k : na;
+    while(lo < hi){
+        size_t i = (lo + hi) / 2, j = k - i;
+        if(j > 0 && i < na && b[j-1] >= a[i]) lo = i + 1;  /* a[i] goes before b[j-1] */
+        else hi = i;
+    }
+    return lo;
+}
+
+void par_sort_chunk(void *arg, int i){
+    ParMergeCtx *c = arg;
+    size_t lo = (size_t)i * c->width, hi = lo + c->width < c->n ? lo + c->width : c->n;
+    if(lo < hi) sort_introsort_int(c->src + lo, hi - lo);
+}
+
+void par_merge_piece(void *arg, int t){
+    ParMergeCtx *c = arg;
+    size_t pair = t / c->parts, part = t % c->parts;
+    size_t lo = pair * 2 * c->width;
+    if(lo >= c->n) return;
+    size_t mid = lo + c->width < c->n ? lo + c->width : c->n, hi = lo + 2*c->width < c->n ? lo + 2*c->width : c->n;
+    const int *a = c->src + lo, *b = c->src + mid;
+    size_t na = mid - lo, nb = hi - mid, total = na + nb;
+    size_t k0 = total * part / c->parts, k1 = total * (part+1) / c->parts;
+    size_t i0 = merge_corank(k0, a, na, b, nb), i1 = merge_corank(k1, a, na, b, nb);
+    merge_int(a + i0, i1 - i0, b + (k0 - i0), (k1 - i1) - (k0 - i0), c->dst + lo + k0);
+}
+
+void sort_parallel_int(int *a, size_t n, int *tmp, int threads){
+    if(threads < 1) threads = 1;
+    int chunks = 1;
+    while(chunks < threads) chunks *= 2;
+    ParMergeCtx c = { a, tmp, n, (n + chunks - 1) / chunks, 1 };
+    if(c.width == 0) c.width = 1;
+    parallel_for(chunks, threads, par_sort_chunk, &c);
+    for( ; c.width < n; c.width *= 2){
+        int pairs = (int)((n + 2*c.width - 1) / (2*c.width));
+        c.parts = pairs >= threads ? 1 : (threads + pairs - 1) / pairs;
+        parallel_for(pairs * c.parts, threads, par_merge_piece, &c);
+        int *t = c.src; c.src = c.dst; c.dst = t;
+    }
+    if(c.src != a) memcpy(a, c.src, n * sizeof(int));
+}
+
+/* Sorting benchmark: sizes from 1K up to max_n (x10 steps) over four input
+   distributions, M elements/s per algorithm, then the parallel merge sort
+   at max_n for 1, 2, 4, ... threads. Every result is checked. */
+enum { DIST_RANDOM, DIST_SORTED, DIST_REVERSED, DIST_FEW_UNIQUE, DIST_COUNT };
+const char *sort_dist_names[DIST_COUNT] = {"random", "sorted", "reversed", "few-unique"};
+enum { ALG_QSORT, ALG_INTRO, ALG_RADIX, ALG_AVX2, ALG_PARALLEL, ALG_COUNT };
+const char *sort_alg_names[ALG_COUNT] = {"qsort", "introsort", "radix", "avx2-block", "par-merge"};
+
+void sort_fill(int *a, size_t n, int dist, uint64_t seed){
+    for(size_t i=0;i<n;i++){
+        uint64_t r = splitmix64(&seed);
+        if(dist == DIST_RANDOM) a[i] = (int)(uint32_t)r;
+        else if(dist == DIST_SORTED) a[i] = (int)i - (int)(n/2);
+        else if(dist == DIST_REVERSED) a[i] = (int)(n/2) - (int)i;
+        else a[i] = (int)(r % 16) * 1000003;
+    }
+}
+
+void sort_run(int alg, int *a, size_t n, int *tmp, int threads){
+    switch(alg){
+    case ALG_QSORT: qsort(a, n, sizeof(int), cmp_int); break;
+    case ALG_INTRO: sort_introsort_int(a, n); break;
+    case ALG_RADIX: sort_radix_int(a, n, tmp); break;
+    case ALG_AVX2: sort_avx2_int(a, n, tmp); break;
+    default: sort_parallel_int(a, n, tmp, threads); break;
+    }
+}
+
+/* Seconds per sort of src, repeated until ~50 ms; 0 if the output is wrong. */
+double sort_time(int alg, const int *src, size_t n, int *work, int *tmp, int threads, uint64_t sum){
+    double total = 0; int reps = 0;
+    do {
+        memcpy(work, src, n * sizeof(int));
+        double t0 = now_sec();
+        sort_run(alg, work, n, tmp, threads);
+        total += now_sec() - t0; reps++;
+    } while(total < 0.05 && reps < 1000);
+    uint64_t s = 0;
+    for(size_t i=0;i<n;i++){ s += (uint32_t)work[i]; if(i && work[i-1] > work[i]) return 0; }
+    return s == sum ? total / reps : 0;
+}
+
+void sort_benchmark(size_t max_n, int threads){
+    if(max_n < 1000) max_n = 1000;
+    if(threads < 1) threads = cpu_count();
+    int *src = malloc(max_n * sizeof(int)), *work = malloc(max_n * sizeof(int)), *tmp = malloc(max_n * sizeof(int));
+    if(!src || !work || !tmp){ uprintf("Not enough memory for %zu ints.\n", max_n); free(src); free(work); free(tmp); return; }
+    uprintf("M elements/s (par-merge with %d threads%s)\n", threads, cpu_has_avx2() ? "" : "; no AVX2, avx2-block = introsort");
+    uprintf("%10s %-11s", "n", "input");
+    for(int a=0;a<ALG_COUNT;a++) uprintf(" %11s", sort_alg_names[a]);
+    uprintf("\n");
+    for(size_t n=1000; n<=max_n; n = n*10 <= max_n || n == max_n ? n*10 : max_n){
+        for(int d=0; d<DIST_COUNT; d++){
+            sort_fill(src, n, d, 42 + n);
+            uint64_t sum = 0;
+            for(size_t i=0;i<n;i++) sum += (uint32_t)src[i];
+            uprintf("%10zu %-11s", n, sort_dist_names[d]);
+            for(int a=0;a<ALG_COUNT;a++){
+                double t = sort_time(a, src, n, work, tmp, threads, sum);
+                if(t > 0) uprintf(" %11.1f", n / t / 1e6); else uprintf(" %11s", "WRONG");
+            }
+            uprintf("\n");
+        }
+        if(n == max_n) break;
+    }
+    sort_fill(src, max_n, DIST_RANDOM, 7);
+    uint64_t sum = 0;
+    for(size_t i=0;i<max_n;i++) sum += (uint32_t)src[i];
+    int maxt = cpu_count() > 8 ? cpu_count() : 8;
+    uprintf("par-merge scaling, %zu random ints (%d CPUs):\n%8s %12s %8s\n", max_n, cpu_count(), "threads", "M elem/s", "speedup");
+    double base = 0;
+    for(int t=1; t<=maxt; t*=2){
+        double s = sort_time(ALG_PARALLEL, src, max_n, work, tmp, t, sum);
+        if(t == 1) base = s;
+        if(s > 0) uprintf("%8d %12.1f %8.2f\n", t, max_n / s / 1e6, base / s);
+        else uprintf("%8d %12s\n", t, "WRONG");
+    }
+    free(src); free(work); free(tmp);
+}
+
+/* ---------- Search engine ----------
+   Successor queries (smallest key >= x, INT32_MAX if none) over a large
+   sorted int array, in three layouts: the sorted array itself (branchless
+   binary search), Eytzinger/BFS order with prefetch, and a 16-key static
+   B-tree (S-tree) searched with AVX2 compares. The batch functions advance
+   a group of queries in lockstep so their cache misses overlap. */
+#define STREE_B 16
+#define SEARCH_GROUP 16
+
+typedef struct {
+    size_t n;
+    const int *sorted;
+    int *eytz;                  /* 1-based; eytz[0] unused */
+    int (*stree)[STREE_B];      /* nblocks nodes of 16 keys, 64-byte aligned */
+    size_t nblocks;
+} SearchIndex;
+
+/* The demo's loop (three-way branch), as the baseline. */
+int search_branchy(const int *a, size_t n, int x){
+    size_t l = 0, r = n;
+    while(l < r){
+        size_t m = (l + r) / 2;
+        if(a[m] == x) return a[m];
+        else if(a[m] < x) l = m + 1; else r = m;
+    }
+    return l < n ? a[l] : INT32_MAX;
+}
+
+int search_branchless(const int *a, size_t n, int x){
+    if(n == 0) return INT32_MAX;
+    const int *base = a;
+    size_t len = n;
+    while(len > 1){
+        size_t half = len / 2;
+        base += (base[half-1] < x) * half;      /* compiles to cmov */
+        len -= half;
+    }
+    return *base < x ? (base+1 < a+n ? base[1] : INT32_MAX) : *base;
+}
+
+void eytz_build(SearchIndex *ix, size_t *t, size_t k){
+    if(k > ix->n) return;
+    eytz_build(ix, t, 2*k);
+    ix->eytz[k] = ix->sorted[(*t)++];
+    eytz_build(ix, t, 2*k+1);
+}
+
+static inline size_t eytz_descend_end(size_t k){
+    return k >> (__builtin_ctzll(~(unsigned long long)k) + 1);    /* undo the trailing right turns */
+}
+
+int search_eytzinger(const SearchIndex *ix, int x){
+    size_t k = 1, n = ix->n;
+    const int *b = ix->eytz;
+    while(k <= n){
+        __builtin_prefetch(b + k*16);           /* four levels ahead, one cache line */
+        k = 2*k + (b[k] < x);
+    }
+    k = eytz_descend_end(k);
+    return k ? b[k] : INT32_MAX;
+}
+
+void search_eytzinger_batch(const SearchIndex *ix, const int *xs, int *out, size_t m){
+    const int *b = ix->eytz;
+    size_t n = ix->n;
+    int levels = 0;
+    while(((size_t)1 << levels) <= n) levels++;
+    for(size_t g=0; g<m; g+=SEARCH_GROUP){
+        size_t cnt = m-g < SEARCH_GROUP ? m-g : SEARCH_GROUP;
+        size_t k[SEARCH_GROUP];
+        for(size_t q=0;q<cnt;q++) k[q] = 1;
+        for(int l=0;l<levels;l++)
+            for(size_t q=0;q<cnt;q++){
+                size_t kk = k[q];
+                if(kk <= n){ __builtin_prefetch(b + kk*16); kk = 2*kk + (b[kk] < xs[g+q]); }
+                k[q] = kk;
+            }
+        for(size_t q=0;q<cnt;q++){ size_t kk = eytz_descend_end(k[q]); out[g+q] = kk ? b[kk] : INT32_MAX; }
+    }
+}
+
+static inline size_t stree_child(size_t k, int i){ return k*(STREE_B+1) + i + 1; }
+
+void stree_build(SearchIndex *ix, size_t *t, size_t k){
+    if(k >= ix->nblocks) return;
+    for(int i=0;i<STREE_B;i++){
+        stree_build(ix, t, stree_child(k, i));
+        ix->stree[k][i] = *t < ix->n ? ix->sorted[(*t)++] : INT32_MAX;
+    }
+    stree_build(ix, t, stree_child(k, STREE_B));
+}
+
+/* Number of keys in node k that are < x. */
+#ifdef CPG_X86
+__attribute__((target("avx2,popcnt")))
+int stree_rank_avx2(const int *node, int x){
+    __m256i xv = _mm256_set1_epi32(x);
+    __m256i lo = _mm256_cmpgt_epi32(xv, _mm256_load_si256((const __m256i*)node));
+    __m256i hi = _mm256_cmpgt_epi32(xv, _mm256_load_si256((const __m256i*)(node+8)));
+    unsigned mask = (unsigned)_mm256_movemask_ps(_mm256_castsi256_ps(lo)) | (unsigned)_mm256_movemask_ps(_mm256_castsi256_ps(hi)) << 8;
+    return __builtin_popcount(mask);
+}
+#endif
+
+int stree_rank_scalar(const int *node, int x){
+    int r = 0;
+    for(int i=0;i<STREE_B;i++) r += node[i] < x;
+    return r;
+}
+
+int (*stree_rank)(const int *node, int x) = stree_rank_scalar;
+
+int search_stree(const SearchIndex *ix, int x){
+    int res = INT32_MAX;
+    for(size_t k=0; k<ix->nblocks; ){
+        int i = stree_rank(ix->stree[k], x);
+        if(i < STREE_B) res = ix->stree[k][i];
+        k = stree_child(k, i);
+    }
+    return res;
+}
+
+void search_stree_batch(const SearchIndex *ix, const int *xs, int *out, size_t m){
+    for(size_t g=0; g<m; g+=SEARCH_GROUP){
+        size_t cnt = m-g < SEARCH_GROUP ? m-g : SEARCH_GROUP, k[SEARCH_GROUP], live = cnt;
+        for(size_t q=0;q<cnt;q++){ k[q] = 0; out[g+q] = INT32_MAX; }
+        while(live){
+            live = 0;
+            for(size_t q=0;q<cnt;q++){
+                if(k[q] >= ix->nblocks) continue;
+                int i = stree_rank(ix->stree[k[q]], xs[g+q]);
+                if(i < STREE_B) out[g+q] = ix->stree[k[q]][i];
+                k[q] = stree_child(k[q], i);
+                if(k[q] < ix->nblocks){ __builtin_prefetch(ix->stree[k[q]]); live++; }
+            }
+        }
+    }
+}
+
+/* Builds the Eytzinger and S-tree layouts over sorted[0, n). */
+int search_index_build(SearchIndex *ix, const int *sorted, size_t n){
+    memset(ix, 0, sizeof *ix);
+    ix->n = n; ix->sorted = sorted;
+    ix->nblocks = (n + STREE_B - 1) / STREE_B;
+    ix->eytz = malloc((n + 1) * sizeof(int));
+    ix->stree = aligned_malloc(64, (ix->nblocks ? ix->nblocks : 1) * sizeof *ix->stree);
+    if(!ix->eytz || !ix->stree){ free(ix->eytz); aligned_free(ix->stree); return 0; }
+#ifdef CPG_X86
+    if(cpu_has_avx2()) stree_rank = stree_rank_avx2;
+#endif
+    size_t t = 0;
+    eytz_build(ix, &t, 1);
+    t = 0;
+    stree_build(ix, &t, 0);
+    return 1;
+}
+
+void search_index_free(SearchIndex *ix){ free(ix->eytz); aligned_free(ix->stree); }
+
+/* Queries/s for each method over sorted arrays of 1K..max_n keys (x8 steps),
+   so the working set moves from L1 out to DRAM. */
+void search_benchmark(size_t max_n){
+    const size_t m = 1 << 20;
+    if(max_n < 1024) max_n = 1024;
+    int *a = malloc(max_n * sizeof(int)), *xs = malloc(m * sizeof(int)), *out = malloc(m * sizeof(int)), *expect = malloc(m * sizeof(int));
+    if(!a || !xs || !out || !expect){ uprintf("Not enough memory.\n"); free(a); free(xs); free(out); free(expect); return; }
+    const char *names[] = {"demo loop", "branchless", "eytzinger", "eytz batch", "s-tree", "s-tree batch"};
+    uprintf("M queries/s, %zu random successor queries per size\n%12s %9s", m, "keys", "MB");
+    for(int j=0;j<6;j++) uprintf(" %12s", names[j]);
+    uprintf("\n");
+    for(size_t n=1024; ; n = n*8 < max_n ? n*8 : max_n){
+        for(size_t i=0;i<n;i++) a[i] = (int)(2*i + 1);      /* odd keys, so half the queries miss */
+        uint64_t seed = n;
+        for(size_t i=0;i<m;i++) xs[i] = (int)(splitmix64(&seed) % (2*n + 2));
+        SearchIndex ix;
+        if(!search_index_build(&ix, a, n)){ uprintf("Not enough memory for %zu keys.\n", n); break; }
+        uprintf("%12zu %9.1f", n, n * 4.0 / 1048576);
+        for(int j=0;j<6;j++){
+            double t0 = now_sec();
+            switch(j){
+            case 0: for(size_t i=0;i<m;i++) out[i] = search_branchy(a, n, xs[i]); break;
+            case 1: for(size_t i=0;i<m;i++) out[i] = search_branchless(a, n, xs[i]); break;
+            case 2: for(size_t i=0;i<m;i++) out[i] = search_eytzinger(&ix, xs[i]); break;
+            case 3: search_eytzinger_batch(&ix, xs, out, m); break;
+            case 4: for(size_t i=0;i<m;i++) out[i] = search_stree(&ix, xs[i]); break;
+            default: search_stree_batch(&ix, xs, out, m); break;
+            }
+            double t = now_sec() - t0;
+            if(j == 0) memcpy(expect, out, m * sizeof(int));
+            if(memcmp(out, expect, m * sizeof(int)) != 0) uprintf(" %12s", "WRONG");
+            else uprintf(" %12.1f", m / t / 1e6);
+        }
+        uprintf("\n");
+        search_index_free(&ix);
+        if(n == max_n) break;
+    }
+    free(a); free(xs); free(out); free(expect);
+}
+
+/* ---------- Matrices ----------
+   Dense row-major double matrices of any size. GEMM packs B into 8-column
+   slivers and A into 6-row slivers per cache block (KC x NC of B stays in
+   L2/L3, MC x KC of A in L2) and runs a 6x8 AVX2/FMA micro-kernel; row
+   blocks of C are spread over the thread pool. Files are "CPMX", version,
+   rows, cols, then the doubles. */
+#define MAT_MAGIC 0x584D5043u   /* "CPMX" */
+#define GEMM_MR 6
+#define GEMM_NR 8
+#define GEMM_MC 120
+#define GEMM_KC 256
+#define GEMM_NC 2048
+
+typedef struct { int rows, cols; double *a; } Matrix;
+
+int mat_alloc(Matrix *m, int rows, int cols){
+    m->rows = rows; m->cols = cols;
+    size_t bytes = ((size_t)rows * cols * sizeof(double) + 63) & ~(size_t)63;
+    m->a = aligned_malloc(64, bytes);
+    if(m->a) memset(m->a, 0, bytes);
+    return m->a != NULL;
+}
+
+void mat_free(Matrix *m){ aligned_free(m->a); m->a = NULL; m->rows = m->cols = 0; }
+
+void mat_random(Matrix *m, uint64_t seed){
+    for(size_t i=0;i<(size_t)m->rows*m->cols;i++) m->a[i] = (double)(splitmix64(&seed) >> 11) / 9007199254740992.0 * 2 - 1;
+}
+
+int mat_add(const Matrix *x, const Matrix *y, Matrix *out){
+    if(x->rows != y->rows || x->cols != y->cols || !mat_alloc(out, x->rows, x->cols)) return 0;
+    for(size_t i=0;i<(size_t)x->rows*x->cols;i++) out->a[i] = x->a[i] + y->a[i];
+    return 1;
+}
+
+int mat_transpose(const Matrix *x, Matrix *out){
+    if(!mat_alloc(out, x->cols, x->rows)) return 0;
+    for(int i0=0;i0<x->rows;i0+=32) for(int j0=0;j0<x->cols;j0+=32)
+        for(int i=i0;i<i0+32 && i<x->rows;i++) for(int j=j0;j<j0+32 && j<x->cols;j++)
+            out->a[(size_t)j*x->rows + i] = x->a[(size_t)i*x->cols + j];
+    return 1;
+}
+
+/* C[0..mr, 0..nr) += Ap (kc x 6 sliver) * Bp (kc x 8 sliver). */
+void gemm_kernel_scalar(int kc, const double *ap, const double *bp, double *c, int ldc, int mr, int nr){
+    double acc[GEMM_MR][GEMM_NR] = {{0}};
+    for(int k=0;k<kc;k++)
+        for(int r=0;r<GEMM_MR;r++) for(int j=0;j<GEMM_NR;j++) acc[r][j] += ap[k*GEMM_MR + r] * bp[k*GEMM_NR + j];
+    for(int r=0;r<mr;r++) for(int j=0;j<nr;j++) c[(size_t)r*ldc + j] += acc[r][j];
+}
+
+#ifdef CPG_X86
+__attribute__((target("avx2,fma")))
+void gemm_kernel_avx2(int kc, const double *ap, const double *bp, double *c, int ldc, int mr, int nr){
+    __m256d c00 = _mm256_setzero_pd(), c01 = c00, c10 = c00, c11 = c00, c20 = c00, c21 = c00,
+            c30 = c00, c31 = c00, c40 = c00, c41 = c00, c50 = c00, c51 = c00;
+    for(int k=0;k<kc;k++, ap += GEMM_MR, bp += GEMM_NR){
+        __m256d b0 = _mm256_load_pd(bp), b1 = _mm256_load_pd(bp + 4), a;
+        a = _mm256_broadcast_sd(ap);   c00 = _mm256_fmadd_pd(a, b0, c00); c01 = _mm256_fmadd_pd(a, b1, c01);
+        a = _mm256_broadcast_sd(ap+1); c10 = _mm256_fmadd_pd(a, b0, c10); c11 = _mm256_fmadd_pd(a, b1, c11);
+        a = _mm256_broadcast_sd(ap+2); c20 = _mm256_fmadd_pd(a, b0, c20); c21 = _mm256_fmadd_pd(a, b1, c21);
+        a = _mm256_broadcast_sd(ap+3); c30 = _mm256_fmadd_pd(a, b0, c30); c31 = _mm256_fmadd_pd(a, b1, c31);
+        a = _mm256_broadcast_sd(ap+4); c40 = _mm256_fmadd_pd(a, b0, c40); c41 = _mm256_fmadd_pd(a, b1, c41);
+        a = _mm256_broadcast_sd(ap+5); c50 = _mm256_fmadd_pd(a, b0, c50); c51 = _mm256_fmadd_pd(a, b1, c51);
+    }
+    __m256d acc[GEMM_MR][2] = {{c00,c01},{c10,c11},{c20,c21},{c30,c31},{c40,c41},{c50,c51}};
+    if(mr == GEMM_MR && nr == GEMM_NR){
+        for(int r=0;r<GEMM_MR;r++){
+            double *cr = c + (size_t)r*ldc;
+            _mm256_storeu_pd(cr,     _mm256_add_pd(_mm256_loadu_pd(cr),     acc[r][0]));
+            _mm256_storeu_pd(cr + 4, _mm256_add_pd(_mm256_loadu_pd(cr + 4), acc[r][1]));
+        }
+        return;
+    }
+    double t[GEMM_MR][GEMM_NR];     /* edge tile */
+    for(int r=0;r<GEMM_MR;r++){ _mm256_storeu_pd(t[r], acc[r][0]); _mm256_storeu_pd(t[r] + 4, acc[r][1]); }
+    for(int r=0;r<mr;r++) for(int j=0;j<nr;j++) c[(size_t)r*ldc + j] += t[r][j];
+}
+#endif
+
+void (*gemm_kernel)(int, const double*, const double*, double*, int, int, int);
+
+typedef struct {
+    const Matrix *A, *B;
+    Matrix *C;
+    const double *bpack;
+    int jc, nc, pc, kc;
+    atomic_int failed;      /* a worker could not allocate its packing buffer */
+} GemmCtx;
+
+_Thread_local double *gemm_apack;   /* per-thread MC x KC packing buffer */
+
+/* One MC row block of C for the current (jc, pc) panel. */
+void gemm_block(void *arg, int blk){
+    GemmCtx *g = arg;
+    int ic = blk * GEMM_MC, mc = g->A->rows - ic < GEMM_MC ? g->A->rows - ic : GEMM_MC;
+    if(!gemm_apack) gemm_apack = aligned_malloc(64, GEMM_MC * GEMM_KC * sizeof(double));
+    if(!gemm_apack){ g->failed = 1; return; }
+    int lda = g->A->cols, ldc = g->C->cols;
+    for(int ir=0; ir<mc; ir+=GEMM_MR){         /* pack A into 6-row slivers, zero-padded */
+        double *dst = gemm_apack + (size_t)ir * g->kc;
+        int mr = mc - ir < GEMM_MR ? mc - ir : GEMM_MR;
+        for(int k=0;k<g->kc;k++) for(int r=0;r<GEMM_MR;r++)
+            dst[k*GEMM_MR + r] = r < mr ? g->A->a[(size_t)(ic+ir+r)*lda + g->pc + k] : 0;
+    }
+    for(int jr=0; jr<g->nc; jr+=GEMM_NR){
+        int nr = g->nc - jr < GEMM_NR ? g->nc - jr : GEMM_NR;
+        const double *bp = g->bpack + (size_t)jr * g->kc;
+        for(int ir=0; ir<mc; ir+=GEMM_MR){
+            int mr = mc - ir < GEMM_MR ? mc - ir : GEMM_MR;
+            gemm_kernel(g->kc, gemm_apack + (size_t)ir * g->kc, bp, g->C->a + (size_t)(ic+ir)*ldc + g->jc + jr, ldc, mr, nr);
+        }
+    }
+}
+
+/* C = A * B on up to `threads` threads. */
+int mat_mul(const Matrix *A, const Matrix *B, Matrix *C, int threads){
+    if(A->cols != B->rows || !mat_alloc(C, A->rows, B->cols)) return 0;
+    if(!gemm_kernel){
+        gemm_kernel = gemm_kernel_scalar;
+#ifdef CPG_X86
+        if(cpu_has_avx2()) gemm_kernel = gemm_kernel_avx2;
+#endif
+    }
+    double *bpack = aligned_malloc(64, (size_t)GEMM_KC * (GEMM_NC + GEMM_NR) * sizeof(double));
+    if(!bpack){ mat_free(C); return 0; }
+    GemmCtx g = { A, B, C, bpack, 0, 0, 0, 0, 0 };
+    int ldb = B->cols, nblocks = (A->rows + GEMM_MC - 1) / GEMM_MC;
+    for(g.jc=0; g.jc<B->cols; g.jc+=GEMM_NC){
+        g.nc = B->cols - g.jc < GEMM_NC ? B->cols - g.jc : GEMM_NC;
+        for(g.pc=0; g.pc<A->cols; g.pc+=GEMM_KC){
+            g.kc = A->cols - g.pc < GEMM_KC ? A->cols - g.pc : GEMM_KC;
+            for(int jr=0; jr<g.nc; jr+=GEMM_NR){   /* pack B into 8-column slivers, zero-padded */
+                double *dst = bpack + (size_t)jr * g.kc;
+                int nr = g.nc - jr < GEMM_NR ? g.nc - jr : GEMM_NR;
+                for(int k=0;k<g.kc;k++){
+                    const double *src = B->a + (size_t)(g.pc+k)*ldb + g.jc + jr;
+                    for(int j=0;j<GEMM_NR;j++) dst[k*GEMM_NR + j] = j < nr ? src[j] : 0;
+                }
+            }
+            parallel_for(nblocks, threads, gemm_block, &g);
+            if(g.failed){ aligned_free(bpack); mat_free(C); return 0; }
+        }
+    }
+    aligned_free(bpack);
+    return 1;
+}
+
+/* Textbook triple loop over rows [r0, r1) of C, for comparison. */
+void mat_mul_naive_rows(const Matrix *A, const Matrix *B, Matrix *C, int r0, int r1){
+    int n = A->cols, m = B->cols;
+    for(int i=r0;i<r1;i++) for(int j=0;j<m;j++){
+        double s = 0;
+        for(int k=0;k<n;k++) s += A->a[(size_t)i*n + k] * B->a[(size_t)k*m + j];
+        C->a[(size_t)i*m + j] = s;
+    }
+}
+
+/* In-place LU with partial pivoting: A = P L U, unit L below the diagonal.
+   Returns 0 if A is singular. The trailing update runs on the pool. */
+typedef struct { Matrix *M; int k; } LuCtx;
+
+void lu_update_rows(void *arg, int blk){
+    LuCtx *c = arg;
+    int n = c->M->cols, k = c->k, r0 = k + 1 + blk*32, r1 = r0 + 32 < c->M->rows ? r0 + 32 : c->M->rows;
+    const double *pk = c->M->a + (size_t)k*n;
+    for(int i=r0;i<r1;i++){
+        double *ri = c->M->a + (size_t)i*n;
+        double l = ri[k] /= pk[k];
+        for(int j=k+1;j<n;j++) ri[j] -= l * pk[j];
+    }
+}
+
+int mat_lu(Matrix *M, int *perm, int threads){
+    int n = M->rows;
+    if(M->cols != n) return 0;
+    for(int i=0;i<n;i++) perm[i] = i;
+    for(int k=0;k<n;k++){
+        int p = k;
+        for(int i=k+1;i<n;i++) if(fabs(M->a[(size_t)i*n + k]) > fabs(M->a[(size_t)p*n + k])) p = i;
+        if(M->a[(size_t)p*n + k] == 0) return 0;
+        if(p != k){
+            for(int j=0;j<n;j++){ double t = M->a[(size_t)k*n + j]; M->a[(size_t)k*n + j] = M->a[(size_t)p*n + j]; M->a[(size_t)p*n + j] = t; }
+            int t = perm[k]; perm[k] = perm[p]; perm[p] = t;
+        }
+        LuCtx c = { M, k };
+        int rows = n - k - 1;
+        parallel_for((rows + 31) / 32, (size_t)rows * (n-k) > 65536 ? threads : 1, lu_update_rows, &c);
+    }
+    return 1;
+}
+
+/* Solves LU x = P b for one right-hand side. */
+void mat_lu_solve(const Matrix *LU, const int *perm, const double *b, double *x){
+    int n = LU->rows;
+    for(int i=0;i<n;i++){
+        double s = b[perm[i]];
+        for(int j=0;j<i;j++) s -= LU->a[(size_t)i*n + j] * x[j];
+        x[i] = s;
+    }
+    for(int i=n-1;i>=0;i--){
+        double s = x[i];
+        for(int j=i+1;j<n;j++) s -= LU->a[(size_t)i*n + j] * x[j];
+        x[i] = s / LU->a[(size_t)i*n + i];
+    }
+}
+
+int mat_save(const Matrix *m, const char *path){
+    FILE *f = fopen(path, "wb");
+    if(!f) return 0;
+    uint32_t h[4] = { MAT_MAGIC, 1, (uint32_t)m->rows, (uint32_t)m->cols };
+    size_t cnt = (size_t)m->rows * m->cols;
+    int ok = fwrite(h, sizeof h, 1, f) == 1 && fwrite(m->a, sizeof(double), cnt, f) == cnt;
+    return (fclose(f) == 0) && ok;
+}
+
+int mat_load(Matrix *m, const char *path){
+    FILE *f = fopen(path, "rb");
+    if(!f) return 0;
+    uint32_t h[4];
+    int ok = fread(h, sizeof h, 1, f) == 1 && h[0] == MAT_MAGIC && h[1] == 1 && h[2] && h[3] && h[2] <= 65536 && h[3] <= 65536
+             && mat_alloc(m, (int)h[2], (int)h[3]);
+    if(ok && fread(m->a, sizeof(double), (size_t)h[2]*h[3], f) != (size_t)h[2]*h[3]){ mat_free(m); ok = 0; }
+    fclose(f);
+    return ok;
+}
+
+/* ---------- Calculator ---------- */
+/* Expressions: + - * / % ^, unary minus, parentheses, numbers, the
+   variable x, named calculator variables, pi/e and <math.h> functions.
+   One recursive-descent grammar either evaluates directly (the naive
+   interpreter) or compiles to stack bytecode; compiled programs evaluate a
+   range of x in batches of EXPR_BATCH values, one op at a time over the
+   whole batch, with AVX2 kernels for the arithmetic. */
+#define EXPR_MAX_OPS 256
+#define EXPR_MAX_VARS 32
+#define EXPR_BATCH 256
+
+enum { OP_CONST, OP_X, OP_ADD, OP_SUB, OP_MUL, OP_DIV, OP_MOD, OP_POW, OP_NEG, OP_FN1, OP_FN2 };
+enum { FN_SIN, FN_COS, FN_TAN, FN_ASIN, FN_ACOS, FN_ATAN, FN_SINH, FN_COSH, FN_TANH, FN_EXP,
+       FN_LOG, FN_LOG10, FN_LOG2, FN_SQRT, FN_CBRT, FN_ABS, FN_FLOOR, FN_CEIL, FN_ROUND,
+       FN_POW, FN_ATAN2, FN_FMOD, FN_HYPOT, FN_MIN, FN_MAX };
+
+typedef struct { const char *name; int id, args; } ExprFn;
+const ExprFn expr_fns[] = {
+    {"sin",FN_SIN,1},{"cos",FN_COS,1},{"tan",FN_TAN,1},{"asin",FN_ASIN,1},{"acos",FN_ACOS,1},
+    {"atan",FN_ATAN,1},{"sinh",FN_SINH,1},{"cosh",FN_COSH,1},{"tanh",FN_TANH,1},{"exp",FN_EXP,1},
+    {"log",FN_LOG,1},{"ln",FN_LOG,1},{"log10",FN_LOG10,1},{"log2",FN_LOG2,1},{"sqrt",FN_SQRT,1},
+    {"cbrt",FN_CBRT,1},{"abs",FN_ABS,1},{"floor",FN_FLOOR,1},{"ceil",FN_CEIL,1},{"round",FN_ROUND,1},
+    {"pow",FN_POW,2},{"atan2",FN_ATAN2,2},{"fmod",FN_FMOD,2},{"hypot",FN_HYPOT,2},{"min",FN_MIN,2},
+    {"max",FN_MAX,2}
+};
+
+typedef struct {
+    int n;
+    char names[EXPR_MAX_VARS][16];
+    double values[EXPR_MAX_VARS];
+} ExprVars;
+
+typedef struct { uint8_t op, arg; } ExprOp;
+
+typedef struct {
+    ExprOp ops[EXPR_MAX_OPS];
+    double consts[EXPR_MAX_OPS];
+    int nops, nconsts, max_depth;
+} ExprProg;
+
+typedef struct {
+    const char *p;
+    const ExprVars *vars;
+    ExprProg *prog;         /* NULL: evaluate directly */
+    double x;
+    int depth;
+    int calc;               /* calculator: x is undefined, dividing by zero is an error */
+    char err[64];
+} ExprParser;
+
+double expr_fn1(int id, double a){
+    switch(id){
+    case FN_SIN: return sin(a);     case FN_COS: return cos(a);     case FN_TAN: return tan(a);
+    case FN_ASIN: return asin(a);   case FN_ACOS: return acos(a);   case FN_ATAN: return atan(a);
+    case FN_SINH: return sinh(a);   case FN_COSH: return cosh(a);   case FN_TANH: return tanh(a);
+    case FN_EXP: return exp(a);     case FN_LOG: return log(a);     case FN_LOG10: return log10(a);
+    case FN_LOG2: return log2(a);   case FN_SQRT: return sqrt(a);   case FN_CBRT: return cbrt(a);
+    case FN_ABS: return fabs(a);    case FN_FLOOR: return floor(a); case FN_CEIL: return ceil(a);
+    default: return round(a);
+    }
+}
+
+double expr_fn2(int id, double a, double b){
+    switch(id){
+    case FN_POW: return pow(a, b);   case FN_ATAN2: return atan2(a, b);
+    case FN_FMOD: return fmod(a, b); case FN_HYPOT: return hypot(a, b);
+    case FN_MIN: return a < b ? a : b;
+    default: return a > b ? a : b;
+    }
+}
+
+double expr_binop(int op, double a, double b){
+    switch(op){
+    case OP_ADD: return a + b; case OP_SUB: return a - b;
+    case OP_MUL: return a * b; case OP_DIV: return a / b;
+    case OP_MOD: return fmod(a, b);
+    default: return pow(a, b);
+    }
+}
+
+void expr_emit(ExprParser *ps, int op, int arg, int delta){
+    ExprProg *pr = ps->prog;
+    if(!pr || ps->err[0]) return;
+    if(pr->nops >= EXPR_MAX_OPS){ snprintf(ps->err, sizeof ps->err, "expression too long"); return; }
+    pr->ops[pr->nops].op = (uint8_t)op; pr->ops[pr->nops].arg = (uint8_t)arg; pr->nops++;
+    ps->depth += delta;
+    if(ps->depth > pr->max_depth) pr->max_depth = ps->depth;
+}
+
+void expr_emit_const(ExprParser *ps, double v){
+    if(!ps->prog) return;
+    if(ps->prog->nconsts >= EXPR_MAX_OPS){ snprintf(ps->err, sizeof ps->err, "expression too long"); return; }
+    ps->prog->consts[ps->prog->nconsts] = v;
+    expr_emit(ps, OP_CONST, ps->prog->nconsts++, 1);
+}
+
+void expr_skip(ExprParser *ps){ while(*ps->p == ' ' || *ps->p == '\t') ps->p++; }
+
+int expr_accept(ExprParser *ps, char c){
+    expr_skip(ps);
+    if(*ps->p != c) return 0;
+    ps->p++;
+    return 1;
+}
+
+double expr_expr(ExprParser *ps);
+double expr_unary(ExprParser *ps);
+
+double expr_primary(ExprParser *ps){
+    expr_skip(ps);
+    const char *s = ps->p;
+    if(expr_accept(ps, '(')){
+        double v = expr_expr(ps);
+        if(!expr_accept(ps, ')') && !ps->err[0]) snprintf(ps->err, sizeof ps->err, "missing ')'");
+        return v;
+    }
+    if((*s >= '0' && *s <= '9') || *s == '.'){
+        char *end;
+        double v = strtod(s, &end);
+        ps->p = end;
+        expr_emit_const(ps, v);
+        return v;
+    }
+    if((*s >= 'a' && *s <= 'z') || (*s >= 'A' && *s <= 'Z') || *s == '_'){
+        char name[16]; int n = 0;
+        while((*ps->p >= 'a' && *ps->p <= 'z') || (*ps->p >= 'A' && *ps->p <= 'Z') || *ps->p == '_' || (*ps->p >= '0' && *ps->p <= '9')){
+            if(n < 15) name[n++] = *ps->p;
+            ps->p++;
+        }
+        name[n] = '\0';
+        if(expr_accept(ps, '(')){
+            for(size_t i=0;i<sizeof expr_fns/sizeof expr_fns[0];i++){
+                if(strcmp(name, expr_fns[i].name) != 0) continue;
+                double a = expr_expr(ps), b = 0;
+                if(expr_fns[i].args == 2){
+                    if(!expr_accept(ps, ',')){ if(!ps->err[0]) snprintf(ps->err, sizeof ps->err, "%s takes 2 arguments", name); return 0; }
+                    b = expr_expr(ps);
+                }
+                if(!expr_accept(ps, ')') && !ps->err[0]) snprintf(ps->err, sizeof ps->err, "missing ')' after %s", name);
+                if(expr_fns[i].args == 2){ expr_emit(ps, OP_FN2, expr_fns[i].id, -1); return expr_fn2(expr_fns[i].id, a, b); }
+                expr_emit(ps, OP_FN1, expr_fns[i].id, 0);
+                return expr_fn1(expr_fns[i].id, a);
+            }
+            snprintf(ps->err, sizeof ps->err, "unknown function %s", name);
+            return 0;
+        }
+        if(strcmp(name, "x") == 0 && !ps->calc){ expr_emit(ps, OP_X, 0, 1); return ps->x; }
+        double v;
+        if(strcmp(name, "pi") == 0) v = 3.14159265358979323846;
+        else if(strcmp(name, "e") == 0) v = 2.71828182845904523536;
+        else {
+            int i = 0;
+            while(ps->vars && i < ps->vars->n && strcmp(ps->vars->names[i], name) != 0) i++;
+            if(!ps->vars || i == ps->vars->n){ snprintf(ps->err, sizeof ps->err, "unknown variable %s", name); return 0; }
+            v = ps->vars->values[i];   /* bound when the expression is compiled */
+        }
+        expr_emit_const(ps, v);
+        return v;
+    }
+    if(!ps->err[0]) snprintf(ps->err, sizeof ps->err, *s ? "unexpected '%c'" : "unexpected end", *s);
+    return 0;
+}
+
+double expr_power(ExprParser *ps){
+    double v = expr_primary(ps);
+    if(expr_accept(ps, '^')){               /* right associative, binds tighter than unary minus on its left */
+        double r = expr_unary(ps);
+        expr_emit(ps, OP_POW, 0, -1);
+        v = pow(v, r);
+    }
+    return v;
+}
+
+double expr_unary(ExprParser *ps){
+    if(expr_accept(ps, '-')){ double v = expr_unary(ps); expr_emit(ps, OP_NEG, 0, 0); return -v; }
+    if(expr_accept(ps, '+')) return expr_unary(ps);
+    return expr_power(ps);
+}
+
+double expr_term(ExprParser *ps){
+    double v = expr_unary(ps);
+    for(;;){
+        int op = expr_accept(ps, '*') ? OP_MUL : expr_accept(ps, '/') ? OP_DIV : expr_accept(ps, '%') ? OP_MOD : -1;
+        if(op < 0 || ps->err[0]) return v;
+        double r = expr_unary(ps);
+        if(ps->calc && op != OP_MUL && r == 0 && !ps->err[0]){ snprintf(ps->err, sizeof ps->err, "divide by zero"); return 0; }
+        expr_emit(ps, op, 0, -1);
+        v = expr_binop(op, v, r);
+    }
+}
+
+double expr_expr(ExprParser *ps){
+    double v = expr_term(ps);
+    for(;;){
+        int op = expr_accept(ps, '+') ? OP_ADD : expr_accept(ps, '-') ? OP_SUB : -1;
+        if(op < 0 || ps->err[0]) return v;
+        double r = expr_term(ps);
+        expr_emit(ps, op, 0, -1);
+        v = expr_binop(op, v, r);
+    }
+}
+
+/* Naive interpreter: parses and evaluates src at x in one pass. */
+double expr_eval_naive(const char *src, const ExprVars *vars, double x, char *err, size_t errlen){
+    ExprParser ps;
+    memset(&ps, 0, sizeof ps);
+    ps.p = src; ps.vars = vars; ps.x = x;
+    double v = expr_expr(&ps);
+    expr_skip(&ps);
+    if(!ps.err[0] && *ps.p) snprintf(ps.err, sizeof ps.err, "unexpected '%c'", *ps.p);
+    if(err) snprintf(err, errlen, "%s", ps.err);
+    return v;
+}
+
+/* Calculator evaluation: as above, but x and other unknown names are
+   errors, and so is dividing by zero (err is then "divide by zero"). */
+double expr_eval_calc(const char *src, const ExprVars *vars, char *err, size_t errlen){
+    ExprParser ps;
+    memset(&ps, 0, sizeof ps);
+    ps.p = src; ps.vars = vars; ps.calc = 1;
+    double v = expr_expr(&ps);
+    expr_skip(&ps);
+    if(!ps.err[0] && *ps.p) snprintf(ps.err, sizeof ps.err, "unexpected '%c'", *ps.p);
+    snprintf(err, errlen, "%s", ps.err);
+    return v;
+}
+
+/* Compiles src once; returns 0 and sets err on a syntax error. */
+int expr_compile(const char *src, const ExprVars *vars, ExprProg *prog, char *err, size_t errlen){
+    ExprParser ps;
+    memset(&ps, 0, sizeof ps);
+    memset(prog, 0, sizeof *prog);
+    ps.p = src; ps.vars = vars; ps.prog = prog;
+    expr_expr(&ps);
+    expr_skip(&ps);
+    if(!ps.err[0] && *ps.p) snprintf(ps.err, sizeof ps.err, "unexpected '%c'", *ps.p);
+    if(err) snprintf(err, errlen, "%s", ps.err);
+    return !ps.err[0];
+}
+
+/* Scalar bytecode evaluation at one x. */
+double expr_run(const ExprProg *pr, double x){
+    double st[EXPR_MAX_OPS];
+    int sp = 0;
+    for(int i=0;i<pr->nops;i++){
+        ExprOp o = pr->ops[i];
+        switch(o.op){
+        case OP_CONST: st[sp++] = pr->consts[o.arg]; break;
+        case OP_X: st[sp++] = x; break;
+        case OP_NEG: st[sp-1] = -st[sp-1]; break;
+        case OP_FN1: st[sp-1] = expr_fn1(o.arg, st[sp-1]); break;
+        case OP_FN2: sp--; st[sp-1] = expr_fn2(o.arg, st[sp-1], st[sp]); break;
+        default: sp--; st[sp-1] = expr_binop(o.op, st[sp-1], st[sp]); break;
+        }
+    }
+    return sp ? st[0] : 0;
+}
+
+/* Batch kernels: one op over n lanes. The AVX2 versions cover the ops that
+   map to single instructions; everything else goes through libm per lane. */
+void expr_batch_scalar(int op, int arg, double *a, const double *b, int n){
+    switch(op){
+    case OP_ADD: for(int i=0;i<n;i++) a[i] += b[i]; break;
+    case OP_SUB: for(int i=0;i<n;i++) a[i] -= b[i]; break;
+    case OP_MUL: for(int i=0;i<n;i++) a[i] *= b[i]; break;
+    case OP_DIV: for(int i=0;i<n;i++) a[i] /= b[i]; break;
+    case OP_NEG: for(int i=0;i<n;i++) a[i] = -a[i]; break;
+    case OP_FN1: for(int i=0;i<n;i++) a[i] = expr_fn1(arg, a[i]); break;
+    case OP_FN2: for(int i=0;i<n;i++) a[i] = expr_fn2(arg, a[i], b[i]); break;
+    default: for(int i=0;i<n;i++) a[i] = expr_binop(op, a[i], b[i]); break;
+    }
+}
+
+#ifdef CPG_X86
+__attribute__((target("avx2")))
+void expr_batch_avx2(int op, int arg, double *a, const double *b, int n){
+    int i = 0;
+    /* unary ops are called with b == a */
+    #define EXPR_LOOP(expr) for( ; i+4<=n; i+=4){ __m256d va = _mm256_loadu_pd(a+i), vb = _mm256_loadu_pd(b+i); (void)vb; _mm256_storeu_pd(a+i, expr); } break
+    switch(op){
+    case OP_ADD: EXPR_LOOP(_mm256_add_pd(va, vb));
+    case OP_SUB: EXPR_LOOP(_mm256_sub_pd(va, vb));
+    case OP_MUL: EXPR_LOOP(_mm256_mul_pd(va, vb));
+    case OP_DIV: EXPR_LOOP(_mm256_div_pd(va, vb));
+    case OP_NEG: EXPR_LOOP(_mm256_xor_pd(va, _mm256_set1_pd(-0.0)));
+    case OP_FN1:
+        if(arg == FN_SQRT){ EXPR_LOOP(_mm256_sqrt_pd(va)); }
+        if(arg == FN_ABS){ EXPR_LOOP(_mm256_andnot_pd(_mm256_set1_pd(-0.0), va)); }
+        if(arg == FN_FLOOR){ EXPR_LOOP(_mm256_floor_pd(va)); }
+        if(arg == FN_CEIL){ EXPR_LOOP(_mm256_ceil_pd(va)); }
+        break;
+    case OP_FN2:
+        if(arg == FN_MIN){ EXPR_LOOP(_mm256_min_pd(va, vb)); }
+        if(arg == FN_MAX){ EXPR_LOOP(_mm256_max_pd(va, vb)); }
+        break;
+    }
+    #undef EXPR_LOOP
+    if(i < n) expr_batch_scalar(op, arg, a+i, b+i, n-i);
+}
+#endif
+
+void (*expr_batch_op)(int op, int arg, double *a, const double *b, int n);
+
+/* Evaluates the program at x0 + i*step for i in [0, n) into out; returns 0
+   if the evaluation stack cannot be allocated. */
+int expr_eval_range(const ExprProg *pr, double x0, double step, size_t n, double *out){
+    if(!expr_batch_op){
+        expr_batch_op = expr_batch_scalar;
+#ifdef CPG_X86
+        if(cpu_has_avx2()) expr_batch_op = expr_batch_avx2;
+#endif
+    }
+    int depth = pr->max_depth > 0 ? pr->max_depth : 1;
+    double *st = malloc((size_t)depth * EXPR_BATCH * sizeof(double));
+    if(!st) return 0;
+    for(size_t base=0; base<n; base+=EXPR_BATCH){
+        int w = n-base < EXPR_BATCH ? (int)(n-base) : EXPR_BATCH, sp = 0;
+        for(int i=0;i<pr->nops;i++){
+            ExprOp o = pr->ops[i];
+            double *top = st + (size_t)sp*EXPR_BATCH;
+            if(o.op == OP_CONST){ double c = pr->consts[o.arg]; for(int j=0;j<w;j++) top[j] = c; sp++; }
+            else if(o.op == OP_X){ for(int j=0;j<w;j++) top[j] = x0 + (double)(base+j)*step; sp++; }
+            else if(o.op == OP_NEG || o.op == OP_FN1) expr_batch_op(o.op, o.arg, top - EXPR_BATCH, top - EXPR_BATCH, w);
+            else { sp--; expr_batch_op(o.op, o.arg, top - 2*EXPR_BATCH, top - EXPR_BATCH, w); }
+        }
+        if(sp) memcpy(out + base, st, w * sizeof(double));
+        else memset(out + base, 0, w * sizeof(double));
+    }
+    free(st);
+    return 1;
+}
+
+_Thread_local ExprVars calc_vars;   /* persists across calculator uses within a login */
+
+void calc_basic(void){
+    char buf[256], err[64];
+    if(!read_line("Enter expression or name = expression (e.g. 2 + 3*sin(pi/4)): ", buf, sizeof buf)) return;
+    char *eq = strchr(buf, '='), *expr = buf, name[16] = "";
+    if(eq){
+        if(sscanf(buf, " %15[A-Za-z_0-9] =", name) != 1 || strcmp(name, "x") == 0 || (name[0] >= '0' && name[0] <= '9')){ uprintf("Invalid variable name.\n"); return; }
+        expr = eq + 1;
+    }
+    double v = expr_eval_calc(expr, &calc_vars, err, sizeof err);
+    if(strcmp(err, "divide by zero") == 0){ uprintf("Divide by zero.\n"); return; }
+    if(err[0]){ uprintf("Error: %s\n", err); return; }
+    uprintf("= %.10g\n", v);
+    if(name[0]){
+        int i = 0;
+        while(i < calc_vars.n && strcmp(calc_vars.names[i], name) != 0) i++;
+        if(i == EXPR_MAX_VARS){ uprintf("Too many variables.\n"); return; }
+        if(i == calc_vars.n){ strcpy(calc_vars.names[i], name); calc_vars.n++; }
+        calc_vars.values[i] = v;
+    }
+}
+
+/* Tabulates f(x) over a range with the compiled evaluator. */
+void calc_tabulate(void){
+    char buf[256], err[64];
+    ExprProg prog;
+    if(!read_line("f(x) = ", buf, sizeof buf)) return;
+    if(!expr_compile(buf, &calc_vars, &prog, err, sizeof err)){ uprintf("Error: %s\n", err); return; }
+    double x0, x1; long n;
+    if(!read_line("x from, to, points (e.g. 0 10 11): ", buf, sizeof buf)) return;
+    if(sscanf(buf, "%lf %lf %ld", &x0, &x1, &n) != 3 || n < 1 || n > 100000000){ uprintf("Invalid.\n"); return; }
+    double step = n > 1 ? (x1 - x0) / (n - 1) : 0;
+    double *out = malloc((size_t)n * sizeof(double));
+    if(!out){ uprintf("Not enough memory.\n"); return; }
+    double t0 = now_sec();
+    if(!expr_eval_range(&prog, x0, step, (size_t)n, out)){ uprintf("Not enough memory.\n"); free(out); return; }
+    double t = now_sec() - t0;
+    long shown = n <= 20 ? n : 11;
+    for(long k=0;k<shown;k++){
+        long i = n <= 20 ? k : (long)((double)k * (n-1) / (shown-1));
+        uprintf("%16.8g  %16.10g\n", x0 + i*step, out[i]);
+    }
+    double lo = out[0], hi = out[0];
+    for(long i=1;i<n;i++){ if(out[i] < lo) lo = out[i]; if(out[i] > hi) hi = out[i]; }
+    uprintf("%ld points: min %.10g, max %.10g, %.3f ms (%.1f M evals/s)\n", n, lo, hi, t*1e3, n / (t > 0 ? t : 1e-9) / 1e6);
+    free(out);
+}
+
+/* Quadratics. Roots use the cancellation-free form q = -(b + sign(b) sqrt(D)) / 2,
+   x1 = q/a, x2 = c/q, so a small root next to a large one keeps its digits.
+   Coefficients beyond 2^+-500 are first scaled by a power of two (exact, the
+   roots do not change) so b*b and 4ac cannot overflow or underflow.
+   a = 0 degrades to the linear case; D < 0 gives re +- im i. Roots are
+   returned without negative zeros. Batch mode
+   streams "a b c" rows (spaces, tabs or commas) through 1 MB read and write
+   buffers and solves QUAD_CHUNK rows at a time, so memory use does not
+   depend on the input size. Blank lines and # comments produce no output. */
+#define QUAD_CHUNK 4096
+#define QUAD_IOBUF (1 << 20)
+
+enum { QUAD_REAL, QUAD_DOUBLE, QUAD_COMPLEX, QUAD_LINEAR, QUAD_NONE, QUAD_ALL, QUAD_INVALID };
+
+typedef struct { long long rows, kinds[QUAD_INVALID + 1]; } QuadStats;
+
+/* Real roots come back as r1 <= r2; complex ones as r1 = re, r2 = im > 0. */
+int quad_solve(double a, double b, double c, double *r1, double *r2){
+    if(a == 0){
+        if(b == 0){ *r1 = *r2 = NAN; return c == 0 ? QUAD_ALL : QUAD_NONE; }
+        *r1 = *r2 = -c / b + 0.0;
+        return QUAD_LINEAR;
+    }
+    double m = fmax(fabs(a), fmax(fabs(b), fabs(c)));
+    if(m > 0x1p500 || m < 0x1p-500){
+        int e;
+        frexp(m, &e);
+        a = ldexp(a, 1-e); b = ldexp(b, 1-e); c = ldexp(c, 1-e);
+    }
+    double D = b*b - 4*a*c;
+    if(D < 0){ *r1 = -b / (2*a) + 0.0; *r2 = sqrt(-D) / fabs(2*a); return QUAD_COMPLEX; }
+    double q = -0.5 * (b + copysign(sqrt(D), b));
+    if(q == 0){ *r1 = *r2 = 0; return QUAD_DOUBLE; }
+    double x1 = q / a + 0.0, x2 = c / q + 0.0;
+    *r1 = x1 < x2 ? x1 : x2; *r2 = x1 < x2 ? x2 : x1;
+    return D == 0 ? QUAD_DOUBLE : QUAD_REAL;
+}
+
+void quad_batch_scalar(const double *a, const double *b, const double *c, int n, double *r1, double *r2, unsigned char *kind){
+    for(int i=0;i<n;i++) kind[i] = quad_solve(a[i], b[i], c[i], r1+i, r2+i);
+}
+
+#ifdef CPG_X86
+/* Same arithmetic as quad_solve four rows at a time; lanes with a = 0,
+   q = 0 or subnormal coefficients are redone by quad_solve. The power of
+   two used for scaling is the exponent field of max(|a|, |b|, |c|). */
+__attribute__((target("avx2")))
+void quad_batch_avx2(const double *a, const double *b, const double *c, int n, double *r1, double *r2, unsigned char *kind){
+    const __m256d zero = _mm256_setzero_pd(), sign = _mm256_set1_pd(-0.0), half = _mm256_set1_pd(-0.5),
+                  one = _mm256_set1_pd(1), two = _mm256_set1_pd(2), four = _mm256_set1_pd(4),
+                  hi_lim = _mm256_set1_pd(0x1p500), lo_lim = _mm256_set1_pd(0x1p-500), tiny = _mm256_set1_pd(DBL_MIN),
+                  expo = _mm256_castsi256_pd(_mm256_set1_epi64x(0x7FF0000000000000LL));
+    int i = 0;
+    for(; i + 4 <= n; i += 4){
+        __m256d a0 = _mm256_loadu_pd(a+i), vb = _mm256_loadu_pd(b+i), vc = _mm256_loadu_pd(c+i);
+        __m256d m = _mm256_max_pd(_mm256_andnot_pd(sign, a0), _mm256_max_pd(_mm256_andnot_pd(sign, vb), _mm256_andnot_pd(sign, vc)));
+        __m256d ext = _mm256_or_pd(_mm256_cmp_pd(m, hi_lim, _CMP_GT_OQ), _mm256_cmp_pd(m, lo_lim, _CMP_LT_OQ));
+        __m256d scale = _mm256_blendv_pd(one, _mm256_div_pd(one, _mm256_and_pd(m, expo)), ext);
+        __m256d va = _mm256_mul_pd(a0, scale);
+        vb = _mm256_mul_pd(vb, scale); vc = _mm256_mul_pd(vc, scale);
+        __m256d D = _mm256_sub_pd(_mm256_mul_pd(vb, vb), _mm256_mul_pd(_mm256_mul_pd(four, va), vc));
+        __m256d neg = _mm256_cmp_pd(D, zero, _CMP_LT_OQ);
+        __m256d sd = _mm256_sqrt_pd(_mm256_andnot_pd(sign, D));
+        __m256d q = _mm256_mul_pd(half, _mm256_add_pd(vb, _mm256_or_pd(sd, _mm256_and_pd(sign, vb))));
+        __m256d x1 = _mm256_add_pd(_mm256_div_pd(q, va), zero), x2 = _mm256_add_pd(_mm256_div_pd(vc, q), zero);
+        __m256d lt = _mm256_cmp_pd(x1, x2, _CMP_LT_OQ);
+        __m256d lo = _mm256_blendv_pd(x2, x1, lt), hi = _mm256_blendv_pd(x1, x2, lt);
+        __m256d twoa = _mm256_mul_pd(two, va);
+        __m256d re = _mm256_add_pd(_mm256_div_pd(_mm256_xor_pd(vb, sign), twoa), zero), im = _mm256_div_pd(sd, _mm256_andnot_pd(sign, twoa));
+        _mm256_storeu_pd(r1+i, _mm256_blendv_pd(lo, re, neg));
+        _mm256_storeu_pd(r2+i, _mm256_blendv_pd(hi, im, neg));
+        int mneg = _mm256_movemask_pd(neg), mdbl = _mm256_movemask_pd(_mm256_cmp_pd(D, zero, _CMP_EQ_OQ));
+        int fix = _mm256_movemask_pd(_mm256_or_pd(_mm256_or_pd(_mm256_cmp_pd(a0, zero, _CMP_EQ_OQ), _mm256_cmp_pd(q, zero, _CMP_EQ_OQ)),
+                                                  _mm256_cmp_pd(m, tiny, _CMP_LT_OQ)));
+        for(int k=0;k<4;k++){
+            kind[i+k] = mneg>>k & 1 ? QUAD_COMPLEX : mdbl>>k & 1 ? QUAD_DOUBLE : QUAD_REAL;
+            if(fix>>k & 1) kind[i+k] = quad_solve(a[i+k], b[i+k], c[i+k], r1+i+k, r2+i+k);
+        }
+    }
+    for(; i<n; i++) kind[i] = quad_solve(a[i], b[i], c[i], r1+i, r2+i);
+}
+#endif
+
+void (*quad_batch)(const double*, const double*, const double*, int, double*, double*, unsigned char*);
+
+void quad_init(void){
+    if(quad_batch) return;
+    quad_batch = quad_batch_scalar;
+#ifdef CPG_X86
+    if(cpu_has_avx2()) quad_batch = quad_batch_avx2;
+#endif
+}
+
+int quad_format(char *out, int kind, double r1, double r2){
+    char *p = out;
+    const char *s = "\n";
+    switch(kind){
+    case QUAD_REAL:    p += fmt_g15(p, r1); *p++ = ' '; p += fmt_g15(p, r2); break;
+    case QUAD_DOUBLE:  p += fmt_g15(p, r1); s = " (double)\n"; break;
+    case QUAD_COMPLEX:
+        for(int k=0;k<2;k++){ if(k) *p++ = ' '; p += fmt_g15(p, r1); *p++ = k ? '-' : '+'; p += fmt_g15(p, r2); *p++ = 'i'; }
+        break;
+    case QUAD_LINEAR:  p += fmt_g15(p, r1); s = " (linear)\n"; break;
+    case QUAD_NONE:    s = "no solution\n"; break;
+    case QUAD_ALL:     s = "any x\n"; break;
+    default:           s = "invalid\n";
+    }
+    size_t n = strlen(s);
+    memcpy(p, s, n + 1);
+    return (int)(p - out + n);
+}
+
+/* Parses "a b c"; returns 0 for blank/comment lines, -1 for malformed ones
+   and for coefficients that are not finite. */
+int quad_parse(char *s, double v[3]){
+    while(*s==' ' || *s=='\t' || *s=='\r') s++;
+    if(*s == 0 || *s == '#') return 0;
+    for(int k=0;k<3;k++){
+        while(*s==' ' || *s=='\t' || *s==',') s++;
+        char *end; v[k] = parse_double(s, &end);
+        if(end == s || !isfinite(v[k])) return -1;
+        s = end;
+    }
+    while(*s==' ' || *s=='\t' || *s=='\r') s++;
+    return *s == 0 || *s == '#' ? 1 : -1;
+}
+
+/* Solves every row of `in`, one output line per row. Returns 0 on write errors. */
+int quad_stream(FILE *in, FILE *out, QuadStats *st){
+    quad_init();
+    memset(st, 0, sizeof *st);
+    LineReader rd;
+    OutBuf ob;
+    int ok = line_reader_init(&rd, in, QUAD_IOBUF, 0) & outbuf_init(&ob, out, QUAD_IOBUF);
+    double *v = malloc(5 * QUAD_CHUNK * sizeof(double));
+    unsigned char *kind = malloc(QUAD_CHUNK), *bad = malloc(QUAD_CHUNK);
+    ok = ok && v && kind && bad;
+    double *a = v, *b = v + QUAD_CHUNK, *c = v + 2*QUAD_CHUNK, *r1 = v + 3*QUAD_CHUNK, *r2 = v + 4*QUAD_CHUNK;
+    char *line = NULL;
+    while(ok){
+        int n = 0;
+        while(n < QUAD_CHUNK && (line = line_next(&rd))){
+            double t[3];
+            int p = quad_parse(line, t);
+            if(p == 0) continue;
+            bad[n] = p < 0;
+            a[n] = p < 0 ? 0 : t[0]; b[n] = p < 0 ? 0 : t[1]; c[n] = p < 0 ? 0 : t[2];
+            n++;
+        }
+        if(n == 0) break;
+        quad_batch(a, b, c, n, r1, r2, kind);
+        for(int i=0;i<n;i++){
+            int k = bad[i] ? QUAD_INVALID : kind[i];
+            st->kinds[k]++;
+            char *p = outbuf_reserve(&ob, 128);
+            ob.len += quad_format(p, k, r1[i], r2[i]);
+        }
+        st->rows += n;
+        if(!line) break;
+    }
+    if(ob.buf) ok = outbuf_close(&ob) && ok;
+    line_reader_free(&rd); free(v); free(kind); free(bad);
+    return ok;
+}
+
+void quad_print_stats(FILE *f, const QuadStats *st, double secs){
+    fprintf(f, "%lld rows in %.3f s (%.2f M rows/s): %lld two real, %lld double, %lld complex, %lld linear, %lld none, %lld any, %lld invalid\n",
+            st->rows, secs, st->rows / (secs > 0 ? secs : 1e-9) / 1e6, st->kinds[QUAD_REAL], st->kinds[QUAD_DOUBLE],
+            st->kinds[QUAD_COMPLEX], st->kinds[QUAD_LINEAR], st->kinds[QUAD_NONE], st->kinds[QUAD_ALL], st->kinds[QUAD_INVALID]);
+}
+
+/* --quadratic [in|-] [out|-]: batch mode for scripts. */
+int quad_main(const char *in_path, const char *out_path){
+    FILE *in = strcmp(in_path, "-") ? fopen(in_path, "r") : stdin;
+    if(!in){ perror(in_path); return 1; }
+    FILE *out = strcmp(out_path, "-") ? fopen(out_path, "w") : stdout;
+    if(!out){ perror(out_path); if(in != stdin) fclose(in); return 1; }
+    QuadStats st;
+    double t0 = now_sec();
+    int ok = quad_stream(in, out, &st);
+    quad_print_stats(stderr, &st, now_sec() - t0);
+    if(in != stdin) fclose(in);
+    if(out != stdout && fclose(out) != 0) ok = 0;
+    if(!ok) fprintf(stderr, "Write error on %s\n", out_path);
+    return ok ? 0 : 1;
+}
+
+/* Calculator files live in data/files/ and are named by a plain basename,
+   so a session (local or --serve) cannot read or overwrite anything else,
+   users.db included. Returns 0 for an unacceptable name. */
+#define CALC_FILES_DIR DATA_DIR "/files"
+
+int calc_file_path(const char *name, char *out, size_t n){
+    size_t len = strlen(name);
+    if(len == 0 || len > 64 || name[0] == '.') return 0;
+    for(size_t i=0;i<len;i++){
+        char c = name[i];
+        if(!((c>='a'&&c<='z') || (c>='A'&&c<='Z') || (c>='0'&&c<='9') || c=='.' || c=='_' || c=='-')) return 0;
+    }
+    struct stat st;
+    ensure_data_dir();
+    if(stat(CALC_FILES_DIR, &st) != 0) MKDIR(CALC_FILES_DIR);
+    snprintf(out, n, "%s/%s", CALC_FILES_DIR, name);
+    return 1;
+}
+
+void calc_quadratic(void){
+    char buf[256], line[160], path[128]; double v[3];
+    if(!read_line("Enter a b c (ax^2 + bx + c), or a file in " CALC_FILES_DIR "/ of 'a b c' rows: ", buf, sizeof buf)) return;
+    int p = quad_parse(buf, v);
+    if(p > 0){
+        double r1, r2;
+        int kind = quad_solve(v[0], v[1], v[2], &r1, &r2);
+        quad_format(line, kind, r1, r2);
+        uprintf("Roots: %s", line);
+        return;
+    }
+    FILE *in = calc_file_path(buf, path, sizeof path) ? fopen(path, "r") : NULL;
+    if(!in){ uprintf("Invalid.\n"); return; }
+    if(!read_line("Output file in " CALC_FILES_DIR "/ (blank = screen): ", line, sizeof line)){ fclose(in); return; }
+    FILE *out = out_stream();
+    if(line[0]){
+        out = calc_file_path(line, path, sizeof path) ? fopen(path, "w") : NULL;
+        if(!out){ uprintf("Cannot write %s (use a plain file name).\n", line); fclose(in); return; }
+    }
+    QuadStats st;
+    double t0 = now_sec();
+    int ok = quad_stream(in, out, &st);
+    double t = now_sec() - t0;
+    fclose(in);
+    if(out != out_stream() && fclose(out) != 0) ok = 0;
+    if(!ok) uprintf("Write error.\n");
+    quad_print_stats(out_stream(), &st, t);
+}
+
+_Thread_local Matrix calc_ma, calc_mb;
+
+void mat_print(const char *name, const Matrix *m){
+    uprintf("%s (%dx%d)%s\n", name, m->rows, m->cols, m->rows > 8 || m->cols > 8 ? ", top-left 8x8:" : ":");
+    for(int i=0;i<m->rows && i<8;i++){
+        for(int j=0;j<m->cols && j<8;j++) uprintf("%10.4g ", m->a[(size_t)i*m->cols + j]);
+        uprintf(m->cols > 8 ? "...\n" : "\n");
+    }
+}
+
+int mat_read(Matrix *m, const char *name){
+    char buf[1024]; int r, c;
+    uprintf("%s size (rows cols): ", name);
+    if(!read_line("", buf, sizeof buf)) return 0;
+    if(sscanf(buf, "%d %d", &r, &c)!=2 || r<1 || c<1 || r>16 || c>16){ uprintf("Use 1..16 (larger: random or load).\n"); return 0; }
+    Matrix t;
+    if(!mat_alloc(&t, r, c)) return 0;
+    for(int i=0;i<r;i++){
+        uprintf("Row %d: ", i+1);
+        if(!read_line("", buf, sizeof buf)){ mat_free(&t); return 0; }
+        char *p = buf;
+        for(int j=0;j<c;j++){
+            char *end; t.a[(size_t)i*c + j] = strtod(p, &end);
+            if(end == p){ uprintf("Invalid.\n"); mat_free(&t); return 0; }
+            p = end;
+        }
+    }
+    mat_free(m); *m = t;
+    return 1;
+}
+
+void calc_matrix(void){
+    char buf[256];
+    int threads = cpu_count();
+    while(1){
+        uprintf("\n--- Matrices (A %dx%d, B %dx%d) ---\n"
+                "1) Enter A\n2) Enter B\n3) Random A and B (N x N)\n4) Load A from file\n5) Save A to file\n"
+                "6) A + B\n7) A * B\n8) Transpose A\n9) Solve A x = b (random b)\n10) det A\n0) Back\nChoose: ",
+                calc_ma.rows, calc_ma.cols, calc_mb.rows, calc_mb.cols);
+        if(!read_line("", buf, sizeof buf) || strcmp(buf,"0")==0) return;
+        Matrix r = {0};
+        double t0 = now_sec();
+        if(strcmp(buf,"1")==0){ if(mat_read(&calc_ma, "A")) mat_print("A", &calc_ma); }
+        else if(strcmp(buf,"2")==0){ if(mat_read(&calc_mb, "B")) mat_print("B", &calc_mb); }
+        else if(strcmp(buf,"3")==0){
+            if(!read_line("N: ", buf, sizeof buf)) return;
+            int n = atoi(buf);
+            if(n < 1 || n > 8192){ uprintf("Use 1..8192.\n"); continue; }
+            mat_free(&calc_ma); mat_free(&calc_mb);
+            if(!mat_alloc(&calc_ma, n, n) || !mat_alloc(&calc_mb, n, n)){ uprintf("Out of memory.\n"); continue; }
+            mat_random(&calc_ma, (uint64_t)time(NULL)); mat_random(&calc_mb, (uint64_t)time(NULL) * 31 + 7);
+            mat_print("A", &calc_ma);
+        }
+        else if(strcmp(buf,"4")==0){
+            char path[128];
+            if(!read_line("File in " CALC_FILES_DIR "/: ", buf, sizeof buf)) return;
+            if(!calc_file_path(buf, path, sizeof path)){ uprintf("Use a plain file name (letters, digits, . _ -).\n"); continue; }
+            Matrix t;
+            if(!mat_load(&t, path)){ uprintf("Could not load %s.\n", path); continue; }
+            mat_free(&calc_ma); calc_ma = t;
+            uprintf("Loaded in %.3f s.\n", now_sec() - t0);
+            mat_print("A", &calc_ma);
+        }
+        else if(strcmp(buf,"5")==0){
+            if(!calc_ma.a){ uprintf("A is empty.\n"); continue; }
+            char path[128];
+            if(!read_line("File in " CALC_FILES_DIR "/: ", buf, sizeof buf)) return;
+            if(!calc_file_path(buf, path, sizeof path)){ uprintf("Use a plain file name (letters, digits, . _ -).\n"); continue; }
+            if(mat_save(&calc_ma, path)) uprintf("Saved in %.3f s.\n", now_sec() - t0);
+            else uprintf("Could not save %s.\n", path);
+        }
+        else if(strcmp(buf,"6")==0){
+            if(!mat_add(&calc_ma, &calc_mb, &r)){ uprintf("Sizes differ.\n"); continue; }
+            mat_print("A+B", &r);
+        }
+        else if(strcmp(buf,"7")==0){
+            if(!calc_ma.a || !mat_mul(&calc_ma, &calc_mb, &r, threads)){ uprintf("Inner sizes differ.\n"); continue; }
+            double s = now_sec() - t0;
+            mat_print("A*B", &r);
+            uprintf("%.3f s, %.2f GFLOP/s on %d threads\n", s, 2.0*calc_ma.rows*calc_ma.cols*calc_mb.cols / (s > 0 ? s : 1e-9) / 1e9, threads);
+        }
+        else if(strcmp(buf,"8")==0){
+            if(!calc_ma.a || !mat_transpose(&calc_ma, &r)) continue;
+            mat_free(&calc_ma); calc_ma = r; r.a = NULL;
+            mat_print("A", &calc_ma);
+        }
+        else if(strcmp(buf,"9")==0 || strcmp(buf,"10")==0){
+            int n = calc_ma.rows;
+            if(!calc_ma.a || calc_ma.cols != n){ uprintf("A must be square.\n"); continue; }
+            int *perm = malloc(n * sizeof *perm);
+            if(!perm || !mat_alloc(&r, n, n)){ free(perm); continue; }
+            memcpy(r.a, calc_ma.a, (size_t)n*n*sizeof(double));
+            if(!mat_lu(&r, perm, threads)){ uprintf("A is singular.\n"); free(perm); mat_free(&r); continue; }
+            if(buf[1] == '0'){
+                double det = 1;
+                int sign = 1;
+                for(int i=0;i<n;i++){ det *= r.a[(size_t)i*n + i]; for(int j=i+1;j<n;j++) if(perm[j] < perm[i]) sign = -sign; }
+                uprintf("det A = %.10g\n", sign * det);
+            } else {
+                double *b = malloc(2 * n * sizeof *b), *x = b + n, res = 0;
+                uint64_t seed = 42;
+                for(int i=0;i<n;i++) b[i] = (double)(splitmix64(&seed) % 2001) / 100 - 10;
+                mat_lu_solve(&r, perm, b, x);
+                for(int i=0;i<n;i++){
+                    double s = -b[i];
+                    for(int j=0;j<n;j++) s += calc_ma.a[(size_t)i*n + j] * x[j];
+                    if(fabs(s) > res) res = fabs(s);
+                }
+                uprintf("x =");
+                for(int i=0;i<n && i<8;i++) uprintf(" %.6g", x[i]);
+                uprintf("%s\nmax |Ax - b| = %.3g, %.3f s\n", n > 8 ? " ..." : "", res, now_sec() - t0);
+                free(b);
+            }
+            free(perm);
+        }
+        else uprintf("Invalid.\n");
+        mat_free(&r);
+    }
+}
+
+/* Drops the calculator state of the previous login on this thread and
+   frees its matrices (up to 2 x 8192^2 doubles). */
+void calc_session_reset(void){
+    memset(&calc_vars, 0, sizeof calc_vars);
+    mat_free(&calc_ma);
+    mat_free(&calc_mb);
+}
+
+void calculator_menu(void){
+    while(1){
+        uprintf("\n=== Advanced Calculator ===\n1) Expression\n2) Quadratic solver\n3) Matrices\n4) Tabulate f(x)\n0) Back\nChoose: ");
+        char buf[16];
+        if(!read_line("", buf, sizeof buf) || strcmp(buf,"0")==0) return;
+        if(strcmp(buf,"1")==0) calc_basic();
+        else if(strcmp(buf,"2")==0) calc_quadratic();
+        else if(strcmp(buf,"3")==0) calc_matrix();
+        else if(strcmp(buf,"4")==0) calc_tabulate();
+        else uprintf("Invalid.\n");
+    }
+}
+
+/* ---------- Platform Home ---------- */
+void platform_home(const char *username){
+    calc_session_reset();
+    while(1){
+        uprintf("\n=== Welcome, %s ===\n1) Games\n2) Learn C\n3) Algorithms demo\n4) Advanced Calculator\n5) Profile\n6) Show users (admin)\n7) Profiler stats (admin)\n8) Leaderboard\n0) Logout\nChoose: ", username);
+        char opt[16];
+        if(!read_line("", opt, sizeof opt)) break;
+        if(strcmp(opt,"0")==0){ session_end(); uprintf("Logging out...\n"); break; }
+        else if(strcmp(opt,"1")==0) games_menu(username);
+        else if(strcmp(opt,"2")==0) learn_menu(username);
+        else if(strcmp(opt,"3")==0){
+            uprintf("1) Sorting 2) Binary Search 3) Sorting benchmark 4) Search benchmark\n");
+            char s[8];
+            if(!read_line("Choose: ", s, sizeof s)) break;
+            if(strcmp(s,"1")==0) demo_sorting();
+            else if(strcmp(s,"2")==0) demo_binary_search();
+            else if(strcmp(s,"3")==0){
+                char nb[32];
+                if(!read_line("Largest array size (1000..100000000) [1000000]: ", nb, sizeof nb)) break;
+                long n = atol(nb);
+                sort_benchmark(n >= 1000 && n <= 100000000 ? (size_t)n : 1000000, 0);
+            }
+            else if(strcmp(s,"4")==0){
+                char nb[32];
+                if(!read_line("Largest array size (1024..1000000000) [16777216]: ", nb, sizeof nb)) break;
+                long n = atol(nb);
+                search_benchmark(n >= 1024 && n <= 1000000000 ? (size_t)n : 16777216);
+            }
+        }
+        else if(strcmp(opt,"4")==0) calculator_menu();
+        else if(strcmp(opt,"5")==0) show_profile(username);
+        else if(strcmp(opt,"6")==0) show_all_users();
+        else if(strcmp(opt,"7")==0) show_profile_stats();
+        else if(strcmp(opt,"8")==0) show_leaderboard(username);
+        else uprintf("Invalid option.\n");
+    }
+    calc_session_reset();      /* server workers are reused by the next client */
+}
+
+/* ---------- Startup loop ---------- */
+/* Returns when the user chooses Exit or input ends. */
+void startup_loop(void){
+    ensure_data_dir();
+    while(1){
+        uprintf("\n=== CPlayground Startup ===\n1) Sign Up\n2) Log In\n3) Show Users (admin)\n0) Exit\nChoose: ");
+        char buf[16];
+        if(!read_line("", buf, sizeof buf) || strcmp(buf,"0")==0) return;
+        else if(strcmp(buf,"1")==0){
+            if(signup_flow()){
+                char ans[8];
+                if(!read_line("Login now? (y/n): ", ans, sizeof ans)) return;
+                if(ans[0]=='y' || ans[0]=='Y'){ char user[MAX_USER]; if(login_flow(user)) platform_home(user); }
+            }
+        }
+        else if(strcmp(buf,"2")==0){
+            char user[MAX_USER] = {0};
+            if(login_flow(user)) platform_home(user);
+        }
+        else if(strcmp(buf,"3")==0) show_all_users();
+        else uprintf("Invalid.\n");
+    }
+}
+
+/* ---------- Bulk import / export ----------
+   cplayground --import file.csv [iterations] [threads] adds many users in
+   one pass instead of one signup (a full users.db rewrite) per user:
+   - Parse the CSV and sort it by username; repeated names keep their first row.
+   - Skip users that already exist.
+   - Hash the new passwords on all cores.
+   - Merge the two sorted lists and write users.db once.
+   Rows are "username,password", with an optional header. Headers must match
+   exactly, so a user named "username" is still a row. The KDF cost is
+   chosen per import. Records below kdf_iterations are rehashed at the
+   user's first login, so a cohort can be onboarded cheaply without
+   lowering the cost of established accounts.
+   --export file.csv writes "username,hash,games_played,games_won,quizzes,
+   last_login" rows with that header. --import recognises the header and
+   takes the hashes and stats as they are, so export + import moves users
+   between databases. Use "-" for stdin/stdout. */
+#define IMPORT_CHUNK 256
+#define IMPORT_MAX_PW 1024
+#define IMPORT_HEADER "username,password"
+#define EXPORT_HEADER "username,hash,games_played,games_won,quizzes,last_login"
+
+typedef struct {
+    char username[MAX_USER];
+    uint32_t text;              /* arena offset of the password (or stored hash) */
+    int line, gp, gw, q;
+    char last_login[32];
+} ImportRow;
+
+typedef struct {
+    long long rows, invalid, dup_in_file, existing, imported;
+    double parse_s, hash_s, write_s;
+    int first_bad[5], nbad;
+} ImportStats;
+
+typedef struct {
+    ImportRow *rows; int n, cap;
+    char *arena; size_t alen, acap;
+    int hashed;                 /* rows carry stored hashes, not passwords */
+    int oom;                    /* an allocation failed; the import is abandoned */
+} ImportSet;
+
+uint32_t import_store(ImportSet *set, const char *s, size_t len){
+    if(set->alen + len + 1 > set->acap){
+        size_t cap = set->acap;
+        while(set->alen + len + 1 > cap) cap = cap ? cap*2 : 1 << 20;
+        char *arena = realloc(set->arena, cap);
+        if(!arena){ set->oom = 1; return 0; }
+        set->arena = arena; set->acap = cap;
+    }
+    uint32_t off = (uint32_t)set->alen;
+    memcpy(set->arena + off, s, len);
+    set->arena[off + len] = 0;
+    set->alen += len + 1;
+    return off;
+}
+
+/* Parses one data row into set; returns 0 if malformed. Sets set->oom
+   if it runs out of memory. */
+int import_parse_row(ImportSet *set, char *line, int lineno){
+    size_t len = strlen(line);
+    if(len && line[len-1] == '\r') line[--len] = 0;
+    char *comma = strchr(line, ',');
+    if(!comma || !username_valid(line, (size_t)(comma - line))) return 0;
+    if(set->n == set->cap){
+        int cap = set->cap ? set->cap*2 : 4096;
+        ImportRow *rows = realloc(set->rows, cap * sizeof(ImportRow));
+        if(!rows){ set->oom = 1; return 0; }
+        set->rows = rows; set->cap = cap;
+    }
+    ImportRow *r = &set->rows[set->n];
+    memset(r, 0, sizeof *r);
+    memcpy(r->username, line, (size_t)(comma - line));
+    r->line = lineno;
+    char *rest = comma + 1;
+    if(!set->hashed){
+        size_t pl = strlen(rest);
+        if(pl == 0 || pl >= IMPORT_MAX_PW) return 0;
+        r->text = import_store(set, rest, pl);
+        if(set->oom) return 0;
+    } else {
+        char hash[HASH_FIELD], ll[32];
+        uint8_t salt[KDF_SALT_BYTES], dk[32];
+        uint32_t it;
+        for(char *p = rest; *p; p++) if(*p == ',') *p = ' ';
+        if(sscanf(rest, "%127s %d %d %d %31s", hash, &r->gp, &r->gw, &r->q, ll) != 5) return 0;
+        if(!parse_pbkdf2(hash, &it, salt, dk) && (strlen(hash) != 64 || !hex_decode(hash, dk, 32))) return 0;
+        r->text = import_store(set, hash, strlen(hash));
+        if(set->oom) return 0;
+        if(strcmp(ll, "-") != 0) strcpy(r->last_login, ll);
+    }
+    set->n++;
+    return 1;
+}
+
+/* 1 if line is exactly header, allowing a trailing \r. */
+int csv_is_header(const char *line, const char *header){
+    size_t L = strlen(header);
+    return strncmp(line, header, L) == 0 && (line[L] == 0 || (line[L] == '\r' && line[L+1] == 0));
+}
+
+int import_read(FILE *in, ImportSet *set, ImportStats *st){
+    LineReader rd;
+    if(!line_reader_init(&rd, in, 1 << 20, 0)) return 0;
+    char *line;
+    int lineno = 0, first = 1;
+    while((line = line_next(&rd))){
+        lineno++;
+        if(line[0] == 0 || line[0] == '#' || (line[0] == '\r' && line[1] == 0)) continue;
+        if(first){
+            first = 0;
+            if(csv_is_header(line, EXPORT_HEADER)){ set->hashed = 1; continue; }
+            if(csv_is_header(line, IMPORT_HEADER)) continue;
+        }
+        st->rows++;
+        if(!import_parse_row(set, line, lineno)){
+            if(set->oom) break;
+            st->invalid++;
+            if(st->nbad < 5) st->first_bad[st->nbad++] = lineno;
+        }
+    }
+    line_reader_free(&rd);
+    return !set->oom;
+}
+
+ImportRow *import_sort_base;
+int import_cmp(const void *a, const void *b){
+    const ImportRow *x = &import_sort_base[*(const int*)a], *y = &import_sort_base[*(const int*)b];
+    int c = strcmp(x->username, y->username);
+    return c ? c : x->line - y->line;
+}
+
+int cmp_user_ptr(const void *a, const void *b){
+    return strcmp((*(const User* const*)a)->username, (*(const User* const*)b)->username);
+}
+
+/* Pointers to arr sorted by username (arr itself is left in file order). */
+const User **users_sorted(const User *arr, int n){
+    const User **p = malloc((n > 0 ? n : 1) * sizeof *p);
+    if(!p) return NULL;
+    for(int i=0;i<n;i++) p[i] = &arr[i];
+    qsort(p, n, sizeof *p, cmp_user_ptr);
+    return p;
+}
+
+/* Drops rows whose username is in the sorted existing list; returns the new count. */
+int import_drop_existing(ImportRow *rows, int n, const User **ex, int m, long long *dropped){
+    int k = 0, j = 0;
+    for(int i=0;i<n;i++){
+        while(j < m && strcmp(ex[j]->username, rows[i].username) < 0) j++;
+        if(j < m && strcmp(ex[j]->username, rows[i].username) == 0){ (*dropped)++; continue; }
+        rows[k++] = rows[i];
+    }
+    return k;
+}
+
+typedef struct { const ImportSet *set; const ImportRow *rows; User *out; int n; uint32_t iterations; } ImportHashCtx;
+
+void import_hash_chunk(void *arg, int c){
+    ImportHashCtx *h = arg;
+    int lo = c * IMPORT_CHUNK, hi = lo + IMPORT_CHUNK < h->n ? lo + IMPORT_CHUNK : h->n;
+    uint8_t salts[IMPORT_CHUNK][KDF_SALT_BYTES];
+    if(!h->set->hashed) random_bytes(&salts[0][0], sizeof salts);
+    for(int i=lo;i<hi;i++){
+        const ImportRow *r = &h->rows[i];
+        User *u = &h->out[i];
+        memset(u, 0, sizeof *u);
+        strcpy(u->username, r->username);
+        if(h->set->hashed){
+            strncpy(u->hash, h->set->arena + r->text, sizeof u->hash - 1);
+            u->games_played = r->gp; u->games_won = r->gw; u->quizzes = r->q;
+            strcpy(u->last_login, r->last_login);
+        } else password_hash_salted(h->set->arena + r->text, h->iterations, salts[i - lo], u->hash);
+    }
+}
+
+int import_users(FILE *in, uint32_t iterations, int threads, ImportStats *st){
+    memset(st, 0, sizeof *st);
+    ImportSet set;
+    memset(&set, 0, sizeof set);
+    double t0 = now_sec();
+    if(!import_read(in, &set, st)){ free(set.rows); free(set.arena); return 0; }
+
+    /* Sort, keep the first row per username. */
+    int n = set.n;
+    int *order = malloc((n > 0 ? n : 1) * sizeof(int));
+    ImportRow *rows = malloc((n > 0 ? n : 1) * sizeof(ImportRow));
+    if(!order || !rows){ free(order); free(rows); free(set.rows); free(set.arena); return 0; }
+    for(int i=0;i<n;i++) order[i] = i;
+    import_sort_base = set.rows;
+    qsort(order, n, sizeof(int), import_cmp);
+    int m = 0;
+    for(int i=0;i<n;i++){
+        const ImportRow *r = &set.rows[order[i]];
+        if(m && strcmp(rows[m-1].username, r->username) == 0){ st->dup_in_file++; continue; }
+        rows[m++] = *r;
+    }
+    free(order); free(set.rows); set.rows = NULL;
+
+    /* Skip names that already exist before spending KDF time on them. */
+    User *arr; int cnt = load_users(&arr);
+    const User **ex = users_sorted(arr, cnt);
+    if(!ex){ free(arr); free(rows); free(set.arena); return 0; }
+    m = import_drop_existing(rows, m, ex, cnt, &st->existing);
+    free(ex); free(arr);
+    st->parse_s = now_sec() - t0;
+
+    t0 = now_sec();
+    User *fresh = malloc((m > 0 ? m : 1) * sizeof(User));
+    if(!fresh){ free(rows); free(set.arena); return 0; }
+    ImportHashCtx hc = { &set, rows, fresh, m, iterations };
+    parallel_for((m + IMPORT_CHUNK - 1) / IMPORT_CHUNK, threads, import_hash_chunk, &hc);
+    free(rows); free(set.arena);
+    st->hash_s = now_sec() - t0;
+
+    /* Append to whatever users.db holds now (signups may have raced us)
+       and write it once. Existing users keep their order. */
+    t0 = now_sec();
+    db_lock();
+    cnt = load_users_nolock(&arr);
+    ex = users_sorted(arr, cnt);
+    User *merged = malloc(((size_t)cnt + m + 1) * sizeof(User));
+    int ok = ex && merged;
+    if(ok){
+        memcpy(merged, arr, (size_t)cnt * sizeof(User));
+        int k = cnt, j = 0;
+        long long raced = 0;
+        for(int i=0;i<m;i++){
+            while(j < cnt && strcmp(ex[j]->username, fresh[i].username) < 0) j++;
+            if(j < cnt && strcmp(ex[j]->username, fresh[i].username) == 0){ raced++; continue; }
+            merged[k++] = fresh[i];
+        }
+        ok = k == cnt || save_users_as_nolock(merged, k, db_is_binary());
+        st->imported = ok ? k - cnt : 0;
+        st->existing += raced;
+    }
+    db_unlock();
+    free(merged); free(ex); free(arr); free(fresh);
+    st->write_s = now_sec() - t0;
+    return ok;
+}
+
+void import_print_stats(FILE *f, const ImportStats *st){
+    fprintf(f, "%lld rows: %lld imported, %lld already existed, %lld repeated in the file, %lld invalid",
+            st->rows, st->imported, st->existing, st->dup_in_file, st->invalid);
+    for(int i=0;i<st->nbad;i++) fprintf(f, "%s%d", i ? ", " : " (lines ", st->first_bad[i]);
+    fprintf(f, "%s\n", st->nbad ? st->invalid > st->nbad ? ", ...)" : ")" : "");
+    double total = st->parse_s + st->hash_s + st->write_s;
+    fprintf(f, "parse+dedupe %.3f s, hash %.3f s, merge+write %.3f s: %.0f users/s\n",
+            st->parse_s, st->hash_s, st->write_s, st->imported / (total > 0 ? total : 1e-9));
+}
+
+/* Writes every user as CSV (journal applied) in constant memory. Returns
+   the number exported, or -1 on a write error. */
+long long export_users(FILE *out){
+    User *batch = malloc(LIST_BATCH * sizeof(User));
+    OutBuf ob;
+    if(!batch || !outbuf_init(&ob, out, 1 << 20)){ free(batch); return -1; }
+    outbuf_puts(&ob, EXPORT_HEADER "\n");
+    UserCursor cur = {0, 0};
+    long long total = 0;
+    int n;
+    while((n = users_page("", &cur, batch, LIST_BATCH)) > 0){
+        for(int i=0;i<n;i++){
+            const User *u = &batch[i];
+            char *p = outbuf_reserve(&ob, sizeof(User) + 64);
+            ob.len += snprintf(p, sizeof(User) + 64, "%s,%s,%d,%d,%d,%s\n", u->username, u->hash,
+                               u->games_played, u->games_won, u->quizzes, u->last_login[0] ? u->last_login : "-");
+        }
+        total += n;
+        if(n < LIST_BATCH) break;
+    }
+    free(batch);
+    return outbuf_close(&ob) && n >= 0 ? total : -1;
+}
+
+int import_main(int argc, char **argv){
+    if(argc < 3){
+        printf("Usage: %s --import file.csv|- [iterations] [threads]\n", argv[0]);
+        printf("iterations defaults to the full KDF cost (%d), so each user costs a full\n"
+               "login's worth of hashing. For a fast bulk load pass a low count, or run with\n"
+               "CPLAYGROUND_KDF_ITER=1; users below the KDF cost are rehashed on first login.\n", kdf_iterations);
+        return 1;
+    }
+    FILE *in = strcmp(argv[2], "-") ? fopen(argv[2], "rb") : stdin;
+    if(!in){ perror(argv[2]); return 1; }
+    uint32_t it = argc >= 4 && atoi(argv[3]) > 0 ? (uint32_t)atoi(argv[3]) : (uint32_t)kdf_iterations;
+    int threads = argc >= 5 && atoi(argv[4]) > 0 ? atoi(argv[4]) : cpu_count();
+    ImportStats st;
+    int ok = import_users(in, it, threads, &st);
+    if(in != stdin) fclose(in);
+    import_print_stats(stdout, &st);
+    if(ok && it < (uint32_t)kdf_iterations && st.imported)
+        printf("Hashed with %u iterations; each user is rehashed at %d on first login.\n", it, kdf_iterations);
+    if(!ok) printf("Import failed; %s is unchanged.\n", users_db_path);
+    return ok ? 0 : 1;
+}
+
+int export_main(int argc, char **argv){
+    if(argc < 3){ printf("Usage: %s --export file.csv|-\n", argv[0]); return 1; }
+    FILE *out = strcmp(argv[2], "-") ? fopen(argv[2], "wb") : stdout;
+    if(!out){ perror(argv[2]); return 1; }
+    double t0 = now_sec();
+    long long n = export_users(out);
+    double t = now_sec() - t0;
+    if(out != stdout && fclose(out) != 0) n = -1;
+    if(n < 0){ fprintf(stderr, "Export to %s failed.\n", argv[2]); return 1; }
+    fprintf(stderr, "Exported %lld users in %.3f s (%.0f users/s).\n", n, t, n / (t > 0 ? t : 1e-9));
+    return 0;
+}
+
+/* ---------- Server mode ----------
+   cplayground --serve [socket] [workers] serves the startup menu over a Unix
+   domain socket. One epoll thread accepts connections and, once a connection
+   has input, queues it for a pool of worker threads. A worker runs the whole
+   menu session with io_in/io_out pointed at the socket; menu flows block in
+   read_line(), so each live session occupies one worker. Sessions end when
+   the client closes its side or sends nothing for serve_idle_secs. A client
+   that connects while every worker is taken is told it is queued, and
+   turned away once SERVE_MAX_WAITING clients per worker are waiting.
+   Ctrl-C shuts active connections down, joins the workers and compacts
+   the journal. */
+#define SERVE_SOCK DATA_DIR "/cplayground.sock"
+#define SERVE_WORKERS 8
+#define SERVE_IDLE_SECS 300
+#define SERVE_MAX_WAITING 4
+
+int serve_idle_secs = SERVE_IDLE_SECS;      /* CPLAYGROUND_IDLE_SECS; 0 = no limit */
+
+#ifdef __linux__
+#define SERVE_QUEUE 1024
+
+typedef struct {
+    int listen_fd, epoll_fd, nworkers;
+    atomic_int stop;        /* read by the event loop without the lock */
+    pthread_mutex_t mu;
+    pthread_cond_t cv;
+    int queue[SERVE_QUEUE], qhead, qcount;  /* ready connections */
+    int *active;                            /* fd each worker is serving, -1 if idle */
+    long served;
+} Server;
+
+void serve_session(int fd){
+    int fd2 = dup(fd);
+    FILE *in = fdopen(fd, "r"), *out = fd2 >= 0 ? fdopen(fd2, "w") : NULL;
+    if(!in || !out){
+        if(in) fclose(in); else close(fd);
+        if(out) fclose(out); else if(fd2 >= 0) close(fd2);
+        return;
+    }
+    if(serve_idle_secs > 0){
+        struct timeval tv = { serve_idle_secs, 0 };
+        setsockopt(fd, SOL_SOCKET, SO_RCVTIMEO, &tv, sizeof tv);
+    }
+    io_in = in; io_out = out; io_closed = 0;
+    uprintf("CPlayground server\n");
+    startup_loop();
+    if(ferror(in)) uprintf("\nNo input for %d s, closing the session.\n", serve_idle_secs);
+    else if(!io_closed) uprintf("Bye.\n");
+    session_end();          /* write back a session cut off by EOF */
+    io_in = io_out = NULL;
+    fclose(out);
+    fclose(in);
+}
+
+void *serve_worker(void *arg){
+    Server *s = arg;
+    pthread_mutex_lock(&s->mu);
+    int id = 0;
+    while(id < s->nworkers && s->active[id] != -2) id++;
+    s->active[id] = -1;
+    for(;;){
+        while(s->qcount == 0 && !s->stop) pthread_cond_wait(&s->cv, &s->mu);
+        if(s->qcount == 0) break;
+        int fd = s->queue[s->qhead];
+        s->qhead = (s->qhead+1) % SERVE_QUEUE; s->qcount--;
+        s->active[id] = fd;
+        pthread_mutex_unlock(&s->mu);
+        serve_session(fd);
+        pthread_mutex_lock(&s->mu);
+        s->active[id] = -1;
+        s->served++;
+    }
+    pthread_mutex_unlock(&s->mu);
+    return NULL;
+}
+
+int serve_listen(const char *path){
+    struct sockaddr_un sa;
+    memset(&sa, 0, sizeof sa);
+    sa.sun_family = AF_UNIX;
+    if(strlen(path) >= sizeof sa.sun_path){ fprintf(stderr, "Socket path too long.\n"); return -1; }
+    strcpy(sa.sun_path, path);
+    int fd = socket(AF_UNIX, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+    if(fd < 0){ perror("socket"); return -1; }
+    unlink(path);
+    if(bind(fd, (struct sockaddr*)&sa, sizeof sa) != 0 || listen(fd, 256) != 0){
+        perror(path); close(fd); return -1;
+    }
+    return fd;
+}
+
+/* Best-effort status line to a client no worker has picked up yet. */
+void serve_notice(int fd, const char *msg){
+    send(fd, msg, strlen(msg), MSG_DONTWAIT | MSG_NOSIGNAL);
+}
+
+/* Event loop; returns when s->stop is set or on Ctrl-C. */
+void serve_loop(Server *s){
+    struct epoll_event ev, evs[64];
+    ev.events = EPOLLIN; ev.data.fd = s->listen_fd;
+    epoll_ctl(s->epoll_fd, EPOLL_CTL_ADD, s->listen_fd, &ev);
+    while(!s->stop && !interrupted){
+        int n = epoll_wait(s->epoll_fd, evs, 64, 100);
+        for(int i=0;i<n;i++){
+            int fd = evs[i].data.fd;
+            if(fd == s->listen_fd){
+                int c;
+                while((c = accept(s->listen_fd, NULL, NULL)) >= 0){
+                    pthread_mutex_lock(&s->mu);
+                    int idle = 0, waiting = s->qcount;
+                    for(int w=0;w<s->nworkers;w++) idle += s->active[w] == -1;
+                    pthread_mutex_unlock(&s->mu);
+                    if(waiting >= idle + SERVE_MAX_WAITING * s->nworkers){
+                        serve_notice(c, "Server full, try again later.\n");
+                        close(c);
+                        continue;
+                    }
+                    if(waiting >= idle) serve_notice(c, "All sessions are busy; you are queued and will be served when one ends.\n");
+                    ev.events = EPOLLIN | EPOLLONESHOT; ev.data.fd = c;
+                    if(epoll_ctl(s->epoll_fd, EPOLL_CTL_ADD, c, &ev) != 0) close(c);
+                }
+                continue;
+            }
+            epoll_ctl(s->epoll_fd, EPOLL_CTL_DEL, fd, NULL);
+            pthread_mutex_lock(&s->mu);
+            if(s->qcount < SERVE_QUEUE){
+                s->queue[(s->qhead+s->qcount) % SERVE_QUEUE] = fd;
+                s->qcount++;
+                pthread_cond_signal(&s->cv);
+                fd = -1;
+            }
+            pthread_mutex_unlock(&s->mu);
+            if(fd >= 0) close(fd);      /* backlog full: drop */
+        }
+    }
+}
+
+void serve_shutdown(Server *s, pthread_t *th){
+    pthread_mutex_lock(&s->mu);
+    s->stop = 1;
+    if(interrupted)     /* unblock sessions waiting for input */
+        for(int i=0;i<s->nworkers;i++) if(s->active[i] >= 0) shutdown(s->active[i], SHUT_RDWR);
+    pthread_cond_broadcast(&s->cv);
+    pthread_mutex_unlock(&s->mu);
+    for(int i=0;i<s->nworkers;i++) pthread_join(th[i], NULL);
+    while(s->qcount > 0){ close(s->queue[s->qhead]); s->qhead = (s->qhead+1) % SERVE_QUEUE; s->qcount--; }
+    close(s->epoll_fd);
+    close(s->listen_fd);
+    free(s->active);
+}
+
+/* Returns 0, with nothing left running or listening, if any step fails. */
+int serve_start(Server *s, pthread_t *th, const char *path, int nworkers){
+    memset(s, 0, sizeof *s);
+    s->nworkers = nworkers;
+    s->listen_fd = serve_listen(path);
+    if(s->listen_fd < 0) return 0;
+    s->epoll_fd = epoll_create1(EPOLL_CLOEXEC);
+    if(s->epoll_fd < 0){ perror("epoll_create1"); close(s->listen_fd); unlink(path); return 0; }
+    s->active = malloc(nworkers * sizeof(int));
+    if(!s->active){
+        fprintf(stderr, "Out of memory.\n");
+        close(s->epoll_fd); close(s->listen_fd); unlink(path);
+        return 0;
+    }
+    for(int i=0;i<nworkers;i++) s->active[i] = -2;     /* unclaimed */
+    pthread_mutex_init(&s->mu, NULL);
+    pthread_cond_init(&s->cv, NULL);
+    signal(SIGPIPE, SIG_IGN);
+    for(int i=0;i<nworkers;i++){
+        int err = pthread_create(&th[i], NULL, serve_worker, s);
+        if(err){
+            fprintf(stderr, "Cannot start worker %d: %s\n", i, strerror(err));
+            pthread_mutex_lock(&s->mu);
+            s->nworkers = i;                /* only these exist to be joined */
+            pthread_mutex_unlock(&s->mu);
+            serve_shutdown(s, th);
+            unlink(path);
+            return 0;
+        }
+    }
+    return 1;
+}
+
+int serve_main(const char *path, int nworkers){
+    if(nworkers < 1) nworkers = SERVE_WORKERS;
+    ensure_data_dir();
+    Server s;
+    pthread_t *th = malloc(nworkers * sizeof *th);
+    if(!th){ fprintf(stderr, "Out of memory.\n"); return 1; }
+    if(!serve_start(&s, th, path, nworkers)){ free(th); return 1; }
+    printf("Serving on %s with %d workers (Ctrl-C to stop)\n", path, nworkers);
+    serve_loop(&s);
+    serve_shutdown(&s, th);
+    unlink(path);
+    db_compact();
+    printf("Served %ld sessions.\n", s.served);
+    free(th);
+    return 0;
+}
+#else
+int serve_main(const char *path, int nworkers){
+    (void)path; (void)nworkers;
+    fprintf(stderr, "--serve is only supported on Linux.\n");
+    return 1;
+}
+#endif
+
+/* ---------- Session replay ----------
+   Drives the real menu code without a terminal: each flow of a script is fed
+   to startup_loop() through io_in, with output discarded. A script is plain
+   menu input; lines of the form "@ name" start a new flow, and "{n}" is
+   replaced by the session number so signups stay unique. Every session runs
+   the flows in order. Scripts can be recorded with --record <file>;
+   passwords are written as RECORD_MASK, so a recorded script can only log
+   in to accounts it signed up itself. */
+typedef struct {
+    char name[32];
+    char *text;             /* input lines, "{n}" not yet expanded */
+    double *lat;            /* per-session latency in seconds */
+} ReplayFlow;
+
+int replay_is_header(const char *p, const char *le){
+    return le - p >= 2 && p[0] == '@' && p[1] == ' ';
+}
+
+/* Splits a script into flows; returns the flow count, or -1 (with *out
+   NULL) if out of memory. */
+int replay_parse(const char *data, size_t len, ReplayFlow **out){
+    int n = 0, cap = 8;
+    ReplayFlow *fl = calloc(cap, sizeof *fl);
+    size_t tlen = 0;
+    const char *p = data, *end = data + len;
+    *out = NULL;
+    if(!fl) return -1;
+    while(p < end){
+        const char *nl = memchr(p, '\n', end - p);
+        const char *le = nl ? nl : end;
+        if(replay_is_header(p, le)){
+            if(n == cap){
+                ReplayFlow *grown = realloc(fl, cap * 2 * sizeof *fl);
+                if(!grown) goto oom;
+                fl = grown; cap *= 2;
+            }
+            memset(&fl[n], 0, sizeof fl[n]);
+            int k = (int)(le - p - 2);
+            snprintf(fl[n].name, sizeof fl[n].name, "%.*s", k, p + 2);
+            size_t body = 0;            /* this flow's lines, up to the next header */
+            for(const char *q = nl ? nl + 1 : end; q < end; ){
+                const char *qn = memchr(q, '\n', end - q), *qe = qn ? qn : end;
+                if(replay_is_header(q, qe)) break;
+                body += (size_t)(qe - q) + 1;
+                q = qn ? qn + 1 : end;
+            }
+            if(!(fl[n].text = calloc(1, body + 1))) goto oom;
+            tlen = 0; n++;
+        } else if(n > 0){
+            memcpy(fl[n-1].text + tlen, p, le - p);
+            tlen += le - p;
+            fl[n-1].text[tlen++] = '\n';
+        }
+        p = nl ? nl + 1 : end;
+    }
+    *out = fl;
+    return n;
+oom:
+    for(int i=0;i<n;i++) free(fl[i].text);
+    free(fl);
+    return -1;
+}
+
+/* Copies text into *buf with every "{n}" replaced by id. */
+size_t replay_expand(const char *text, int id, char **buf, size_t *cap){
+    size_t need = strlen(text) + 64, o = 0;
+    for(const char *p = text; (p = strstr(p, "{n}")); p += 3) need += 16;
+    if(need > *cap){ *cap = need; *buf = realloc(*buf, need); }
+    for(const char *p = text; *p; ){
+        if(p[0]=='{' && p[1]=='n' && p[2]=='}'){ o += sprintf(*buf + o, "%d", id); p += 3; }
+        else (*buf)[o++] = *p++;
+    }
+    (*buf)[o] = '\0';
+    return o;
+}
+
+/* Runs one flow against the menu; returns its wall time in seconds. */
+double replay_flow(const char *input, size_t len, FILE *sink){
+    FILE *in = mem_stream(input, len);
+    if(!in) return 0;
+    double t0 = now_sec();
+    io_in = in; io_out = sink; io_closed = 0;
+    startup_loop();
+    session_end();
+    io_in = io_out = NULL;
+    double t = now_sec() - t0;
+    fclose(in);
+    return t;
+}
+
+/* Moves for a tic-tac-toe game where X always takes the lowest free cell,
+   computed against the real AI so the script ends exactly with the game. */
+void replay_ttt_moves(char *out, size_t n){
+    memset(&ttt_board, 0, sizeof ttt_board);
+    size_t o = 0; out[0] = '\0';
+    while(ttt_winner() == 2){
+        int m = 0;
+        while((ttt_board.x | ttt_board.o) >> m & 1) m++;
+        ttt_board.x |= 1 << m;
+        o += snprintf(out + o, n - o, "%d\n", m);
+        if(ttt_winner() != 2) break;
+        int a = ttt_ai_move();
+        if(a >= 0) ttt_board.o |= 1 << a;
+    }
+}
+
+/* Built-in script: signup, login, a quiz and a tic-tac-toe game per session.
+   NULL if out of memory. */
+char *replay_default_script(void){
+    char moves[64], *s = malloc(1024);
+    if(!s) return NULL;
+    replay_ttt_moves(moves, sizeof moves);
+    snprintf(s, 1024,
+        "@ signup\n1\nrp{n}\npw\nn\n0\n"
+        "@ login\n2\nrp{n}\npw\n0\n0\n"
+        "@ quiz\n2\nrp{n}\npw\n2\n4\nprintf\n&\nstdlib.h\ndo-while\n0\n0\n0\n0\n"
+        "@ tictactoe\n2\nrp{n}\npw\n1\n2\n%s0\n0\n0\n", moves);
+    return s;
+}
+
+/* Replays sessions x script and prints per-flow latency percentiles,
+   throughput and bytes written to the DB files. */
+void replay_run(const char *script, size_t len, int sessions){
+    ReplayFlow *fl;
+    int nf = replay_parse(script, len, &fl);
+    if(nf < 0){ printf("Out of memory.\n"); return; }
+    if(nf == 0){ printf("Script has no flows (expected \"@ name\" lines).\n"); free(fl); return; }
+    if(sessions < 1) sessions = 1;
+    for(int f=0;f<nf;f++) if(!(fl[f].lat = malloc(sessions * sizeof(double)))){
+        printf("Out of memory.\n");
+        for(int i=0;i<nf;i++){ free(fl[i].lat); free(fl[i].text); }
+        free(fl);
+        return;
+    }
+    FILE *sink = fopen(
+#ifdef _WIN32
+        "NUL",
+#else
+        "/dev/null",
+#endif
+        "w");
+    char *buf = NULL; size_t cap = 0;
+    long long bytes0 = db_bytes_written;
+    double t0 = now_sec();
+    for(int s=0;s<sessions;s++)
+        for(int f=0;f<nf;f++){
+            size_t n = replay_expand(fl[f].text, s, &buf, &cap);
+            fl[f].lat[s] = replay_flow(buf, n, sink ? sink : stdout);
+        }
+    double wall = now_sec() - t0;
+    long long bytes = db_bytes_written - bytes0;
+    if(sink) fclose(sink);
+    printf("%-12s %8s %10s %10s %10s %10s\n", "flow", "count", "mean ms", "p50 ms", "p95 ms", "p99 ms");
+    for(int f=0;f<nf;f++){
+        double sum = 0;
+        for(int s=0;s<sessions;s++) sum += fl[f].lat[s];
+        qsort(fl[f].lat, sessions, sizeof(double), cmp_double);
+        printf("%-12s %8d %10.3f %10.3f %10.3f %10.3f\n", fl[f].name, sessions, sum/sessions*1e3,
+               percentile(fl[f].lat, sessions, 50)*1e3, percentile(fl[f].lat, sessions, 95)*1e3,
+               percentile(fl[f].lat, sessions, 99)*1e3);
+        free(fl[f].lat); free(fl[f].text);
+    }
+    printf("%d sessions in %.2f s: %.1f sessions/s, %.1f flows/s\n", sessions, wall, sessions/wall, sessions*nf/wall);
+    printf("disk bytes written: %lld (%.0f per session)\n", bytes, (double)bytes/sessions);
+    free(buf); free(fl);
+}
+
+/* ---------- Benchmarks ----------
+   Run with: cplayground --bench <name> [args]. Benchmarks work on scratch
+   files under data/ and never touch users.db. */
+#define BENCH_DB DATA_DIR "/bench-users.db"
+
+void bench_use_db(const char *path){
+    char p[300];
+    strncpy(users_db_path, path, sizeof users_db_path-1);
+    remove(users_db_path);
+    idx_path(p, sizeof p); remove(p);
+    journal_remove_all();
+}
+
+void bench_make_users(int n){
+    ensure_data_dir();
+    char hash[HASH_HEX];
+    sha256_hex("secret", hash);
+    FILE *f = fopen(users_db_path, "w");
+    if(!f) return;
+    for(int i=0;i<n;i++)
+        fprintf(f, "user%07d %s %d %d %d 2026-01-01T00:00:00\n", i, hash, i%50, i%20, i%7);
+    fclose(f);
+}
+
+/* Lookup cost by database size (records hold a legacy sha256 hash, so the
+   check is cheap), then the KDF a real login adds on top. */
+void bench_login(void){
+    int sizes[] = {1000, 100000, 1000000};
+    char saved[256]; strcpy(saved, users_db_path);
+    srand(12345);
+    double ix = 0;
+    printf("%9s %17s %17s %14s\n", "users", "linear us/lookup", "index us/lookup", "index build s");
+    for(int s=0;s<3;s++){
+        int n = sizes[s];
+        bench_use_db(BENCH_DB);
+        bench_make_users(n);
+        double t0 = now_sec();
+        idx_rebuild();
+        double build = now_sec()-t0;
+        char name[MAX_USER], hash[HASH_HEX];
+        int lin_iters = n>=1000000 ? 3 : n>=100000 ? 20 : 2000, ok=0;
+        t0 = now_sec();
+        for(int i=0;i<lin_iters;i++){
+            snprintf(name, sizeof name, "user%07d", rand()%n);
+            sha256_hex("secret", hash);
+            User *arr; int m = load_users(&arr);
+            int idx = find_user_index(arr, m, name);
+            ok += idx!=-1 && strcmp(arr[idx].hash, hash)==0;
+            free(arr);
+        }
+        double lin = (now_sec()-t0)/lin_iters;
+        int idx_iters = 20000;
+        t0 = now_sec();
+        for(int i=0;i<idx_iters;i++){
+            snprintf(name, sizeof name, "user%07d", rand()%n);
+            sha256_hex("secret", hash);
+            User u;
+            ok += db_find_user(name, &u) && strcmp(u.hash, hash)==0;
+        }
+        ix = (now_sec()-t0)/idx_iters;
+        printf("%9d %17.1f %17.2f %14.3f\n", n, lin*1e6, ix*1e6, build);
+        if(ok != lin_iters+idx_iters) printf("  warning: %d of %d logins failed\n", lin_iters+idx_iters-ok, lin_iters+idx_iters);
+    }
+    char hash[HASH_FIELD];
+    password_hash("secret", (uint32_t)kdf_iterations, hash);
+    int kdf_iters = 5, ok = 0;
+    double t0 = now_sec();
+    for(int i=0;i<kdf_iters;i++) ok += password_verify("secret", hash);
+    double kdf = (now_sec()-t0)/kdf_iters;
+    printf("full login at %d users: %.2f ms (index lookup + %d-iteration KDF %.2f ms)\n",
+           sizes[2], (ix + kdf)*1e3, kdf_iterations, kdf*1e3);
+    if(ok != kdf_iters) printf("  warning: %d of %d password checks failed\n", kdf_iters-ok, kdf_iters);
+    bench_use_db(BENCH_DB);
+    strcpy(users_db_path, saved);
+}
+
+/* Cost of one game-end stat update: full users.db rewrite vs. journal append
+   (journal numbers include the periodic compactions). */
+void bench_stats(void){
+    int sizes[] = {1000, 100000, 1000000};
+    char saved[256]; strcpy(saved, users_db_path);
+    srand(12345);
+    printf("%9s %18s %18s\n", "users", "rewrite us/update", "journal us/update");
+    for(int s=0;s<3;s++){
+        int n = sizes[s];
+        bench_use_db(BENCH_DB);
+        bench_make_users(n);
+        char name[MAX_USER];
+        int rw_iters = n>=1000000 ? 3 : n>=100000 ? 20 : 1000;
+        double t0 = now_sec();
+        for(int i=0;i<rw_iters;i++){
+            snprintf(name, sizeof name, "user%07d", rand()%n);
+            User *arr; int m = load_users(&arr);
+            int idx = find_user_index(arr, m, name);
+            if(idx!=-1){ arr[idx].games_played++; arr[idx].games_won++; save_users(arr, m); }
+            free(arr);
+        }
+        double rw = (now_sec()-t0)/rw_iters;
+        int j_iters = 20000;
+        t0 = now_sec();
+        for(int i=0;i<j_iters;i++){
+            snprintf(name, sizeof name, "user%07d", rand()%n);
+            increment_games_played(name, 1);
+        }
+        double jn = (now_sec()-t0)/j_iters;
+        printf("%9d %18.1f %18.2f\n", n, rw*1e6, jn*1e6);
+    }
+    bench_use_db(BENCH_DB);
+    strcpy(users_db_path, saved);
+}
+
+/* The original engine: byte-at-a-time update, portable transform and
+   sprintf formatting. Kept as the baseline for bench_sha256(). */
+void sha256_ref_hex(const uint8_t *data, size_t len, char out_hex[HASH_HEX]){
+    SHA256_CTX ctx;
+    uint8_t hash[32];
+    void (*saved)(uint32_t*, const uint8_t*, size_t) = sha256_compress;
+    sha256_compress = sha256_compress_generic;
+    sha256_init(&ctx);
+    for(size_t i=0;i<len;i++){
+        ctx.data[ctx.datalen++] = data[i];
+        if(ctx.datalen==64){ sha256_compress_generic(ctx.state, ctx.data, 1); ctx.bitlen += 512; ctx.datalen = 0; }
+    }
+    sha256_final(&ctx, hash);
+    sha256_compress = saved;
+    for(int i=0;i<32;i++) sprintf(out_hex + i*2, "%02x", hash[i]);
+    out_hex[64]=0;
+}
+
+void bench_sha256(void){
+    typedef void (*CompressFn)(uint32_t*, const uint8_t*, size_t);
+    const char *names[2] = {"portable", "sha-ni"};
+    CompressFn fns[2] = {sha256_compress_generic, NULL};
+#ifdef CPG_X86
+    if(cpu_has_shani()) fns[1] = sha256_compress_shani;
+#endif
+    printf("CPU: sha-ni=%s avx2=%s\n", cpu_has_shani()?"yes":"no", cpu_has_avx2()?"yes":"no");
+
+    char ref[HASH_HEX], hex[HASH_HEX];
+    sha256_hex("abc", hex);
+    printf("sha256(\"abc\") = %s %s\n", hex,
+           strcmp(hex, "ba7816bf8f01cfea414140de5dae2223b00361a396177a9cb410ff61f20015ad")==0 ? "(ok)" : "(MISMATCH)");
+
+    /* Bulk throughput on one large buffer. */
+    size_t big = 64u<<20;
+    uint8_t *buf = malloc(big);
+    if(!buf) return;
+    for(size_t i=0;i<big;i++) buf[i] = (uint8_t)(i*131 + (i>>9));
+    double t0 = now_sec();
+    sha256_ref_hex(buf, big, ref);
+    printf("%-26s %10.1f MB/s\n", "bulk: original", big/1e6/(now_sec()-t0));
+    for(int v=0;v<2;v++){
+        if(!fns[v]) continue;
+        sha256_compress = fns[v];
+        t0 = now_sec();
+        uint8_t d[32]; sha256(buf, big, d); hex_encode(d, 32, hex);
+        printf("bulk: %-20s %10.1f MB/s %s\n", names[v], big/1e6/(now_sec()-t0), strcmp(hex, ref)==0 ? "" : "(MISMATCH)");
+    }
+
+    /* Many short messages, password-sized and one block each. */
+    enum { NMSG = 1<<20 };
+    size_t msglen[2] = {16, 200};
+    const uint8_t **msgs = malloc(NMSG * sizeof *msgs);
+    size_t *lens = malloc(NMSG * sizeof *lens);
+    uint8_t (*dig)[32] = malloc(NMSG * sizeof *dig);
+    for(int m=0;m<2;m++){
+        size_t L = msglen[m];
+        for(size_t i=0;i<NMSG;i++){ msgs[i] = buf + (i*L) % (big - L); lens[i] = L; }
+        printf("-- %zu-byte messages --\n", L);
+        int iters = NMSG/8;
+        t0 = now_sec();
+        for(int i=0;i<iters;i++) sha256_ref_hex(msgs[i], L, ref);
+        double dt = now_sec()-t0;
+        printf("%-26s %10.0f hashes/s %8.1f MB/s\n", "original (hex)", iters/dt, iters*(double)L/1e6/dt);
+        for(int v=0;v<2;v++){
+            if(!fns[v]) continue;
+            sha256_compress = fns[v];
+            t0 = now_sec();
+            for(size_t i=0;i<NMSG;i++) sha256(msgs[i], lens[i], dig[i]);
+            dt = now_sec()-t0;
+            printf("%-26s %10.0f hashes/s %8.1f MB/s\n", names[v], NMSG/dt, NMSG*(double)L/1e6/dt);
+        }
+#ifdef CPG_X86
+        if(cpu_has_avx2()){
+            t0 = now_sec();
+            for(size_t i=0;i<NMSG;i+=8) sha256_many_x8(msgs + i, lens + i, 8, dig + i);
+            dt = now_sec()-t0;
+            int bad = 0;
+            sha256_compress = sha256_compress_generic;
+            for(size_t i=0;i<NMSG;i+=4099){ uint8_t d[32]; sha256(msgs[i], lens[i], d); bad += memcmp(d, dig[i], 32)!=0; }
+            printf("%-26s %10.0f hashes/s %8.1f MB/s %s\n", "avx2 x8 multi-buffer", NMSG/dt, NMSG*(double)L/1e6/dt, bad ? "(MISMATCH)" : "");
+        }
+#endif
+        sha256_select();
+        t0 = now_sec();
+        sha256_many(msgs, lens, NMSG, dig);
+        dt = now_sec()-t0;
+        printf("%-26s %10.0f hashes/s %8.1f MB/s\n", "sha256_many (dispatched)", NMSG/dt, NMSG*(double)L/1e6/dt);
+    }
+    sha256_select();
+    free(msgs); free(lens); free(dig); free(buf);
+}
+
+/* Reports PBKDF2 iterations/sec and the cost that fits a login latency
+   budget. Set the chosen cost with CPLAYGROUND_KDF_ITER. */
+void tune_kdf(int budget_ms){
+    uint8_t dk[32];
+    char hex[65];
+    pbkdf2_sha256((const uint8_t*)"password", 8, (const uint8_t*)"salt", 4, 4096, dk, 32);
+    hex_encode(dk, 32, hex);
+    printf("PBKDF2 self-test: %s\n",
+           strcmp(hex, "c5e478d59288c841aa530db6845c4c8d962893a001ce4e11a4963873aa98134a")==0 ? "ok" : "FAILED");
+
+    uint32_t iters = 1u<<20;
+    uint8_t salt[KDF_SALT_BYTES] = {0};
+    double t0 = now_sec();
+    pbkdf2_sha256((const uint8_t*)"correct horse", 13, salt, sizeof salt, iters, dk, 32);
+    double rate = iters / (now_sec()-t0);
+
+    /* Textbook loop for comparison: full HMAC (pads rehashed) per iteration. */
+    uint32_t naive_iters = 1u<<17;
+    uint8_t u[32];
+    memset(u, 0, sizeof u);
+    t0 = now_sec();
+    for(uint32_t i=0;i<naive_iters;i++){
+        HmacKey k;
+        hmac_sha256_key(&k, (const uint8_t*)"correct horse", 13);
+        hmac_sha256(&k, u, 32, u);
+    }
+    double naive = naive_iters / (now_sec()-t0);
+
+    printf("iterations/sec: %.0f with precomputed pads, %.0f recomputing pads\n", rate, naive);
+    printf("current cost %d iterations = %.1f ms per login\n", kdf_iterations, kdf_iterations / rate * 1e3);
+    uint32_t fit = (uint32_t)(rate * budget_ms / 1e3);
+    printf("cost for a %d ms budget: %u iterations (CPLAYGROUND_KDF_ITER=%u)\n", budget_ms, fit, fit);
+}
+
+/* Startup time, lookup latency and peak RSS for the text and binary formats,
+   each measured in a fresh child process. */
+void bench_dbformat(int n){
+#ifndef _WIN32
+    const char *paths[2] = {BENCH_DB, DATA_DIR "/bench-users.bin"};
+    char saved[256]; strcpy(saved, users_db_path);
+    bench_use_db(paths[1]);
+    bench_use_db(paths[0]);
+    bench_make_users(n);
+    printf("Converting %d users to binary...\n", n);
+    User *arr; int m = load_users(&arr);
+    strcpy(users_db_path, paths[1]);
+    save_users_as(arr, m, 1);
+    free(arr);
+    strcpy(users_db_path, paths[0]);
+    idx_rebuild();
+    printf("%-7s %9s %12s %14s %15s %17s\n", "format", "file MB", "startup ms", "RSS MB (open)", "lookup us", "RSS MB (lookups)");
+    for(int b=0;b<2;b++){
+        struct stat st;
+        stat(paths[b], &st);
+        fflush(stdout);
+        pid_t pid = fork();
+        if(pid == 0){
+            strcpy(users_db_path, paths[b]);
+            double t0 = now_sec();
+            User *all = NULL;
+            if(b) bin_open(); else load_users(&all);
+            double startup = now_sec()-t0;
+            struct rusage ru;
+            getrusage(RUSAGE_SELF, &ru);
+            double rss_open = ru.ru_maxrss/1024.0;
+            srand(777);
+            int iters = 10000, ok = 0;
+            char name[MAX_USER];
+            t0 = now_sec();
+            for(int i=0;i<iters;i++){
+                User u;
+                snprintf(name, sizeof name, "user%07d", rand()%n);
+                ok += db_find_user(name, &u);
+            }
+            double lookup = (now_sec()-t0)/iters;
+            getrusage(RUSAGE_SELF, &ru);
+            printf("%-7s %9.1f %12.2f %14.1f %15.2f %17.1f%s\n", b ? "binary" : "text", st.st_size/1e6, startup*1e3,
+                   rss_open, lookup*1e6, ru.ru_maxrss/1024.0, ok==iters ? "" : "  (lookups failed)");
+            fflush(stdout);
+            free(all);
+            _exit(0);
+        }
+        if(pid > 0) waitpid(pid, NULL, 0);
+    }
+    bench_use_db(paths[1]);
+    bench_use_db(paths[0]);
+    strcpy(users_db_path, saved);
+#else
+    (void)n;
+    printf("dbformat benchmark needs fork(); not available on this platform.\n");
+#endif
+}
+
+/* The original text loader (fgets + sscanf + doubling realloc), kept as the
+   baseline for bench_parse(). */
+int load_users_sscanf(User **arr_out){
+    FILE *f = fopen(users_db_path, "r");
     if(!f){ *arr_out = NULL; return 0; }
     User *arr = NULL; int cap=0, n=0;
     char line[512];
     while(fgets(line, sizeof line, f)){
-        char user[MAX_USER], hash[HASH_HEX], last_login[32];
+        char user[MAX_USER], hash[HASH_FIELD], last_login[32];
         int gp=0, gw=0, q=0;
-        int items = sscanf(line, "%63s %64s %d %d %d %31s", user, hash, &gp, &gw, &q, last_login);
+        if(line[0]=='#') continue;
+        int items = sscanf(line, "%63s %127s %d %d %d %31s", user, hash, &gp, &gw, &q, last_login);
         if(items < 2) continue;
         User u;
         memset(&u,0,sizeof u);
@@ -178,7 +6527,6 @@ int load_users(User **arr_out){
         u.games_won = (items>=4)?gw:0;
         u.quizzes = (items>=5)?q:0;
         if(items>=6) strncpy(u.last_login, last_login, sizeof u.last_login-1);
-        else u.last_login[0]='\0';
         if(n+1 > cap){ cap = cap?cap*2:8; arr = realloc(arr, cap * sizeof(User)); }
         arr[n++] = u;
     }
@@ -187,404 +6535,1135 @@ int load_users(User **arr_out){
     return n;
 }
 
-int save_users(User *arr, int n){
+/* Text users.db parse throughput, original loader vs. load_users(). */
+void bench_parse(int n){
+    char saved[256]; strcpy(saved, users_db_path);
+    bench_use_db(BENCH_DB);
+    bench_make_users(n);
+    User *warm; int m = load_users(&warm);    /* rewrite via save_users() so the input is its exact output */
+    save_users(warm, m);
+    free(warm);
+    struct stat st;
+    stat(users_db_path, &st);
+    double mb = st.st_size / 1e6;
+    User *a, *b;
+    double t0 = now_sec();
+    int na = load_users_sscanf(&a);
+    double ta = now_sec()-t0;
+    t0 = now_sec();
+    int nb = load_users(&b);
+    double tb = now_sec()-t0;
+    int diff = na != nb;
+    for(int i=0;i<na && !diff;i++)
+        diff = strcmp(a[i].username, b[i].username) || strcmp(a[i].hash, b[i].hash) || strcmp(a[i].last_login, b[i].last_login) ||
+               a[i].games_played != b[i].games_played || a[i].games_won != b[i].games_won || a[i].quizzes != b[i].quizzes;
+    printf("%d users, %.1f MB\n", n, mb);
+    printf("%-22s %8.1f ms %8.1f MB/s\n", "fgets + sscanf", ta*1e3, mb/ta);
+    printf("%-22s %8.1f ms %8.1f MB/s\n", "mmap + memchr scanner", tb*1e3, mb/tb);
+    printf("results %s\n", diff ? "DIFFER" : "identical");
+    free(a); free(b);
+    bench_use_db(BENCH_DB);
+    strcpy(users_db_path, saved);
+}
+
+/* cplayground --convert text|binary [in] [out]: rewrites in (default
+   users.db, journal folded in) in the requested format to out (default in). */
+int convert_db(int argc, char **argv){
+    if(argc < 3 || (strcmp(argv[2],"text")!=0 && strcmp(argv[2],"binary")!=0)){
+        printf("Usage: %s --convert text|binary [in] [out]\n", argv[0]);
+        return 1;
+    }
+    int binary = strcmp(argv[2],"binary")==0;
+    const char *in = argc>=4 ? argv[3] : USERS_DB, *out = argc>=5 ? argv[4] : in;
+    strncpy(users_db_path, in, sizeof users_db_path-1);
+    User *arr; int n = load_users(&arr);
+    if(n==0 && !arr){ struct stat st; if(stat(in, &st)!=0){ printf("Cannot read %s.\n", in); return 1; } }
+    strncpy(users_db_path, out, sizeof users_db_path-1);
+    int ok = save_users_as(arr, n, binary);
+    free(arr);
+    printf(ok ? "Wrote %d users to %s (%s).\n" : "Conversion of %d users to %s (%s) failed.\n", n, out, argv[2]);
+    return ok ? 0 : 1;
+}
+
+/* Load generator for --serve: runs the server in-process on a scratch DB and
+   drives it with concurrent clients. Each session signs up a fresh user,
+   logs in and takes the quiz, then logs in as a shared user and takes the
+   quiz again, so the shared user's quiz count must equal the session count
+   (no lost updates across workers). */
+#ifdef __linux__
+typedef struct {
+    const char *path;
+    int first, count, failed;
+    double *lat;
+} BenchClient;
+
+void *bench_server_client(void *arg){
+    BenchClient *c = arg;
+    const char *quiz = "2\n4\nprintf\n&\nstdlib.h\ndo-while\n0\n0\n0\n";
+    char script[512], out[16384];
+    struct sockaddr_un sa;
+    memset(&sa, 0, sizeof sa);
+    sa.sun_family = AF_UNIX;
+    strcpy(sa.sun_path, c->path);
+    for(int i=0;i<c->count;i++){
+        int id = c->first + i;
+        int len = snprintf(script, sizeof script, "1\nsrv%07d\npw\ny\nsrv%07d\npw\n%s2\nshared\npw\n%s0\n", id, id, quiz, quiz);
+        double t0 = now_sec();
+        int fd = socket(AF_UNIX, SOCK_STREAM, 0), ok = 0;
+        if(fd >= 0 && connect(fd, (struct sockaddr*)&sa, sizeof sa) == 0 && write(fd, script, len) == len){
+            shutdown(fd, SHUT_WR);
+            size_t got = 0; ssize_t r;
+            while(got < sizeof out - 1 && (r = read(fd, out + got, sizeof out - 1 - got)) > 0) got += r;
+            out[got] = '\0';
+            /* the transcript must show two perfect quizzes and the goodbye */
+            int scores = 0;
+            for(char *p = out; (p = strstr(p, "scored 5/5")); p++) scores++;
+            ok = scores == 2 && strstr(out, "Bye.") != NULL;
+        }
+        if(fd >= 0) close(fd);
+        c->lat[i] = now_sec() - t0;
+        if(!ok) c->failed++;
+    }
+    return NULL;
+}
+
+void *bench_server_loop(void *arg){ serve_loop(arg); return NULL; }
+
+void bench_server(int sessions, int conc){
+    if(conc < 1) conc = 1;
+    if(sessions < conc) sessions = conc;
+    char saved[256]; strcpy(saved, users_db_path);
+    int saved_iter = kdf_iterations;
+    kdf_iterations = 1000;      /* measure the server, not the KDF */
+    bench_use_db(BENCH_DB);
     ensure_data_dir();
-    FILE *f = fopen(USERS_DB ".tmp", "w");
-    if(!f) return 0;
-    for(int i=0;i<n;i++){
-        fprintf(f, "%s %s %d %d %d %s\n",
-                arr[i].username,
-                arr[i].hash,
-                arr[i].games_played,
-                arr[i].games_won,
-                arr[i].quizzes,
-                arr[i].last_login[0]?arr[i].last_login:"-");
+    char hash[HASH_FIELD];
+    password_hash("pw", (uint32_t)kdf_iterations, hash);
+    User u; memset(&u, 0, sizeof u);
+    strcpy(u.username, "shared"); strcpy(u.hash, hash); u.last_login[0] = '-';
+    save_users(&u, 1);
+
+    const char *path = DATA_DIR "/bench.sock";
+    Server s;
+    pthread_t *th = malloc(conc * sizeof *th), loop, *ct = malloc(conc * sizeof *ct);
+    if(!th || !ct || !serve_start(&s, th, path, conc)){ free(th); free(ct); return; }
+    pthread_create(&loop, NULL, bench_server_loop, &s);
+
+    BenchClient *cl = calloc(conc, sizeof *cl);
+    double *lat = malloc(sessions * sizeof *lat);
+    int per = sessions / conc, first = 0;
+    double t0 = now_sec();
+    for(int i=0;i<conc;i++){
+        cl[i].path = path;
+        cl[i].first = first;
+        cl[i].count = per + (i < sessions % conc);
+        cl[i].lat = lat + first;
+        first += cl[i].count;
+        pthread_create(&ct[i], NULL, bench_server_client, &cl[i]);
     }
-    fclose(f);
-    remove(USERS_DB);
-    rename(USERS_DB ".tmp", USERS_DB);
-    return 1;
+    int failed = 0;
+    for(int i=0;i<conc;i++){ pthread_join(ct[i], NULL); failed += cl[i].failed; }
+    double wall = now_sec() - t0;
+    s.stop = 1;
+    pthread_join(loop, NULL);
+    serve_shutdown(&s, th);
+    unlink(path);
+
+    qsort(lat, sessions, sizeof *lat, cmp_double);
+    User sh; int quizzes = db_find_user("shared", &sh) ? sh.quizzes : -1;
+    User *arr; int n = load_users(&arr); free(arr);
+    printf("%d sessions, %d concurrent: %.0f sessions/s, p50 %.2f ms, p99 %.2f ms\n",
+           sessions, conc, sessions / wall, percentile(lat, sessions, 50)*1e3, percentile(lat, sessions, 99)*1e3);
+    printf("users %d (expected %d), shared quizzes %d (expected %d), failed sessions %d\n",
+           n, sessions+1, quizzes, sessions, failed);
+    free(lat); free(cl); free(th); free(ct);
+    bench_use_db(BENCH_DB);
+    strcpy(users_db_path, saved);
+    kdf_iterations = saved_iter;
 }
+#else
+void bench_server(int sessions, int conc){ (void)sessions; (void)conc; printf("server bench requires Linux.\n"); }
+#endif
 
-int find_user_index(User *arr, int n, const char *username){
-    if(!arr) return -1;
-    for(int i=0;i<n;i++) if(strcmp(arr[i].username, username)==0) return i;
+/* The original char-board AI (win, else block, else lowest cell), kept as
+   the baseline for the tic-tac-toe bench. */
+int ttt_ref_winner(const char *b){
+    static const int lines[8][3] = {{0,1,2},{3,4,5},{6,7,8},{0,3,6},{1,4,7},{2,5,8},{0,4,8},{2,4,6}};
+    for(int k=0;k<8;k++){
+        int a=lines[k][0], c=lines[k][1], d=lines[k][2];
+        if(b[a] && b[a]==b[c] && b[c]==b[d]) return b[a]=='X'? -1 : 1;
+    }
+    for(int i=0;i<9;i++) if(!b[i]) return 2;
+    return 0;
+}
+int ttt_ref_move(char *b){
+    for(int p=0;p<9;p++) if(!b[p]){ b[p]='O'; int w = ttt_ref_winner(b)==1; b[p]=0; if(w) return p; }
+    for(int p=0;p<9;p++) if(!b[p]){ b[p]='X'; int w = ttt_ref_winner(b)==-1; b[p]=0; if(w) return p; }
+    for(int p=0;p<9;p++) if(!b[p]) return p;
     return -1;
 }
 
-/* ---------- Auth flows ---------- */
-
-void show_all_users(){
-    User *arr; int n = load_users(&arr);
-    if(n==0){ printf("No users registered.\n"); if(arr) free(arr); return; }
-    printf("\n--- Registered Users ---\n");
-    for(int i=0;i<n;i++){
-        printf("%s | hash=%s | games=%d won=%d quizzes=%d last=%s\n",
-               arr[i].username,
-               arr[i].hash,
-               arr[i].games_played,
-               arr[i].games_won,
-               arr[i].quizzes,
-               arr[i].last_login[0]?arr[i].last_login:"-");
+/* Counts X wins over every possible line of X play against the table AI. */
+long ttt_exhaustive(TttBoard b, long *games){
+    if(ttt_is_win[b.x]) { (*games)++; return 1; }
+    if(ttt_is_win[b.o] || (b.x|b.o) == TTT_FULL){ (*games)++; return 0; }
+    long xw = 0;
+    for(int m=0;m<9;m++){
+        if((b.x|b.o) >> m & 1) continue;
+        TttBoard c = b;
+        c.x |= 1 << m;
+        if(!ttt_is_win[c.x] && (c.x|c.o) != TTT_FULL) c.o |= 1 << ttt_best[ttt_index(c)];
+        xw += ttt_exhaustive(c, games);
     }
-    free(arr);
+    return xw;
 }
 
-int signup_flow(){
-    char username[64], password[128], hash[HASH_HEX];
-    read_line("Choose a username: ", username, sizeof username);
-    if(strlen(username)==0){ printf("Username cannot be empty.\n"); return 0; }
-    read_line("Choose a password: ", password, sizeof password);
-    if(strlen(password)==0){ printf("Password cannot be empty.\n"); return 0; }
-    sha256_hex(password, hash);
-    User *arr; int n = load_users(&arr);
-    int idx = find_user_index(arr, n, username);
-    if(idx!=-1){ printf("User already exists.\n"); if(arr) free(arr); return 0; }
-    User u; memset(&u,0,sizeof u);
-    strncpy(u.username, username, sizeof u.username-1);
-    strncpy(u.hash, hash, sizeof u.hash-1);
-    u.games_played = 0; u.games_won = 0; u.quizzes = 0; u.last_login[0]='-';
-    User *newarr = realloc(arr, (n+1)*sizeof(User));
-    if(!newarr){ printf("Memory error.\n"); if(arr) free(arr); return 0; }
-    newarr[n] = u; n++;
-    if(!save_users(newarr, n)){ printf("Error saving user.\n"); free(newarr); return 0; }
-    free(newarr);
-    printf("Signup successful! You can now log in.\n");
-    return 1;
-}
+/* Self-play against a random X: games/sec and results for the original AI
+   and the table AI, plus an exhaustive check that the table AI never loses. */
+void bench_ttt(int games){
+    double t0 = now_sec();
+    int reps = 100;
+    for(int i=0;i<reps;i++) ttt_init();
+    double build = (now_sec()-t0)/reps;
+    int reachable = 0;
+    for(int i=0;i<TTT_POSITIONS;i++) reachable += ttt_best[i] != -2;
+    printf("perfect-play table: %d reachable positions, built in %.1f us\n", reachable, build*1e6);
+    long all = 0, xw = ttt_exhaustive((TttBoard){0, 0}, &all);
+    printf("exhaustive: %ld X move sequences, X wins %ld\n", all, xw);
 
-int login_flow(char *out_username){
-    char username[64], password[128], hash[HASH_HEX];
-    read_line("Enter username: ", username, sizeof username);
-    read_line("Enter password: ", password, sizeof password);
-    sha256_hex(password, hash);
-    User *arr; int n = load_users(&arr);
-    if(n==0){ printf("No users. Please sign up first.\n"); if(arr) free(arr); return 0; }
-    int idx = find_user_index(arr, n, username);
-    if(idx==-1){ printf("User not found.\n"); free(arr); return 0; }
-    if(strcmp(arr[idx].hash, hash)!=0){ printf("Authentication failed.\n"); free(arr); return 0; }
-    now_iso(arr[idx].last_login, sizeof arr[idx].last_login);
-    save_users(arr, n);
-    free(arr);
-    if(out_username) strncpy(out_username, username, MAX_USER-1);
-    printf("Login successful. Welcome, %s!\n", username);
-    return 1;
+    uint32_t seed = 12345;
+    printf("%-10s %14s %8s %8s %8s\n", "AI", "games/s", "O wins", "draws", "X wins");
+    for(int ai=0; ai<2; ai++){
+        int res[3] = {0,0,0};   /* O win, draw, X win */
+        t0 = now_sec();
+        for(int g=0; g<games; g++){
+            char cb[9] = {0};
+            TttBoard b = {0, 0};
+            int w = 2;
+            for(int turn=0; w==2; turn^=1){
+                int m;
+                if(turn==0){
+                    uint16_t free_cells = ~(b.x|b.o) & TTT_FULL;
+                    seed ^= seed << 13; seed ^= seed >> 17; seed ^= seed << 5;
+                    int k = seed % ttt_popcount[free_cells];
+                    for(m=0; ; m++) if(free_cells >> m & 1 && k-- == 0) break;
+                    b.x |= 1 << m; cb[m] = 'X';
+                } else {
+                    m = ai ? ttt_best[ttt_index(b)] : ttt_ref_move(cb);
+                    b.o |= 1 << m; cb[m] = 'O';
+                }
+                if(ai) w = ttt_is_win[b.x] ? -1 : ttt_is_win[b.o] ? 1 : (b.x|b.o)==TTT_FULL ? 0 : 2;
+                else w = ttt_ref_winner(cb);
+            }
+            res[w==1 ? 0 : w==0 ? 1 : 2]++;
+        }
+        double t = now_sec()-t0;
+        printf("%-10s %14.0f %8d %8d %8d\n", ai ? "table" : "one-ply", games/t, res[0], res[1], res[2]);
+    }
 }
 
-/* ---------- Profile & Stats ---------- */
-void show_profile(const char *username){
-    User *arr; int n = load_users(&arr);
-    if(n==0){ printf("No profile found.\n"); if(arr) free(arr); return; }
-    int idx = find_user_index(arr, n, username);
-    if(idx==-1){ printf("Profile not found.\n"); free(arr); return; }
-    printf("\n--- Profile: %s ---\n", username);
-    printf("Games played: %d\nGames won: %d\nQuizzes completed: %d\nLast login: %s\n",
-           arr[idx].games_played, arr[idx].games_won, arr[idx].quizzes, arr[idx].last_login[0]?arr[idx].last_login:"-");
-    free(arr);
+/* Search scaling for the k-in-a-row engine: a fixed time per move on an
+   N x N middle-game position at 1, 2, 4, ... threads, reporting the depth
+   reached and nodes/s. A full-depth 3x3 search is checked against the
+   tic-tac-toe table first. */
+void bench_gomoku(int ms, int n, int k){
+    GkGeom *g = malloc(sizeof *g);
+    GkBoard *b = malloc(sizeof *b);
+    gk_geom_init(g, 3, 3);
+    pthread_once(&ttt_once, ttt_init);
+    GkResult r;
+    int agree = 0; long long nodes = 0;
+    for(int m=0;m<9;m++){
+        gk_board_init(b, g);
+        gk_play(b, m);
+        r = gk_search(b, 1, 9, 0);
+        int table = ttt_score[ttt_index((TttBoard){(uint16_t)(1 << m), 0})];
+        agree += (r.score > 0) == (table > 0) && (r.score < 0) == (table < 0);
+        nodes += r.nodes;
+    }
+    printf("3x3 full-depth search agrees with the tic-tac-toe table on %d/9 openings (%lld nodes)\n", agree, nodes);
+
+    if(n < 3 || n > GK_MAX_N) n = 15;
+    if(k < 3 || k > n) k = n < 5 ? n : 5;
+    gk_geom_init(g, n, k);
+    gk_board_init(b, g);
+    int c = n/2, opening[][2] = {{0,0},{1,1},{0,1},{-1,-1},{1,0},{0,-1},{-1,1},{2,2}};
+    for(int i=0;i<8;i++){
+        int rr = c + opening[i][0], cc = c + opening[i][1];
+        if(rr >= 0 && rr < n && cc >= 0 && cc < n && !b->cell[rr*n+cc]) gk_play(b, rr*n+cc);
+    }
+    int maxt = cpu_count() > 8 ? cpu_count() : 8;
+    printf("%dx%d, k=%d, %d stones, %d ms per move, %d CPUs\n", n, n, k, b->nmoves, ms, cpu_count());
+    printf("%8s %6s %12s %12s %6s\n", "threads", "depth", "nodes", "nodes/s", "move");
+    for(int t=1; t<=maxt; t*=2){
+        memset(gk_tt, 0, (gk_tt_mask + 1) * sizeof(GkTTEntry));
+        r = gk_search(b, t, 64, ms);
+        printf("%8d %6d %12lld %12.0f %3d,%-2d\n", t, r.depth, r.nodes, r.nodes/r.secs, r.move/n, r.move%n);
+    }
+    free(b); free(g);
 }
 
-void increment_games_played(const char *username, int won){
-    User *arr; int n = load_users(&arr);
-    if(n==0){ if(arr) free(arr); return; }
-    int idx = find_user_index(arr, n, username);
-    if(idx!=-1){
-        arr[idx].games_played++;
-        if(won) arr[idx].games_won++;
-        save_users(arr, n);
+/* Evals/s for a few expressions: the naive parse-and-evaluate interpreter,
+   compiled bytecode one x at a time, and batched range evaluation over n
+   points (streamed through a 1M-point buffer). Results are cross-checked. */
+void bench_expr(size_t n){
+    const char *exprs[] = {
+        "x*x - 3*x + 2",
+        "(x + 1) / (x*x + 1) - 2*x",
+        "sqrt(x) * 0.5 + abs(x - 5e7)",
+        "sin(x/1e6) * exp(-x/1e8) + cos(x/1e6)^2",
+    };
+    const size_t chunk = 1 << 20, naive_n = 1000000;
+    double *out = malloc(chunk * sizeof(double));
+    if(!out){ printf("Out of memory.\n"); return; }
+    printf("%-42s %12s %12s %12s %8s\n", "expression", "naive M/s", "bytecode M/s", "range M/s", "max err");
+    for(size_t e=0; e<sizeof exprs/sizeof exprs[0]; e++){
+        ExprProg prog; char err[64];
+        if(!expr_compile(exprs[e], NULL, &prog, err, sizeof err)){ printf("%s: %s\n", exprs[e], err); continue; }
+        double step = 1.0, sink = 0;
+        double t0 = now_sec();
+        for(size_t i=0;i<naive_n;i++) sink += expr_eval_naive(exprs[e], NULL, i*step, NULL, 0);
+        double naive = now_sec() - t0;
+        t0 = now_sec();
+        for(size_t i=0;i<naive_n;i++) sink -= expr_run(&prog, i*step);
+        double byte = now_sec() - t0;
+        t0 = now_sec();
+        for(size_t base=0; base<n; base+=chunk){
+            size_t w = n-base < chunk ? n-base : chunk;
+            if(!expr_eval_range(&prog, base*step, step, w, out)){ printf("Out of memory.\n"); free(out); return; }
+            sink += out[w-1];
+        }
+        double range = now_sec() - t0;
+        double maxerr = 0;
+        if(!expr_eval_range(&prog, 0, step, chunk < n ? chunk : n, out)){ printf("Out of memory.\n"); free(out); return; }
+        for(size_t i=0; i<(chunk < n ? chunk : n); i+=997){
+            double ref = expr_eval_naive(exprs[e], NULL, i*step, NULL, 0);
+            double d = fabs(out[i] - ref) / (fabs(ref) > 1 ? fabs(ref) : 1);
+            if(d > maxerr) maxerr = d;
+        }
+        printf("%-42s %12.1f %12.1f %12.1f %8.1e\n", exprs[e], naive_n/naive/1e6, naive_n/byte/1e6, n/range/1e6, maxerr);
+        if(sink == 12345.678) printf(" ");    /* keep the loops live */
     }
-    free(arr);
+    free(out);
 }
-void increment_quiz(const char *username){
-    User *arr; int n = load_users(&arr);
-    if(n==0){ if(arr) free(arr); return; }
-    int idx = find_user_index(arr, n, username);
-    if(idx!=-1){ arr[idx].quizzes++; save_users(arr, n); }
-    free(arr);
+
+/* Replays a script (the built-in one by default) on a scratch DB. The KDF
+   cost is lowered unless CPLAYGROUND_KDF_ITER is set, so the numbers track
+   the platform code rather than password hashing. */
+void bench_replay(int sessions, const char *script_path){
+    MappedFile m = {0};
+    char *builtin = NULL;
+    if(script_path && !map_file(script_path, &m)){ printf("Cannot read script %s.\n", script_path); return; }
+    char saved[256]; strcpy(saved, users_db_path);
+    int saved_iter = kdf_iterations;
+    if(!getenv("CPLAYGROUND_KDF_ITER")) kdf_iterations = 1000;
+    int saved_flush = session_flush_secs;
+    session_flush_secs = -1;
+    bench_use_db(BENCH_DB);
+    if(script_path) replay_run((const char*)m.data, m.size, sessions);
+    else if((builtin = replay_default_script())) replay_run(builtin, strlen(builtin), sessions);
+    else printf("Out of memory.\n");
+    free(builtin);
+    if(script_path) unmap_file(&m);
+    bench_use_db(BENCH_DB);
+    strcpy(users_db_path, saved);
+    kdf_iterations = saved_iter;
+    session_flush_secs = saved_flush;
 }
 
-/* ---------- Games ---------- */
-void game_number_guess(const char *username){
-    srand((unsigned)time(NULL));
-    int target = rand()%100 + 1;
-    printf("\n-- Number Guess (1..100) --\n");
-    int tries=0, guess;
-    char buf[64];
-    while(1){
-        read_line("Your guess (or 'q' to quit): ", buf, sizeof buf);
-        if(buf[0]=='q'){ printf("Quit. The number was %d.\n", target); break; }
-        if(sscanf(buf, "%d", &guess)!=1){ printf("Invalid.\n"); continue; }
-        tries++;
-        if(guess<target) printf("Higher.\n");
-        else if(guess>target) printf("Lower.\n");
-        else { printf("Correct in %d tries!\n", tries); increment_games_played(username, 1); break; }
+/* Tiled GEMM against the naive triple loop for sizes 256..max_n. The naive
+   loop is timed on a sample of rows and extrapolated; the sampled rows also
+   check the tiled result. Then LU/solve, thread scaling and file I/O. */
+void bench_matrix(int max_n, int threads){
+    if(threads <= 0) threads = cpu_count();
+    printf("%6s %12s %12s %14s %10s\n", "n", "naive GF/s", "tiled 1T", "tiled GF/s", "max err");
+    for(int n=256; n<=max_n; n*=2){
+        Matrix A, B, C, N;
+        if(!mat_alloc(&A, n, n) || !mat_alloc(&B, n, n) || !mat_alloc(&N, n, n)){ printf("Out of memory at n=%d\n", n); return; }
+        mat_random(&A, n); mat_random(&B, n * 7 + 1);
+        double flops = 2.0 * n * n * n;
+        int rows = n <= 512 ? n : 64;
+        double t0 = now_sec();
+        mat_mul_naive_rows(&A, &B, &N, 0, rows);
+        double naive = (now_sec() - t0) * n / rows;
+        t0 = now_sec();
+        int ok = mat_mul(&A, &B, &C, 1);
+        double one = now_sec() - t0;
+        mat_free(&C);
+        t0 = now_sec();
+        ok = ok && mat_mul(&A, &B, &C, threads);
+        double par = now_sec() - t0, err = 0;
+        if(!ok){ printf("Out of memory at n=%d\n", n); mat_free(&A); mat_free(&B); mat_free(&N); return; }
+        for(size_t i=0;i<(size_t)rows*n;i++) if(fabs(C.a[i] - N.a[i]) > err) err = fabs(C.a[i] - N.a[i]);
+        printf("%6d %12.2f %12.2f %14.2f %10.1e\n", n, flops/naive/1e9, flops/one/1e9, flops/par/1e9, err);
+        mat_free(&A); mat_free(&B); mat_free(&C); mat_free(&N);
     }
-}
 
-/* Tic-tac-toe (small AI) */
-char ttt_board[9];
-int ttt_lines[8][3] = {{0,1,2},{3,4,5},{6,7,8},{0,3,6},{1,4,7},{2,5,8},{0,4,8},{2,4,6}};
-void ttt_draw(void){
-    printf("\n");
-    for(int r=0;r<3;r++){
-        for(int c=0;c<3;c++){
-            int i=3*r+c; char ch = ttt_board[i]?ttt_board[i]:'0'+i;
-            printf(" %c ", ch);
-            if(c<2) printf("|");
+    int n = max_n < 2048 ? max_n : 2048;
+    Matrix A = {0}, LU = {0};
+    int *perm = malloc(n * sizeof *perm);
+    double *b = malloc(2 * n * sizeof *b), *x = b + n, res = 0;
+    if(!mat_alloc(&A, n, n) || !mat_alloc(&LU, n, n) || !perm || !b){
+        printf("Out of memory at n=%d\n", n);
+        mat_free(&A); mat_free(&LU); free(perm); free(b);
+        return;
+    }
+    mat_random(&A, 99);
+    memcpy(LU.a, A.a, (size_t)n*n*sizeof(double));
+    for(int i=0;i<n;i++) b[i] = i % 7 - 3;
+    double t0 = now_sec();
+    int ok = mat_lu(&LU, perm, threads);
+    double lu = now_sec() - t0;
+    if(ok){
+        mat_lu_solve(&LU, perm, b, x);
+        for(int i=0;i<n;i++){
+            double s = -b[i];
+            for(int j=0;j<n;j++) s += A.a[(size_t)i*n + j] * x[j];
+            if(fabs(s) > res) res = fabs(s);
         }
-        printf("\n");
-        if(r<2) printf("---+---+---\n");
     }
+    printf("LU %dx%d: %.3f s, %.2f GFLOP/s, solve max |Ax-b| = %.1e%s\n", n, n, lu, 2.0/3*n*(double)n*n/lu/1e9, res, ok ? "" : " (singular)");
+    free(perm); free(b); mat_free(&LU);
+
+    printf("GEMM %dx%d thread scaling:", n, n);
+    for(int t=1; t<=threads; t*=2){
+        Matrix C;
+        t0 = now_sec();
+        if(!mat_mul(&A, &A, &C, t)){ printf(" %dT out of memory", t); break; }
+        printf(" %dT %.2f GF/s", t, 2.0*n*(double)n*n/(now_sec()-t0)/1e9);
+        mat_free(&C);
+    }
+    printf("\n");
+
+    const char *path = "data/bench-matrix.bin";
+    Matrix L;
+    double mb = (double)n*n*sizeof(double)/1e6;
+    t0 = now_sec();
+    ok = mat_save(&A, path);
+    double ws = now_sec() - t0;
+    t0 = now_sec();
+    ok = ok && mat_load(&L, path);
+    double rs = now_sec() - t0;
+    if(ok){
+        printf("File %.0f MB: save %.0f MB/s, load %.0f MB/s, round trip %s\n", mb, mb/ws, mb/rs,
+               memcmp(L.a, A.a, (size_t)n*n*sizeof(double)) == 0 ? "exact" : "MISMATCH");
+        mat_free(&L);
+    } else printf("File I/O failed on %s\n", path);
+    remove(path);
+    mat_free(&A);
 }
-int ttt_winner(void){
-    for(int k=0;k<8;k++){
-        int a=ttt_lines[k][0], b=ttt_lines[k][1], c=ttt_lines[k][2];
-        if(ttt_board[a] && ttt_board[a]==ttt_board[b] && ttt_board[b]==ttt_board[c]){
-            return ttt_board[a]=='X'? -1 : 1;
+
+/* Writes n random "a b c" rows (with degenerate, complex and badly
+   conditioned ones mixed in), then times the solve kernels in memory and
+   the full file-to-file stream, and shows peak RSS staying flat. */
+void bench_quadratic(long n){
+    const char *in_path = "data/bench-quad.txt", *out_path = "data/bench-quad.out";
+    ensure_data_dir();
+    FILE *f = fopen(in_path, "w");
+    if(!f){ perror(in_path); return; }
+    uint64_t seed = 2024;
+    for(long i=0;i<n;i++){
+        uint64_t r = splitmix64(&seed);
+        double a = (double)(int)(r % 2001) / 100 - 10, b = (double)(int)(r >> 16 & 0xffff) / 300 - 100, c = (double)(int)(r >> 32 & 0xfff) / 40 - 50;
+        switch(r >> 60){
+        case 0: a = 0; break;
+        case 1: a = 0; b = 0; break;
+        case 2: b = 1e8; c = 1; break;
         }
+        fprintf(f, "%.6g %.6g %.6g\n", a, b, c);
     }
-    for(int i=0;i<9;i++) if(!ttt_board[i]) return 2;
-    return 0;
+    fclose(f);
+
+    /* In-memory kernels on one chunk, repeated. */
+    double *v = malloc(7 * QUAD_CHUNK * sizeof(double));
+    double *a = v, *b = v + QUAD_CHUNK, *c = v + 2*QUAD_CHUNK, *s1 = v + 3*QUAD_CHUNK, *s2 = v + 4*QUAD_CHUNK, *v1 = v + 5*QUAD_CHUNK, *v2 = v + 6*QUAD_CHUNK;
+    unsigned char ks[QUAD_CHUNK], kv[QUAD_CHUNK];
+    seed = 7;
+    for(int i=0;i<QUAD_CHUNK;i++){
+        a[i] = i % 64 == 0 ? 0 : (double)(splitmix64(&seed) % 2001) / 100 - 10;
+        b[i] = (double)(splitmix64(&seed) % 20001) / 100 - 100;
+        c[i] = (double)(splitmix64(&seed) % 2001) / 20 - 50;
+    }
+    /* Rows that overflow b*b or 4ac unscaled, are subnormal, or have a zero root or real part. */
+    static const double edge[][3] = { {1e308, 1e308, 1}, {-1e308, 1e300, 1e308}, {1e200, 0, 1e200}, {1e-300, 3e-300, 1e-300},
+                                      {1e-310, 3e-310, 2e-310}, {1, 0, 1}, {1, 1, 0}, {2, 0, 0} };
+    int nedge = (int)(sizeof edge / sizeof edge[0]);
+    for(int i=0;i<nedge;i++){ a[1+i] = edge[i][0]; b[1+i] = edge[i][1]; c[1+i] = edge[i][2]; }
+    QuadStats st;
+    quad_init();
+    int reps = 2000;
+    double t0 = now_sec();
+    for(int r=0;r<reps;r++) quad_batch_scalar(a, b, c, QUAD_CHUNK, s1, s2, ks);
+    double ts = now_sec() - t0;
+    t0 = now_sec();
+    for(int r=0;r<reps;r++) quad_batch(a, b, c, QUAD_CHUNK, v1, v2, kv);
+    double tv = now_sec() - t0;
+    int mismatch = 0;
+    for(int i=0;i<QUAD_CHUNK;i++)
+        if(ks[i] != kv[i] || (s1[i] != v1[i] && !(isnan(s1[i]) && isnan(v1[i]))) || (s2[i] != v2[i] && !(isnan(s2[i]) && isnan(v2[i])))) mismatch++;
+    int edge_bad = 0;
+    for(int i=1;i<=nedge;i++)
+        for(int k=0;k<2;k++){
+            double x = k ? v2[i] : v1[i];
+            if(!isfinite(x) || (x == 0 && signbit(x))) edge_bad++;
+        }
+    const char *nonfinite[] = { "inf 1 1", "1 nan 1", "1 1 -inf" };
+    for(int i=0;i<3;i++){ char row[16]; double t[3]; strcpy(row, nonfinite[i]); edge_bad += quad_parse(row, t) != -1; }
+    printf("Solve kernel: scalar %.1f M rows/s, %s %.1f M rows/s, %d mismatches, edge rows %s\n", (double)reps*QUAD_CHUNK/ts/1e6,
+           quad_batch == quad_batch_scalar ? "batch (scalar)" : "AVX2", (double)reps*QUAD_CHUNK/tv/1e6, mismatch, edge_bad ? "FAILED" : "ok");
+    free(v);
+
+    /* Cancellation: x^2 + 1e8 x + 1 has a root at -1.00000000000000010e-8. */
+    double naive = (-1e8 + sqrt(1e16 - 4)) / 2, r1, r2;
+    quad_solve(1, 1e8, 1, &r1, &r2);
+    printf("x^2 + 1e8x + 1, small root: textbook %.17g, stable %.17g (exact -1.0000000000000001e-08)\n", naive, r2);
+
+#ifndef _WIN32
+    struct rusage ru;
+    getrusage(RUSAGE_SELF, &ru);
+    long rss0 = ru.ru_maxrss;
+#endif
+    struct stat sb;
+    stat(in_path, &sb);
+    FILE *in = fopen(in_path, "r"), *out = fopen(out_path, "w");
+    t0 = now_sec();
+    int ok = in && out && quad_stream(in, out, &st);
+    double t = now_sec() - t0;
+    if(in) fclose(in);
+    if(out) fclose(out);
+    printf("Stream %.0f MB file -> file: %s", sb.st_size / 1e6, ok ? "" : "FAILED ");
+    quad_print_stats(stdout, &st, t);
+#ifndef _WIN32
+    getrusage(RUSAGE_SELF, &ru);
+    printf("  %.0f MB/s in, peak RSS %ld KB before, %ld KB after\n", sb.st_size / 1e6 / t, rss0, ru.ru_maxrss);
+#else
+    printf("  %.0f MB/s in (peak RSS not available on this platform)\n", sb.st_size / 1e6 / t);
+#endif
+    remove(in_path); remove(out_path);
 }
-int ttt_ai_move(void){
-    for(int p=0;p<9;p++) if(!ttt_board[p]){
-        ttt_board[p]='O';
-        if(ttt_winner()==1){ ttt_board[p]=0; return p; }
-        ttt_board[p]=0;
+
+int bench_cmp_wins(const void *a, const void *b){
+    const User *x = a, *y = b;
+    if(x->games_won != y->games_won) return x->games_won > y->games_won ? -1 : 1;
+    return strcmp(x->username, y->username);
+}
+
+/* Top-10 and rank queries: full load + sort per request vs. the skip-list
+   board, the cost the board adds to each stat update, and a check of both
+   against a from-scratch sort after updates from this process, from a
+   session and from "another process" (records appended behind its back). */
+void bench_leaderboard(int n){
+    char saved[256]; strcpy(saved, users_db_path);
+    bench_use_db(BENCH_DB);
+    bench_make_users(n);
+    LbRow rows[10], me;
+    int total, iters = 5, bad = 0;
+    char name[MAX_USER];
+    /* Records already in the journal when the board is first built. */
+    for(int i=0;i<50;i++){ snprintf(name, sizeof name, "user%07d", i*53 % n); journal_append(name, 6, 5, 0, NULL, NULL); }
+    double t0 = now_sec();
+    for(int i=0;i<iters;i++){
+        User *arr; int m = load_users(&arr);
+        qsort(arr, m, sizeof(User), bench_cmp_wins);
+        free(arr);
     }
-    for(int p=0;p<9;p++) if(!ttt_board[p]){
-        ttt_board[p]='X';
-        if(ttt_winner()==-1){ ttt_board[p]=0; return p; }
-        ttt_board[p]=0;
+    double full = (now_sec() - t0) / iters;
+    t0 = now_sec();
+    lb_top(LB_WINS, 0, 10, rows, &total);
+    double build = now_sec() - t0;
+    for(int i=0;i<50;i++){
+        User du;
+        snprintf(name, sizeof name, "user%07d", i*53 % n);
+        if(!db_find_user(name, &du) || !lb_rank(LB_WINS, name, &me, &total) || me.gp != du.games_played || me.gw != du.games_won) bad++;
     }
-    for(int p=0;p<9;p++) if(!ttt_board[p]) return p;
-    return -1;
-}
-void game_tictactoe(const char *username){
-    memset(ttt_board,0,sizeof ttt_board);
-    printf("\n-- Tic-Tac-Toe: You = X, AI = O --\n");
-    int turn = -1;
-    char buf[32];
-    while(1){
-        ttt_draw();
-        int w = ttt_winner();
-        if(w!=2){
-            if(w==1){ printf("AI wins.\n"); increment_games_played(username, 0); return; }
-            else if(w==-1){ printf("You win!\n"); increment_games_played(username, 1); return; }
-            else { printf("Draw.\n"); increment_games_played(username, 0); return; }
-        }
-        if(turn==-1){
-            read_line("Your move (0-8): ", buf, sizeof buf);
-            int m; if(sscanf(buf, "%d", &m)!=1 || m<0 || m>8 || ttt_board[m]){ printf("Invalid move.\n"); continue; }
-            ttt_board[m]='X'; turn=1;
-        } else {
-            int m = ttt_ai_move();
-            if(m>=0) ttt_board[m]='O';
-            turn=-1;
+    int q = 20000;
+    srand(99);
+    t0 = now_sec();
+    for(int i=0;i<q;i++) lb_top(i % LB_METRICS, 0, 10, rows, &total);
+    double top = (now_sec() - t0) / q;
+    t0 = now_sec();
+    for(int i=0;i<q;i++){ snprintf(name, sizeof name, "user%07d", rand()%n); lb_rank(i % LB_METRICS, name, &me, &total); }
+    double rank = (now_sec() - t0) / q;
+    printf("%d users: full load+sort %.1f ms/query, board build %.1f ms, top-10 %.2f us, my-rank %.2f us\n",
+           n, full*1e3, build*1e3, top*1e6, rank*1e6);
+
+    int u = 20000;
+    t0 = now_sec();
+    for(int i=0;i<u;i++){ snprintf(name, sizeof name, "user%07d", rand()%n); increment_games_played(name, rand()%2); }
+    double upd = (now_sec() - t0) / u;
+    t0 = now_sec();
+    for(int i=0;i<u;i++){ snprintf(name, sizeof name, "user%07d", rand()%n); lb_pending_add(name, 1, 1, 1); lb_pending_add(name, -1, -1, -1); }
+    double pend = (now_sec() - t0) / (2.0*u);
+    printf("stat update via journal + board: %.2f us; in-memory board update: %.2f us\n", upd*1e6, pend*1e6);
+
+    /* Another process appends to the journal without our hooks. */
+    for(int i=0;i<50;i++){
+        char jp[300];
+        snprintf(name, sizeof name, "user%07d", i*37 % n);
+        journal_path(jp, sizeof jp, journal_shard_of(name));
+        FILE *jf = fopen(jp, "a");
+        fseek(jf, 0, SEEK_END);
+        if(ftell(jf) == 0) fprintf(jf, "#gen %ld shards %d\n", read_db_gen(), journal_shards);
+        fprintf(jf, "%s 40 40 40 -\n", name);
+        fclose(jf);
+    }
+    /* A session with unflushed games. */
+    User su;
+    db_find_user("user0000003", &su);
+    session_begin(&su);
+    session_flush_secs = -1;
+    for(int i=0;i<70;i++) increment_games_played("user0000003", 1);
+
+    for(int pass=0; pass<2; pass++){
+        User *arr; int m = load_users(&arr);
+        if(pass == 0) for(int i=0;i<m;i++) if(strcmp(arr[i].username, "user0000003")==0){ arr[i].games_played += 70; arr[i].games_won += 70; }
+        qsort(arr, m, sizeof(User), bench_cmp_wins);
+        int k = lb_top(LB_WINS, 0, 10, rows, &total);
+        for(int i=0;i<k;i++) if(strcmp(rows[i].name, arr[i].username) || rows[i].gw != arr[i].games_won) bad++;
+        for(int i=0;i<200;i++){
+            int j = rand() % m, better = 0;
+            for(int t=0;t<j;t++) better += arr[t].games_won > arr[j].games_won;
+            lb_rank(LB_WINS, arr[j].username, &me, &total);
+            if(me.rank != better + 1) bad++;
         }
+        free(arr);
+        if(pass == 0) session_end();        /* settles the pending games */
     }
+    printf("check vs. full sort (journal before first build, pending session, foreign journal records, settle): %s\n", bad ? "MISMATCH" : "ok");
+    session_flush_secs = SESSION_FLUSH_SECS;
+    bench_use_db(BENCH_DB);
+    strcpy(users_db_path, saved);
 }
 
-void games_menu(const char *username){
-    while(1){
-        printf("\n=== Games ===\n1) Number Guess\n2) Tic-Tac-Toe\n0) Back\nChoose: ");
-        char buf[16]; read_line("", buf, sizeof buf);
-        if(strcmp(buf,"0")==0) return;
-        else if(strcmp(buf,"1")==0) game_number_guess(username);
-        else if(strcmp(buf,"2")==0) game_tictactoe(username);
-        else printf("Invalid.\n");
+int files_equal(const char *a, const char *b){
+    FILE *fa = fopen(a, "rb"), *fb = fopen(b, "rb");
+    int eq = fa && fb;
+    static char ba[1 << 16], bb[1 << 16];
+    while(eq){
+        size_t na = fread(ba, 1, sizeof ba, fa), nb = fread(bb, 1, sizeof bb, fb);
+        if(na != nb || memcmp(ba, bb, na)) eq = 0;
+        if(na == 0) break;
     }
+    if(fa) fclose(fa);
+    if(fb) fclose(fb);
+    return eq;
 }
 
-/* ---------- Tutorials & Quiz ---------- */
-void show_tutorial_topic(const char *topic){
-    if(strcmp(topic,"basics")==0){
-        printf("\n-- Basics --\nVariables, types, printf/scanf, functions.\n");
-    } else if(strcmp(topic,"pointers")==0){
-        printf("\n-- Pointers --\nPointers, & (address), * (dereference), malloc/free.\n");
-    } else if(strcmp(topic,"ds")==0){
-        printf("\n-- Data Structures --\nArrays, linked lists, stacks, queues, trees, graphs basics.\n");
+/* Admin listing: first page, deep pages and prefix pages through the
+   streaming iterator (text and binary), then a full listing streamed vs.
+   load-everything + one printf per user, with peak RSS and an output diff. */
+void bench_listing(int n){
+    char saved[256]; strcpy(saved, users_db_path);
+    bench_use_db(BENCH_DB);
+    bench_make_users(n);
+    for(int i=0;i<100;i++){ char name[MAX_USER]; snprintf(name, sizeof name, "user%07d", i*7 % n); journal_append(name, 2, 1, 1, NULL, NULL); }
+    User *rows = malloc(LIST_PAGE * sizeof(User));
+    const char *out_a = DATA_DIR "/bench-list-stream.txt", *out_b = DATA_DIR "/bench-list-printf.txt";
+    for(int fmt=0; fmt<2; fmt++){
+        if(fmt){ User *arr; int cnt = load_users(&arr); save_users_as(arr, cnt, 1); free(arr); }
+        int iters = 2000;
+        UserCursor cur;
+        double t0 = now_sec();
+        for(int i=0;i<iters;i++){ cur.gen = 0; cur.pos = 0; users_page("", &cur, rows, LIST_PAGE); }
+        double first = (now_sec() - t0) / iters;
+        int pages = 0;
+        cur.gen = 0; cur.pos = 0;
+        t0 = now_sec();
+        while(pages < 2000 && users_page("", &cur, rows, LIST_PAGE) == LIST_PAGE) pages++;
+        double deep = (now_sec() - t0) / pages;
+        char prefix[MAX_USER];
+        snprintf(prefix, sizeof prefix, "user%05d", (n - 1) / 100);     /* near the end of the file */
+        cur.gen = 0; cur.pos = 0;
+        t0 = now_sec();
+        int m = users_page(prefix, &cur, rows, LIST_PAGE);
+        double pre = now_sec() - t0;
+        printf("%s %d users: first page %.1f us, next pages %.1f us each, prefix '%s' page (%d users) %.2f ms\n",
+               fmt ? "binary" : "text  ", n, first*1e6, deep*1e6, prefix, m, pre*1e3);
+        if(fmt) break;
+
+#ifndef _WIN32
+        struct rusage ru;
+        getrusage(RUSAGE_SELF, &ru);
+        long rss0 = ru.ru_maxrss;
+#endif
+        FILE *fa = fopen(out_a, "w");
+        t0 = now_sec();
+        long long total = list_users_stream(fa, "");
+        double stream = now_sec() - t0;
+        fclose(fa);
+#ifndef _WIN32
+        getrusage(RUSAGE_SELF, &ru);
+        long rss1 = ru.ru_maxrss;
+#endif
+        FILE *fb = fopen(out_b, "w"), *saved_out = io_out;
+        io_out = fb;
+        t0 = now_sec();
+        User *arr; int cnt = load_users(&arr);
+        for(int i=0;i<cnt;i++)
+            uprintf("%s | hash=%s | games=%d won=%d quizzes=%d last=%s\n", arr[i].username, arr[i].hash,
+                    arr[i].games_played, arr[i].games_won, arr[i].quizzes, arr[i].last_login[0]?arr[i].last_login:"-");
+        free(arr);
+        double old = now_sec() - t0;
+        io_out = saved_out;
+        fclose(fb);
+#ifndef _WIN32
+        getrusage(RUSAGE_SELF, &ru);
+        printf("full listing of %lld users: streamed %.3f s (+%ld KB peak RSS), load+printf %.3f s (+%ld KB peak RSS), output %s\n",
+               total, stream, rss1 - rss0, old, ru.ru_maxrss - rss1, files_equal(out_a, out_b) ? "identical" : "DIFFERS");
+#else
+        printf("full listing of %lld users: streamed %.3f s, load+printf %.3f s (peak RSS not available on this platform), output %s\n",
+               total, stream, old, files_equal(out_a, out_b) ? "identical" : "DIFFERS");
+#endif
+        remove(out_a); remove(out_b);
     }
+    free(rows);
+    bench_use_db(BENCH_DB);
+    strcpy(users_db_path, saved);
 }
 
-int run_quiz_simple(const char *username){
-    const char *qs[5] = {
-        "Which function prints to stdout? (printf/print)",
-        "Operator to get variable address? (&/*)",
-        "Which header for malloc? (stdlib.h/stdio.h)",
-        "Loop that checks condition at end? (do-while/while)",
-        "What is array indexing base? (0/1)"
-    };
-    const char *ans[5] = {"printf","&","stdlib.h","do-while","0"};
-    int score=0; char buf[128];
-    for(int i=0;i<5;i++){
-        printf("\nQ%d) %s\n> ", i+1, qs[i]);
-        read_line(NULL, buf, sizeof buf);
-        if(strlen(buf)==0){ printf("No answer. Correct: %s\n", ans[i]); continue; }
-        for(char *p=buf; *p; ++p) if(*p>='A' && *p<='Z') *p += 'a'-'A';
-        if(strcmp(buf, ans[i])==0){ printf("Correct.\n"); score++; }
-        else printf("Wrong. Answer: %s\n", ans[i]);
+/* Bulk import of n users (5% already present, 1% repeated in the file) at
+   the given KDF cost, against the per-signup load+save cycle, then an
+   export -> import -> export round trip into a fresh database. */
+void bench_import(int n, int iterations){
+    char saved[256]; strcpy(saved, users_db_path);
+    const char *csv = DATA_DIR "/bench-import.csv", *out_a = DATA_DIR "/bench-export-a.csv", *out_b = DATA_DIR "/bench-export-b.csv";
+    int existing = n / 10, base = n / 20;
+    bench_use_db(BENCH_DB);
+    bench_make_users(existing);
+    FILE *f = fopen(csv, "w");
+    if(!f){ perror(csv); return; }
+    fprintf(f, "username,password\n");
+    for(int i=0;i<n;i++){
+        int id = i % 100 == 99 ? base + i - 1 : base + i;
+        fprintf(f, "user%07d,pw-%d\n", id, id);
     }
-    printf("You scored %d/5\n", score);
-    if(score>0) increment_quiz(username);
-    return score;
-}
+    fclose(f);
 
-void learn_menu(const char *username){
-    while(1){
-        printf("\n=== Learn C ===\n1) Basics\n2) Pointers\n3) Data Structures\n4) Short Quiz\n0) Back\nChoose: ");
-        char buf[16]; read_line("", buf, sizeof buf);
-        if(strcmp(buf,"0")==0) return;
-        if(strcmp(buf,"1")==0) show_tutorial_topic("basics");
-        else if(strcmp(buf,"2")==0) show_tutorial_topic("pointers");
-        else if(strcmp(buf,"3")==0) show_tutorial_topic("ds");
-        else if(strcmp(buf,"4")==0) run_quiz_simple(username);
-        else printf("Invalid.\n");
+    User *arr; int cnt = load_users(&arr);
+    double t0 = now_sec();
+    save_users(arr, cnt);
+    double per_small = now_sec() - t0;
+    free(arr);
+
+    ImportStats st;
+    f = fopen(csv, "rb");
+    int ok = import_users(f, (uint32_t)iterations, cpu_count(), &st);
+    fclose(f);
+    printf("import of %d rows at %d iteration(s) on %d thread(s): %s\n", n, iterations, cpu_count(), ok ? "ok" : "FAILED");
+    import_print_stats(stdout, &st);
+
+    cnt = load_users(&arr);
+    t0 = now_sec();
+    save_users(arr, cnt);
+    double per_large = now_sec() - t0;
+    free(arr);
+    double total = st.parse_s + st.hash_s + st.write_s;
+    double signups = st.imported * (per_small + per_large) / 2;
+    printf("one signup rewrites users.db: %.1f ms at %d users, %.1f ms at %d users; %lld signups ~ %.0f s of I/O (%.0fx the import)\n",
+           per_small*1e3, existing, per_large*1e3, cnt, st.imported, signups, signups / (total > 0 ? total : 1e-9));
+
+    int good = 0, tries = 0;
+    for(int k=0;k<5;k++){
+        int id = base + (int)(splitmix64(&(uint64_t){(uint64_t)k + 1}) % (uint64_t)n);
+        char name[MAX_USER], pw[32];
+        User u;
+        snprintf(name, sizeof name, "user%07d", id);
+        snprintf(pw, sizeof pw, "pw-%d", id);
+        if(id < existing) continue;                 /* pre-existing users keep their password */
+        tries++;
+        good += db_find_user(name, &u) == 1 && password_verify(pw, u.hash);
     }
+    printf("password check on %d sampled users: %s\n", tries, good == tries ? "ok" : "FAILED");
+
+    f = fopen(out_a, "wb");
+    t0 = now_sec();
+    long long ne = export_users(f);
+    double te = now_sec() - t0;
+    fclose(f);
+    bench_use_db(BENCH_DB);
+    f = fopen(out_a, "rb");
+    t0 = now_sec();
+    ok = import_users(f, 1, cpu_count(), &st);
+    double ti = now_sec() - t0;
+    fclose(f);
+    f = fopen(out_b, "wb");
+    export_users(f);
+    fclose(f);
+    printf("export %lld users %.3f s (%.0f users/s); re-import into an empty db %.3f s; round trip %s\n",
+           ne, te, ne / (te > 0 ? te : 1e-9), ti, ok && st.imported == ne && files_equal(out_a, out_b) ? "identical" : "DIFFERS");
+    remove(csv); remove(out_a); remove(out_b);
+    bench_use_db(BENCH_DB);
+    strcpy(users_db_path, saved);
 }
 
-/* ---------- Algorithms demo ---------- */
-static int cmp_int(const void *a, const void *b){
-    int ia = *(const int*)a;
-    int ib = *(const int*)b;
-    return (ia > ib) - (ia < ib);
+/* Number-guess simulation: rand() vs. xoshiro, every guesser against both
+   hosts on 1..100 and 1..1e9, exact-mean and thread-independence checks,
+   games/s per thread count. */
+typedef struct { long long n; uint64_t sink; } RandJob;
+
+void bench_rand_chunk(void *arg, int c){
+    RandJob *j = arg;
+    uint64_t x = 0;
+    for(long long i=0;i<j->n;i++) x += (uint64_t)rand();
+    j[1 + c].sink = x;
 }
 
-void demo_sorting(void){
-    char buf[32]; int n=0;
-    read_line("Enter array size (5..20): ", buf, sizeof buf);
-    if(sscanf(buf, "%d", &n)!=1 || n<5 || n>20){ printf("Invalid size.\n"); return; }
-    int *a = malloc(n*sizeof(int));
-    srand((unsigned)time(NULL));
-    for(int i=0;i<n;i++) a[i]=rand()%100;
-    printf("Original: ");
-    for(int i=0;i<n;i++) printf("%d ", a[i]); printf("\n");
-    read_line("Choose: 1) Bubble 2) Insertion 3) Quick (qsort)\nChoice: ", buf, sizeof buf);
-    if(strcmp(buf,"1")==0){
-        for(int i=0;i<n-1;i++) for(int j=0;j<n-1-i;j++) if(a[j]>a[j+1]){ int t=a[j]; a[j]=a[j+1]; a[j+1]=t; }
-    } else if(strcmp(buf,"2")==0){
-        for(int i=1;i<n;i++){ int key=a[i], j=i-1; while(j>=0 && a[j]>key){ a[j+1]=a[j]; j--; } a[j+1]=key; }
-    } else {
-        qsort(a, n, sizeof(int), cmp_int);
-    }
-    printf("Sorted: ");
-    for(int i=0;i<n;i++) printf("%d ", a[i]); printf("\n");
-    free(a);
+void bench_xoshiro_chunk(void *arg, int c){
+    RandJob *j = arg;
+    Rng r; rng_seed(&r, (uint64_t)c);
+    uint64_t x = 0;
+    for(long long i=0;i<j->n;i++) x += rng_next(&r);
+    j[1 + c].sink = x;
 }
 
-void demo_binary_search(void){
-    int n=10; int *a = malloc(n*sizeof(int));
-    for(int i=0;i<n;i++) a[i]=i*2;
-    printf("Array: ");
-    for(int i=0;i<n;i++) printf("%d ", a[i]); printf("\n");
-    char buf[32]; read_line("Search for: ", buf, sizeof buf);
-    int key = atoi(buf);
-    int l=0, r=n-1, found=-1, steps=0;
-    while(l<=r){
-        steps++;
-        int m=(l+r)/2;
-        if(a[m]==key){ found=m; break; }
-        else if(a[m]<key) l=m+1; else r=m-1;
+void bench_guess(long long games){
+    int maxt = cpu_count() > 8 ? cpu_count() : 8;
+    RandJob *jobs = calloc(maxt + 1, sizeof *jobs);
+    long long per = 20000000;
+    jobs[0].n = per;
+    printf("%d CPUs\n%8s %16s %16s\n", cpu_count(), "threads", "rand() M/s", "xoshiro M/s");
+    for(int t=1; t<=maxt; t*=2){
+        double t0 = now_sec();
+        parallel_for(t, t, bench_rand_chunk, jobs);
+        double a = now_sec() - t0;
+        t0 = now_sec();
+        parallel_for(t, t, bench_xoshiro_chunk, jobs);
+        double b = now_sec() - t0;
+        printf("%8d %16.1f %16.1f\n", t, per * t / a / 1e6, per * t / b / 1e6);
+    }
+    free(jobs);
+
+    /* The old game seeded rand() with the time for every game: all games
+       started within one second got the same target. */
+    int seen_old[101] = {0}, seen_new[101] = {0}, old_distinct = 0, new_distinct = 0;
+    time_t now = time(NULL);
+    for(int i=0;i<1000;i++){
+        srand((unsigned)now);
+        int a = rand()%100 + 1, b = (int)rng_below(rng_thread(), 100) + 1;
+        old_distinct += !seen_old[a]++; new_distinct += !seen_new[b]++;
+    }
+    printf("1000 games started in the same second: %d distinct target(s) with srand(time), %d with xoshiro\n",
+           old_distinct, new_distinct);
+
+    int64_t ranges[2][2] = {{1, 100}, {1, 1000000000}};
+    int threads = cpu_count();
+    printf("\n%12s %8s %12s %12s %10s %6s\n", "range", "guesser", "host", "M games/s", "mean", "max");
+    for(int r=0;r<2;r++) for(int adv=0; adv<2; adv++) for(int st=0; st<GUESS_STRATEGIES; st++){
+        GuessSim s;
+        memset(&s, 0, sizeof s);
+        s.lo = ranges[r][0]; s.hi = ranges[r][1];
+        s.strategy = st; s.adversarial = adv; s.seed = 42; s.games = games;
+        double t = guess_simulate(&s, threads);
+        double mean = (double)s.total_tries / s.games;
+        printf("%12s %8s %12s %12.2f %10.4f %6d", r ? "1..1e9" : "1..100", guess_strategies[st].name,
+               adv ? "adversarial" : "fair", s.games / t / 1e6, mean, s.max_tries);
+        if(st == 0 && !adv){
+            double e = guess_binary_expected(s.hi - s.lo + 1);
+            printf("  expected %.4f %s", e, fabs(mean - e) < 0.01 ? "ok" : "MISMATCH");
+        }
+        if(st == 0 && adv) printf("  worst case %d %s", (int)ceil(log2((double)(s.hi - s.lo) + 2)),
+                                  s.max_tries == (int)ceil(log2((double)(s.hi - s.lo) + 2)) ? "ok" : "MISMATCH");
+        printf("\n");
+    }
+
+    GuessSim base;
+    memset(&base, 0, sizeof base);
+    base.lo = 1; base.hi = 100; base.strategy = 1; base.seed = 7; base.games = games;
+    printf("\nrandom guesser, fair host, 1..100, %lld games:\n%8s %12s %8s %10s\n", games, "threads", "M games/s", "speedup", "histogram");
+    double t1 = 0;
+    uint64_t ref[GUESS_HIST];
+    for(int t=1; t<=maxt; t*=2){
+        GuessSim s = base;
+        double tt = guess_simulate(&s, t);
+        if(t == 1){ t1 = tt; memcpy(ref, s.hist, sizeof ref); base = s; }
+        printf("%8d %12.2f %7.2fx %10s\n", t, games / tt / 1e6, t1 / tt, memcmp(ref, s.hist, sizeof ref) == 0 ? "same" : "DIFFERS");
     }
-    if(found>=0) printf("Found at index %d in %d steps.\n", found, steps);
-    else printf("Not found after %d steps.\n", steps);
-    free(a);
+    printf("\n");
+    guess_print(&base, 1, t1);
 }
 
-/* ---------- Calculator ---------- */
-void calc_basic(void){
-    char buf[128];
-    double a,b; char op;
-    read_line("Enter expression (e.g. 2 + 3): ", buf, sizeof buf);
-    if(sscanf(buf, "%lf %c %lf", &a, &op, &b)!=3){ printf("Invalid.\n"); return; }
-    if(op=='+') printf("= %.10g\n", a+b);
-    else if(op=='-') printf("= %.10g\n", a-b);
-    else if(op=='*') printf("= %.10g\n", a*b);
-    else if(op=='/') { if(b==0) printf("Divide by zero.\n"); else printf("= %.10g\n", a/b); }
-    else printf("Op not supported.\n");
+/* Content pack at nq questions (ten per topic): packer time, startup and
+   RSS of parsing the text source vs. mapping the pack (in a fresh child
+   each), topic lookup by hash vs. a strcmp chain, per-question latency. */
+int bench_strcmp_topic(const ContentPack *c, const char *id){
+    for(uint32_t i=0;i<c->h->ntopics;i++) if(strcmp(pack_str(c, c->topics[i].id), id) == 0) return (int)i;
+    return -1;
 }
 
-void calc_quadratic(void){
-    char buf[128]; double a,b,c;
-    read_line("Enter a b c (ax^2 + bx + c): ", buf, sizeof buf);
-    if(sscanf(buf, "%lf %lf %lf", &a,&b,&c)!=3){ printf("Invalid.\n"); return; }
-    double D = b*b - 4*a*c;
-    if(D < 0){ printf("No real roots.\n"); return; }
-    double r1 = (-b + sqrt(D))/(2*a);
-    double r2 = (-b - sqrt(D))/(2*a);
-    printf("Roots: %g , %g\n", r1, r2);
+void bench_content(int nq){
+    const char *src = DATA_DIR "/bench-content.txt", *pack = DATA_DIR "/bench-content.pack";
+    int nt = nq / 10 > 0 ? nq / 10 : 1;
+    ensure_data_dir();
+    FILE *f = fopen(src, "w");
+    if(!f){ perror(src); return; }
+    for(int t=0;t<nt;t++){
+        fprintf(f, "@topic t%06d Topic %d\nTutorial text for topic %d: declarations, expressions and\nstatements, with an example program.\n", t, t, t);
+        for(int q=0;q<10 && t*10+q < nq;q++) fprintf(f, "@q Question %d of topic %d: what does expression %d evaluate to?\n@a %d\n", q, t, t*10+q, (t*10+q) % 97);
+    }
+    fclose(f);
+    char *av[] = {"cplayground", "--pack", (char*)src, (char*)pack};
+    double t0 = now_sec();
+    if(pack_main(4, av) != 0) return;
+    printf("packer total %.3f s\n", now_sec() - t0);
+#ifndef _WIN32
+    struct stat ss, sp;
+    stat(src, &ss); stat(pack, &sp);
+
+    printf("%-12s %9s %12s %15s %18s\n", "startup", "file MB", "startup ms", "RSS KB (open)", "RSS KB (+1 quiz)");
+    for(int b=0;b<2;b++){
+        fflush(stdout);
+        pid_t pid = fork();
+        if(pid == 0){
+            struct rusage ru;
+            getrusage(RUSAGE_SELF, &ru);
+            long rss0 = ru.ru_maxrss;
+            ContentPack c;
+            memset(&c, 0, sizeof c);
+            int fd = open(b ? pack : src, O_RDONLY);      /* start cold */
+            if(fd >= 0){ fdatasync(fd); posix_fadvise(fd, 0, 0, POSIX_FADV_DONTNEED); close(fd); }
+            t0 = now_sec();
+            int ok;
+            if(b) ok = pack_open(&c, pack);
+            else {
+                MappedFile m;
+                char err[128];
+                ok = map_file(src, &m);
+                size_t size = ok ? pack_build((const char*)m.data, m.size, &c.owned, err, sizeof err) : 0;
+                if(ok) unmap_file(&m);
+                ok = size && pack_attach(&c, c.owned, size);
+            }
+            double startup = now_sec() - t0;
+            getrusage(RUSAGE_SELF, &ru);
+            long rss1 = ru.ru_maxrss;
+            size_t sum = 0;
+            Rng r; rng_seed(&r, 5);
+            for(int i=0;i<QUIZ_LEN && ok;i++){
+                const PackQuestion *q = &c.questions[rng_below(&r, c.h->nquestions)];
+                sum += strlen(pack_str(&c, q->text)) + strlen(pack_str(&c, q->answer));
+            }
+            getrusage(RUSAGE_SELF, &ru);
+            printf("%-12s %9.1f %12.3f %15ld %18ld%s\n", b ? "mmap pack" : "parse text", (b ? sp.st_size : ss.st_size)/1e6,
+                   startup*1e3, rss1 - rss0, ru.ru_maxrss - rss0, ok && sum ? "" : "  (FAILED)");
+            fflush(stdout);
+            pack_close(&c);
+            _exit(0);
+        }
+        if(pid > 0) waitpid(pid, NULL, 0);
+    }
+#else
+    printf("startup and RSS comparison needs fork(); not available on this platform.\n");
+#endif
+
+    ContentPack c;
+    int opens = 2000;
+    t0 = now_sec();
+    for(int i=0;i<opens;i++){ if(!pack_open(&c, pack)) break; pack_close(&c); }
+    printf("warm pack open+close: %.1f us\n", (now_sec() - t0) / opens * 1e6);
+    if(!pack_open(&c, pack)){ printf("cannot open %s\n", pack); return; }
+    int iters = 100000, found = 0;
+    char id[32];
+    Rng r; rng_seed(&r, 9);
+    t0 = now_sec();
+    for(int i=0;i<iters;i++){ snprintf(id, sizeof id, "t%06d", (int)rng_below(&r, nt)); found += pack_topic(&c, id) >= 0; }
+    double hashed = (now_sec() - t0) / iters;
+    int citers = iters / 100 > 100 ? iters / 100 : 100, cfound = 0;
+    t0 = now_sec();
+    for(int i=0;i<citers;i++){ snprintf(id, sizeof id, "t%06d", (int)rng_below(&r, nt)); cfound += bench_strcmp_topic(&c, id) >= 0; }
+    double chain = (now_sec() - t0) / citers;
+    printf("topic lookup, %d topics: hashed %.0f ns, strcmp chain %.1f us (%.0fx)%s\n", nt, hashed*1e9, chain*1e6,
+           chain / hashed, found == iters && cfound == citers ? "" : "  (MISSES)");
+
+    size_t sum = 0;
+    int quizzes = 200000;
+    t0 = now_sec();
+    for(int i=0;i<quizzes;i++){
+        for(int k=0;k<QUIZ_LEN;k++){
+            const PackQuestion *q = &c.questions[rng_below(&r, c.h->nquestions)];
+            sum += strlen(pack_str(&c, q->text)) + (size_t)pack_str(&c, c.topics[q->topic].title)[0];
+        }
+    }
+    double per_q = (now_sec() - t0) / ((double)quizzes * QUIZ_LEN);
+    printf("random question (sample + text + topic title), %u questions: %.0f ns per question (checksum %zu)\n",
+           c.h->nquestions, per_q*1e9, sum);
+    pack_close(&c);
+    remove(src); remove(pack);
 }
 
-void calc_matrix(void){
-    printf("Enter A (a11 a12 a21 a22): ");
-    double a11,a12,a21,a22;
-    if(scanf("%lf %lf %lf %lf", &a11,&a12,&a21,&a22)!=4){ printf("Invalid.\n"); while(getchar()!='\n'); return; }
-    printf("Enter B (b11 b12 b21 b22): ");
-    double b11,b12,b21,b22;
-    if(scanf("%lf %lf %lf %lf", &b11,&b12,&b21,&b22)!=4){ printf("Invalid.\n"); while(getchar()!='\n'); return; }
-    while(getchar()!='\n');
-    printf("A+B =\n%g %g\n%g %g\n", a11+b11,a12+b12,a21+b21,a22+b22);
-    double c11=a11*b11 + a12*b21, c12=a11*b12 + a12*b22, c21=a21*b11 + a22*b21, c22=a21*b12 + a22*b22;
-    printf("A*B =\n%g %g\n%g %g\n", c11,c12,c21,c22);
+/* Many writers appending stat deltas at once, as with a busy server: one
+   or two processes with several threads each, for a range of journal shard
+   counts. Checks that no update is lost and that users.db never goes
+   missing while compactions replace it. */
+typedef struct { int users, per_thread; uint64_t seed; } ShardWriter;
+
+void *shard_writer(void *arg){
+    ShardWriter *w = arg;
+    Rng r; rng_seed(&r, w->seed);
+    char name[MAX_USER];
+    for(int i=0;i<w->per_thread;i++){
+        snprintf(name, sizeof name, "user%07d", (int)rng_below(&r, w->users));
+        journal_append(name, 1, i & 1, 0, NULL, NULL);
+    }
+    return NULL;
 }
 
-void calculator_menu(void){
-    while(1){
-        printf("\n=== Advanced Calculator ===\n1) Basic\n2) Quadratic solver\n3) 2x2 Matrices\n0) Back\nChoose: ");
-        char buf[16]; read_line("", buf, sizeof buf);
-        if(strcmp(buf,"0")==0) return;
-        if(strcmp(buf,"1")==0) calc_basic();
-        else if(strcmp(buf,"2")==0) calc_quadratic();
-        else if(strcmp(buf,"3")==0) calc_matrix();
-        else printf("Invalid.\n");
+atomic_int shard_watch_stop;
+atomic_long shard_watch_missing, shard_watch_checks;
+
+void *shard_watcher(void *arg){
+    (void)arg;
+    struct stat st;
+    while(!shard_watch_stop){
+        if(stat(users_db_path, &st) != 0) shard_watch_missing++;
+        shard_watch_checks++;
     }
+    return NULL;
 }
 
-/* ---------- Platform Home ---------- */
-void platform_home(const char *username){
-    while(1){
-        printf("\n=== Welcome, %s ===\n1) Games\n2) Learn C\n3) Algorithms demo\n4) Advanced Calculator\n5) Profile\n6) Show users (admin)\n0) Logout\nChoose: ", username);
-        char opt[16]; read_line("", opt, sizeof opt);
-        if(strcmp(opt,"0")==0){ printf("Logging out...\n"); break; }
-        else if(strcmp(opt,"1")==0) games_menu(username);
-        else if(strcmp(opt,"2")==0) learn_menu(username);
-        else if(strcmp(opt,"3")==0){
-            printf("1) Sorting 2) Binary Search\n");
-            char s[8]; read_line("Choose: ", s, sizeof s);
-            if(strcmp(s,"1")==0) demo_sorting();
-            else if(strcmp(s,"2")==0) demo_binary_search();
-        }
-        else if(strcmp(opt,"4")==0) calculator_menu();
-        else if(strcmp(opt,"5")==0) show_profile(username);
-        else if(strcmp(opt,"6")==0) show_all_users();
-        else printf("Invalid option.\n");
+int shard_run_writers(int threads, int users, int per_thread, uint64_t seed){
+    pthread_t th[64];
+    ShardWriter w[64];
+    int started = 0;
+    for(int t=0;t<threads && t<64;t++){
+        w[t].users = users; w[t].per_thread = per_thread; w[t].seed = seed + t;
+        if(pthread_create(&th[t], NULL, shard_writer, &w[t]) == 0) started++;
+        else break;
     }
+    for(int t=0;t<started;t++) pthread_join(th[t], NULL);
+    return started;
 }
 
-/* ---------- Startup loop ---------- */
-void startup_loop(void){
-    ensure_data_dir();
-    while(1){
-        printf("\n=== CPlayground Startup ===\n1) Sign Up\n2) Log In\n3) Show Users (admin)\n0) Exit\nChoose: ");
-        char buf[16]; read_line("", buf, sizeof buf);
-        if(strcmp(buf,"0")==0){ printf("Bye.\n"); exit(0); }
-        else if(strcmp(buf,"1")==0){
-            if(signup_flow()){
-                char ans[8]; read_line("Login now? (y/n): ", ans, sizeof ans);
-                if(ans[0]=='y' || ans[0]=='Y'){ char user[MAX_USER]; if(login_flow(user)) platform_home(user); }
-            }
+void bench_shards(int users, int threads){
+    int counts[] = {1, 2, 4, 8, 16}, per_thread = 1000, procs = 1;
+    char saved[256]; strcpy(saved, users_db_path);
+    int saved_shards = journal_shards;
+    if(threads > 64) threads = 64;
+#ifndef _WIN32
+    procs = 2;
+#endif
+    printf("%d users, %d process(es) x %d writer threads x %d updates\n", users, procs, threads, per_thread);
+    printf("%7s %12s %14s %12s %12s %8s\n", "shards", "updates/s", "fsyncs/update", "avg batch", "compactions", "check");
+    pthread_once(&jshards_once, jshards_init);
+    int all_ok = 1;
+    for(int c=0;c<(int)(sizeof counts/sizeof counts[0]);c++){
+        bench_use_db(BENCH_DB);
+        bench_make_users(users);
+        journal_shards = counts[c];
+        for(int k=0;k<JOURNAL_MAX_SHARDS;k++){
+            pthread_mutex_lock(&jshards[k].mu);
+            jshards[k].commits = jshards[k].records = 0;
+            pthread_mutex_unlock(&jshards[k].mu);
         }
-        else if(strcmp(buf,"2")==0){
-            char user[MAX_USER] = {0};
-            if(login_flow(user)) platform_home(user);
+        long gen0 = read_db_gen();
+        shard_watch_stop = 0; shard_watch_missing = 0; shard_watch_checks = 0;
+        pthread_t watcher;
+        int watching = pthread_create(&watcher, NULL, shard_watcher, NULL) == 0;
+        double t0 = now_sec();
+#ifndef _WIN32
+        fflush(stdout);
+        pid_t pid = fork();
+        if(pid == 0){
+            int n = shard_run_writers(threads, users, per_thread, 1000 + 100*c);
+            _exit(n == threads ? 0 : 1);
         }
-        else if(strcmp(buf,"3")==0) show_all_users();
-        else printf("Invalid.\n");
+        int started = shard_run_writers(threads, users, per_thread, 2000 + 100*c);
+        int status = 0;
+        if(pid > 0) waitpid(pid, &status, 0);
+        int child_ok = pid > 0 && WIFEXITED(status) && WEXITSTATUS(status) == 0;
+#else
+        int started = shard_run_writers(threads, users, per_thread, 2000 + 100*c), child_ok = 1;
+#endif
+        double dt = now_sec() - t0;
+        shard_watch_stop = 1;
+        if(watching) pthread_join(watcher, NULL);
+        long long commits = 0, records = 0;
+        for(int k=0;k<JOURNAL_MAX_SHARDS;k++){ commits += jshards[k].commits; records += jshards[k].records; }
+
+        long long total = (long long)procs * threads * per_thread, played = 0, won = 0, want_played = 0, want_won = 0;
+        for(int i=0;i<users;i++){ want_played += i%50; want_won += i%20; }
+        want_played += total;
+        want_won += (long long)procs * threads * (per_thread/2);
+        User *arr; int n = load_users(&arr);
+        for(int i=0;i<n;i++){ played += arr[i].games_played; won += arr[i].games_won; }
+        free(arr);
+        int ok = child_ok && started == threads && n == users && played == want_played && won == want_won && shard_watch_missing == 0;
+        all_ok &= ok;
+        printf("%7d %12.0f %14.3f %12.1f %12ld %8s\n", counts[c], total/dt,
+               records ? (double)commits/records : 0.0, commits ? (double)records/commits : 0.0,
+               read_db_gen() - gen0, ok ? "ok" : "FAILED");
+        if(!ok) printf("  games played %lld (expected %lld), won %lld (expected %lld), users %d, users.db missing %ld of %ld checks\n",
+                       played, want_played, won, want_won, n, (long)shard_watch_missing, (long)shard_watch_checks);
     }
+    printf("fsync and batch figures are for this process; %s\n", all_ok ? "no lost updates" : "UPDATES LOST");
+    journal_shards = saved_shards;
+    bench_use_db(BENCH_DB);
+    strcpy(users_db_path, saved);
+}
+
+/* arg is the optional argument after the benchmark name. */
+int run_bench(int argc, char **argv){
+    const char *name = argv[0], *arg = argc>=2 ? argv[1] : NULL;
+    if(strcmp(name,"login")==0) bench_login();
+    else if(strcmp(name,"stats")==0) bench_stats();
+    else if(strcmp(name,"sha256")==0) bench_sha256();
+    else if(strcmp(name,"dbformat")==0) bench_dbformat(arg && atoi(arg)>0 ? atoi(arg) : 1000000);
+    else if(strcmp(name,"parse")==0) bench_parse(arg && atoi(arg)>0 ? atoi(arg) : 1000000);
+    else if(strcmp(name,"server")==0) bench_server(arg && atoi(arg)>0 ? atoi(arg) : 2000, argc>=3 ? atoi(argv[2]) : 8);
+    else if(strcmp(name,"ttt")==0) bench_ttt(arg && atoi(arg)>0 ? atoi(arg) : 1000000);
+    else if(strcmp(name,"gomoku")==0) bench_gomoku(arg && atoi(arg)>0 ? atoi(arg) : 1000, argc>=3 ? atoi(argv[2]) : 15, argc>=4 ? atoi(argv[3]) : 5);
+    else if(strcmp(name,"sort")==0) sort_benchmark(arg && atol(arg)>0 ? (size_t)atol(arg) : 10000000, argc>=3 ? atoi(argv[2]) : 0);
+    else if(strcmp(name,"search")==0) search_benchmark(arg && atol(arg)>0 ? (size_t)atol(arg) : 64*1024*1024);
+    else if(strcmp(name,"expr")==0) bench_expr(arg && atol(arg)>0 ? (size_t)atol(arg) : 100000000);
+    else if(strcmp(name,"matrix")==0) bench_matrix(arg && atoi(arg)>0 ? atoi(arg) : 1024, argc>=3 ? atoi(argv[2]) : 0);
+    else if(strcmp(name,"quadratic")==0) bench_quadratic(arg && atol(arg)>0 ? atol(arg) : 5000000);
+    else if(strcmp(name,"leaderboard")==0) bench_leaderboard(arg && atoi(arg)>0 ? atoi(arg) : 1000000);
+    else if(strcmp(name,"listing")==0) bench_listing(arg && atoi(arg)>0 ? atoi(arg) : 1000000);
+    else if(strcmp(name,"import")==0) bench_import(arg && atoi(arg)>0 ? atoi(arg) : 1000000, argc>=3 && atoi(argv[2])>0 ? atoi(argv[2]) : 1);
+    else if(strcmp(name,"guess")==0) bench_guess(arg && atoll(arg)>0 ? atoll(arg) : 10000000);
+    else if(strcmp(name,"content")==0) bench_content(arg && atoi(arg)>0 ? atoi(arg) : 100000);
+    else if(strcmp(name,"shards")==0) bench_shards(arg && atoi(arg)>0 ? atoi(arg) : 10000, argc>=3 && atoi(argv[2])>0 ? atoi(argv[2]) : 8);
+    else if(strcmp(name,"replay")==0) bench_replay(arg && atoi(arg)>0 ? atoi(arg) : 1000, argc>=3 ? argv[2] : NULL);
+    else { printf("Unknown benchmark '%s'. Available: login stats sha256 dbformat parse server replay ttt gomoku sort search expr matrix quadratic leaderboard listing import guess content shards\n", name); return 1; }
+    return 0;
 }
 
 /* ---------- main ---------- */
-int main(void){
+int main(int argc, char **argv){
+    prof_init();
+    sha256_select();
+    const char *ki = getenv("CPLAYGROUND_KDF_ITER");
+    if(ki && atoi(ki) > 0) kdf_iterations = atoi(ki);
+    const char *sh = getenv("CPLAYGROUND_SHARDS");
+    if(sh && atoi(sh) > 0) journal_shards = atoi(sh) < JOURNAL_MAX_SHARDS ? atoi(sh) : JOURNAL_MAX_SHARDS;
+    if(argc>=3 && strcmp(argv[1],"--bench")==0) return run_bench(argc-2, argv+2);
+    if(argc>=2 && strcmp(argv[1],"--convert")==0) return convert_db(argc, argv);
+    if(argc>=2 && strcmp(argv[1],"--pack")==0) return pack_main(argc, argv);
+    if(argc>=2 && strcmp(argv[1],"--import")==0) return import_main(argc, argv);
+    if(argc>=2 && strcmp(argv[1],"--export")==0) return export_main(argc, argv);
+    if(argc>=2 && strcmp(argv[1],"--quadratic")==0) return quad_main(argc>=3 ? argv[2] : "-", argc>=4 ? argv[3] : "-");
+    if(argc>=2 && strcmp(argv[1],"--tune-kdf")==0){ tune_kdf(argc>=3 ? atoi(argv[2]) : 250); return 0; }
+    if(!journal_claim_layout()){
+        fprintf(stderr, "%s is in use by a process with a different CPLAYGROUND_SHARDS; use the same value.\n", users_db_path);
+        return 1;
+    }
+    if(journal_layout_stale()) db_compact();   /* shard count changed, or an old single journal */
+    const char *fs = getenv("CPLAYGROUND_FLUSH_SECS");
+    if(fs) session_flush_secs = atoi(fs);
+    const char *is = getenv("CPLAYGROUND_IDLE_SECS");
+    if(is) serve_idle_secs = atoi(is);
+    install_signal_handlers();
+    if(argc>=2 && strcmp(argv[1],"--serve")==0)
+        return serve_main(argc>=3 ? argv[2] : SERVE_SOCK, argc>=4 ? atoi(argv[3]) : SERVE_WORKERS);
+    if(argc>=3 && strcmp(argv[1],"--record")==0){
+        record_out = fopen(argv[2], "a");
+        if(!record_out){ perror(argv[2]); return 1; }
+        fprintf(record_out, "@ session\n");
+    }
+    atexit(session_flush);
     printf("CPlayground  C platform demo\n");
     startup_loop();
-    return 0;
+    if(interrupted) printf("\nInterrupted.\n");
+    session_end();
+    db_compact();
+    printf("Bye.\n");
+    return interrupted ? 130 : 0;
 }